@@ -0,0 +1,112 @@
+/*
+ * Copyright (c) 2023 Nordic Semiconductor ASA
+ *
+ * SPDX-License-Identifier: LicenseRef-Nordic-5-Clause
+ */
+
+#ifndef ADV_BUILD_H_
+#define ADV_BUILD_H_
+
+/**@file
+ * @defgroup adv_build Advertising payload builder
+ * @{
+ * @brief Macros that lay out advertising payloads at compile time.
+ *
+ * A payload is a packed struct with one member per AD structure, so its
+ * size is the encoded length and the length byte of every structure is
+ * computed from the member type. Multi-byte values are spelled out as
+ * little-endian bytes and oversized payloads fail the build. A const
+ * payload is placed in flash as it is sent.
+ *
+ * @code
+ * struct beacon_sd {
+ *	ADV_FIELD_STR(uri, ADV_URI_HTTPS "//example.com");
+ * } __packed;
+ *
+ * static const struct beacon_sd beacon_sd = {
+ *	ADV_FIELD_INIT(struct beacon_sd, uri, BT_DATA_URI, ADV_URI_HTTPS "//example.com"),
+ * };
+ * ADV_PAYLOAD_CHECK(struct beacon_sd);
+ * @endcode
+ */
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <zephyr/types.h>
+#include <zephyr/toolchain.h>
+#include <zephyr/bluetooth/gap.h>
+
+/** URI scheme name string for "https:", see the Bluetooth assigned numbers. */
+#define ADV_URI_HTTPS "\x17"
+/** URI scheme name string for "http:". */
+#define ADV_URI_HTTP "\x16"
+
+/** @brief Declare an AD structure member holding @p _len bytes of data.
+ *
+ * @param _name Name of the member.
+ * @param _len  Length of the data.
+ */
+#define ADV_FIELD_BYTES(_name, _len)                                                               \
+	struct __packed {                                                                          \
+		uint8_t len;                                                                       \
+		uint8_t type;                                                                      \
+		uint8_t data[_len];                                                                \
+	} _name
+
+/** @brief Declare an AD structure member holding a string without its NUL.
+ *
+ * @param _name Name of the member.
+ * @param _str  String literal the member is initialized with.
+ */
+#define ADV_FIELD_STR(_name, _str) ADV_FIELD_BYTES(_name, sizeof(_str) - 1)
+
+/** @brief Initialize an AD structure member.
+ *
+ * The length byte is derived from the declared size of the data.
+ *
+ * @param _payload Type of the payload struct.
+ * @param _name    Name of the member.
+ * @param _type    AD type, for example BT_DATA_FLAGS.
+ * @param ...      Initializer of the data: a string literal or a brace
+ *                 enclosed byte list.
+ */
+#define ADV_FIELD_INIT(_payload, _name, _type, ...)                                                \
+	._name = {                                                                                 \
+		.len = sizeof(((_payload *)0)->_name.data) + 1,                                    \
+		.type = (_type),                                                                   \
+		.data = __VA_ARGS__,                                                               \
+	}
+
+/** @brief Little-endian bytes of a 16-bit value, for a byte list. */
+#define ADV_LE16(_v) ((_v) & 0xff), (((_v) >> 8) & 0xff)
+
+/** @brief Little-endian bytes of a 32-bit value, for a byte list. */
+#define ADV_LE32(_v) ADV_LE16(_v), ADV_LE16((_v) >> 16)
+
+/** @brief Fail the build if a payload does not fit in a legacy PDU.
+ *
+ * @param _payload Type of the payload struct.
+ */
+#define ADV_PAYLOAD_CHECK(_payload)                                                                \
+	BUILD_ASSERT(sizeof(_payload) <= BT_GAP_ADV_MAX_ADV_DATA_LEN,                              \
+		     #_payload " does not fit in a legacy advertising PDU")
+
+/** @brief Fail the build if a payload is longer than @p _max bytes.
+ *
+ * @param _payload Type of the payload struct.
+ * @param _max     Largest allowed length, for extended advertising.
+ */
+#define ADV_PAYLOAD_CHECK_LEN(_payload, _max)                                                      \
+	BUILD_ASSERT(sizeof(_payload) <= (_max), #_payload " is too long")
+
+#ifdef __cplusplus
+}
+#endif
+
+/**
+ * @}
+ */
+
+#endif /* ADV_BUILD_H_ */
@@ -0,0 +1,80 @@
+/*
+ * Copyright (c) 2023 Nordic Semiconductor ASA
+ *
+ * SPDX-License-Identifier: LicenseRef-Nordic-5-Clause
+ */
+
+#ifndef ADV_TIME_H_
+#define ADV_TIME_H_
+
+/**@file
+ * @defgroup adv_time Advertising timing model
+ * @{
+ * @brief Average advertising event period and discovery latency.
+ *
+ * The link layer adds a random advDelay of 0 to 10 ms to every advertising
+ * interval, so advertising events drift against any scanner. A scanner
+ * that starts at a random time and listens a window out of every scan
+ * interval catches each event with the probability of its duty cycle, so
+ * it waits half an event period for the first event and then on average
+ * scan interval / scan window periods in total. A scanner that listens
+ * without gaps waits half an event period.
+ *
+ * Times are in microseconds, see conn_time.h for the unit conversions.
+ * lesson2_observer with CONFIG_APP_DISCOVERY_BENCH measures the latency
+ * the model predicts.
+ */
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <zephyr/types.h>
+
+/** @brief Average advDelay added to every advertising event. */
+#define ADV_TIME_DELAY_AVG_US 5000U
+
+/** @brief Average time between advertising events.
+ *
+ * @param _interval_us Advertising interval.
+ */
+#define ADV_TIME_PERIOD_US(_interval_us) ((uint32_t)(_interval_us) + ADV_TIME_DELAY_AVG_US)
+
+/** @brief Average time until a scanner that listens without gaps
+ *  receives the first advertising event.
+ *
+ * @param _interval_us Advertising interval.
+ */
+#define ADV_TIME_DISCOVERY_CONT_US(_interval_us) (ADV_TIME_PERIOD_US(_interval_us) / 2)
+
+/** @brief Average time until a scanner receives the first advertising
+ *  event.
+ *
+ * @param interval_us Advertising interval.
+ * @param scan_interval_us Scan interval.
+ * @param scan_window_us Scan window, not 0. Longer windows than the scan
+ *        interval count as scanning without gaps.
+ *
+ * @return Average discovery latency in microseconds.
+ */
+static inline uint32_t adv_time_discovery_us(uint32_t interval_us, uint32_t scan_interval_us,
+					     uint32_t scan_window_us)
+{
+	uint32_t period_us = ADV_TIME_PERIOD_US(interval_us);
+
+	if (scan_window_us >= scan_interval_us) {
+		return ADV_TIME_DISCOVERY_CONT_US(interval_us);
+	}
+
+	return (uint64_t)period_us * scan_interval_us / scan_window_us - period_us / 2;
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+/**
+ * @}
+ */
+
+#endif /* ADV_TIME_H_ */
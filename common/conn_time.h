@@ -0,0 +1,72 @@
+/*
+ * Copyright (c) 2023 Nordic Semiconductor ASA
+ *
+ * SPDX-License-Identifier: LicenseRef-Nordic-5-Clause
+ */
+
+#ifndef CONN_TIME_H_
+#define CONN_TIME_H_
+
+/**@file
+ * @defgroup conn_time Bluetooth LE time units
+ * @{
+ * @brief Integer conversion and formatting of Bluetooth LE time units.
+ *
+ * Connection intervals count 1.25 ms units, supervision timeouts 10 ms
+ * units and advertising intervals 0.625 ms units. All of them are whole
+ * microseconds, so they are converted and printed exactly without
+ * floating point, and the samples can be built without the FPU.
+ * scripts/size_report.sh prints what that saves for a sample.
+ *
+ * @code
+ * LOG_INF("Interval " CONN_TIME_FMT, CONN_TIME_ARGS(CONN_TIME_INTERVAL_US(interval)));
+ * @endcode
+ */
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <zephyr/types.h>
+
+/** @brief Connection interval in 1.25 ms units to microseconds. */
+#define CONN_TIME_INTERVAL_US(_n) ((uint32_t)(_n) * 1250U)
+
+/** @brief Supervision timeout in 10 ms units to microseconds. */
+#define CONN_TIME_TIMEOUT_US(_n) ((uint32_t)(_n) * 10000U)
+
+/** @brief Advertising interval in 0.625 ms units to microseconds. */
+#define CONN_TIME_ADV_US(_n) ((uint32_t)(_n) * 625U)
+
+/** @brief Milliseconds to a connection interval in 1.25 ms units,
+ *  rounded down.
+ */
+#define CONN_TIME_MS_TO_INTERVAL(_ms) ((_ms) * 4 / 5)
+
+/** @brief Milliseconds to a supervision timeout in 10 ms units, rounded
+ *  down.
+ */
+#define CONN_TIME_MS_TO_TIMEOUT(_ms) ((_ms) / 10)
+
+/** @brief Milliseconds to an advertising interval in 0.625 ms units,
+ *  rounded down.
+ */
+#define CONN_TIME_MS_TO_ADV(_ms) ((_ms) * 8 / 5)
+
+/** @brief Format string for a time from CONN_TIME_ARGS(). */
+#define CONN_TIME_FMT "%u.%03u ms"
+
+/** @brief Arguments that print a time in microseconds with
+ *  CONN_TIME_FMT.
+ */
+#define CONN_TIME_ARGS(_us) (unsigned int)((_us) / 1000U), (unsigned int)((_us) % 1000U)
+
+#ifdef __cplusplus
+}
+#endif
+
+/**
+ * @}
+ */
+
+#endif /* CONN_TIME_H_ */
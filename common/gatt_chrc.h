@@ -0,0 +1,304 @@
+/*
+ * Copyright (c) 2023 Nordic Semiconductor ASA
+ *
+ * SPDX-License-Identifier: LicenseRef-Nordic-5-Clause
+ */
+
+#ifndef GATT_CHRC_H_
+#define GATT_CHRC_H_
+
+/**@file
+ * @defgroup gatt_chrc GATT characteristic builder
+ * @{
+ * @brief Macros that generate characteristic handlers at compile time.
+ *
+ * Every macro expands to a static function with the type, range and
+ * callback of the characteristic baked in, so the validation is inlined
+ * into the attribute callback and no dispatch table is kept at runtime.
+ * The generated handlers log through the log module of the file that
+ * uses them.
+ */
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <zephyr/types.h>
+#include <string.h>
+#include <errno.h>
+#include <zephyr/kernel.h>
+#include <zephyr/bluetooth/conn.h>
+#include <zephyr/bluetooth/gatt.h>
+#include <zephyr/logging/log.h>
+
+/** @brief Define the write handler of a scalar characteristic.
+ *
+ * The handler accepts only full writes of exactly sizeof(_type) bytes at
+ * offset 0 with a value in the [_min, _max] range and passes the value to
+ * @p _cb. Multi-byte values are taken in CPU byte order, which is
+ * little-endian on all supported SoCs.
+ *
+ * @param _name Name of the generated handler.
+ * @param _type Type of the characteristic value.
+ * @param _min  Smallest accepted value.
+ * @param _max  Largest accepted value.
+ * @param _cb   Function or macro called with the validated value.
+ */
+#define GATT_CHRC_WRITE_DEFINE(_name, _type, _min, _max, _cb)                                     \
+	static ssize_t _name(struct bt_conn *conn, const struct bt_gatt_attr *attr,               \
+			     const void *buf, uint16_t len, uint16_t offset, uint8_t flags)        \
+	{                                                                                          \
+		_type val;                                                                         \
+                                                                                                   \
+		LOG_DBG("Attribute write, handle: %u, conn: %p", attr->handle, (void *)conn);     \
+                                                                                                   \
+		if (len != sizeof(_type)) {                                                        \
+			LOG_DBG(#_name ": Incorrect data length");                                 \
+			return BT_GATT_ERR(BT_ATT_ERR_INVALID_ATTRIBUTE_LEN);                      \
+		}                                                                                  \
+                                                                                                   \
+		if (offset != 0) {                                                                 \
+			LOG_DBG(#_name ": Incorrect data offset");                                 \
+			return BT_GATT_ERR(BT_ATT_ERR_INVALID_OFFSET);                             \
+		}                                                                                  \
+                                                                                                   \
+		memcpy(&val, buf, sizeof(val));                                                    \
+		if (val < (_min) || val > (_max)) {                                                \
+			LOG_DBG(#_name ": Incorrect value");                                       \
+			return BT_GATT_ERR(BT_ATT_ERR_VALUE_NOT_ALLOWED);                          \
+		}                                                                                  \
+                                                                                                   \
+		_cb(val);                                                                          \
+                                                                                                   \
+		return len;                                                                        \
+	}
+
+/** @brief Define the write handler of a sequenced scalar characteristic.
+ *
+ * Like GATT_CHRC_WRITE_DEFINE(), but the value may be followed by a one
+ * byte sequence number. A write that repeats the sequence number of the
+ * previous one from the same connection is acknowledged and dropped, so a
+ * peer can resend a write without response without applying it twice.
+ * Writes without a sequence number are always applied. The generated
+ * _name##_seq_reset(conn) function forgets the last sequence number of a
+ * connection, call it when the peer disconnects.
+ *
+ * @param _name Name of the generated handler.
+ * @param _type Type of the characteristic value.
+ * @param _min  Smallest accepted value.
+ * @param _max  Largest accepted value.
+ * @param _cb   Function or macro called with the validated value.
+ */
+#define GATT_CHRC_SEQ_WRITE_DEFINE(_name, _type, _min, _max, _cb)                                 \
+	/* Last sequence number plus one per connection, 0 for none */                             \
+	static uint16_t _name##_last_seq[CONFIG_BT_MAX_CONN];                                      \
+                                                                                                   \
+	static inline void _name##_seq_reset(struct bt_conn *conn)                                 \
+	{                                                                                          \
+		_name##_last_seq[bt_conn_index(conn)] = 0;                                         \
+	}                                                                                          \
+                                                                                                   \
+	static ssize_t _name(struct bt_conn *conn, const struct bt_gatt_attr *attr,               \
+			     const void *buf, uint16_t len, uint16_t offset, uint8_t flags)        \
+	{                                                                                          \
+		_type val;                                                                         \
+                                                                                                   \
+		LOG_DBG("Attribute write, handle: %u, conn: %p", attr->handle, (void *)conn);     \
+                                                                                                   \
+		if (len != sizeof(_type) && len != sizeof(_type) + 1) {                            \
+			LOG_DBG(#_name ": Incorrect data length");                                 \
+			return BT_GATT_ERR(BT_ATT_ERR_INVALID_ATTRIBUTE_LEN);                      \
+		}                                                                                  \
+                                                                                                   \
+		if (offset != 0) {                                                                 \
+			LOG_DBG(#_name ": Incorrect data offset");                                 \
+			return BT_GATT_ERR(BT_ATT_ERR_INVALID_OFFSET);                             \
+		}                                                                                  \
+                                                                                                   \
+		memcpy(&val, buf, sizeof(val));                                                    \
+		if (val < (_min) || val > (_max)) {                                                \
+			LOG_DBG(#_name ": Incorrect value");                                       \
+			return BT_GATT_ERR(BT_ATT_ERR_VALUE_NOT_ALLOWED);                          \
+		}                                                                                  \
+                                                                                                   \
+		if (len > sizeof(_type)) {                                                         \
+			uint8_t seq = ((const uint8_t *)buf)[sizeof(_type)];                       \
+			uint16_t *last = &_name##_last_seq[bt_conn_index(conn)];                   \
+                                                                                                   \
+			if (*last == seq + 1) {                                                    \
+				LOG_DBG(#_name ": Duplicate sequence number %u", seq);             \
+				return len;                                                        \
+			}                                                                          \
+			*last = seq + 1;                                                           \
+		}                                                                                  \
+                                                                                                   \
+		_cb(val);                                                                          \
+                                                                                                   \
+		return len;                                                                        \
+	}
+
+/** @brief Define the read handler of a scalar characteristic.
+ *
+ * The handler fetches the current value from @p _cb on every read, so no
+ * copy of the value has to be kept in the attribute user data.
+ *
+ * @param _name Name of the generated handler.
+ * @param _type Type of the characteristic value.
+ * @param _cb   Function or macro returning the current value.
+ */
+#define GATT_CHRC_READ_DEFINE(_name, _type, _cb)                                                  \
+	static ssize_t _name(struct bt_conn *conn, const struct bt_gatt_attr *attr, void *buf,    \
+			     uint16_t len, uint16_t offset)                                        \
+	{                                                                                          \
+		_type val = _cb();                                                                 \
+                                                                                                   \
+		LOG_DBG("Attribute read, handle: %u, conn: %p", attr->handle, (void *)conn);      \
+                                                                                                   \
+		return bt_gatt_attr_read(conn, attr, buf, len, offset, &val, sizeof(val));         \
+	}
+
+/** @brief Define the write handler of a long characteristic.
+ *
+ * The handler accepts single writes as well as prepared (queued) writes
+ * and reassembles the segments into a statically allocated buffer of
+ * @p _size bytes per connection, indexed by bt_conn_index(). Segments must
+ * arrive in order, a segment at offset 0 starts a new value. Prepared
+ * segments are only bounds-checked when they are queued; the data is
+ * stored when the peer executes the queue.
+ *
+ * @p _cb is called from the attribute callback for every write that is
+ * stored, with the value reassembled so far and its length. A single write
+ * and an executed queue that the host reassembles into one write give one
+ * call with the complete value. When the host hands an executed queue over
+ * segment by segment, @p _cb is called once per segment, each time with
+ * the value up to the end of that segment, and the last call carries the
+ * complete value. The buffer is only valid until the callback returns, the
+ * next write of the connection reuses it.
+ *
+ * The characteristic must be declared with BT_GATT_PERM_PREPARE_WRITE and
+ * CONFIG_BT_ATT_PREPARE_COUNT must cover @p _size divided by the segment
+ * size of the smallest ATT MTU in use.
+ *
+ * @param _name Name of the generated handler.
+ * @param _size Size of the reassembly buffer, at most 512 bytes.
+ * @param _cb   Function called with (const uint8_t *data, uint16_t len).
+ */
+#define GATT_CHRC_LONG_WRITE_DEFINE(_name, _size, _cb)                                             \
+	BUILD_ASSERT((_size) <= 512, #_name ": attribute values are limited to 512 bytes");        \
+                                                                                                   \
+	static struct _name##_buf {                                                                \
+		uint16_t len;                                                                      \
+		uint8_t data[_size];                                                               \
+	} _name##_value[CONFIG_BT_MAX_CONN];                                                       \
+                                                                                                   \
+	static ssize_t _name(struct bt_conn *conn, const struct bt_gatt_attr *attr,                \
+			     const void *buf, uint16_t len, uint16_t offset, uint8_t flags)        \
+	{                                                                                          \
+		struct _name##_buf *value = &_name##_value[bt_conn_index(conn)];                   \
+                                                                                                   \
+		LOG_DBG("Attribute write, handle: %u, conn: %p, offset: %u, len: %u",              \
+			attr->handle, (void *)conn, offset, len);                                  \
+                                                                                                   \
+		if ((uint32_t)offset + len > (_size)) {                                            \
+			LOG_DBG(#_name ": Write exceeds %u bytes", (unsigned int)(_size));         \
+			return BT_GATT_ERR(BT_ATT_ERR_INVALID_ATTRIBUTE_LEN);                      \
+		}                                                                                  \
+                                                                                                   \
+		if (flags & BT_GATT_WRITE_FLAG_PREPARE) {                                          \
+			return 0;                                                                  \
+		}                                                                                  \
+                                                                                                   \
+		if (offset == 0) {                                                                 \
+			value->len = 0;                                                            \
+		}                                                                                  \
+                                                                                                   \
+		if (offset != value->len) {                                                        \
+			LOG_DBG(#_name ": Incorrect data offset");                                 \
+			return BT_GATT_ERR(BT_ATT_ERR_INVALID_OFFSET);                             \
+		}                                                                                  \
+                                                                                                   \
+		memcpy(&value->data[offset], buf, len);                                            \
+		value->len = offset + len;                                                         \
+                                                                                                   \
+		_cb(value->data, value->len);                                                      \
+                                                                                                   \
+		return len;                                                                        \
+	}
+
+/** @brief Define a CCC changed callback and the flag it maintains.
+ *
+ * @param _name  Name of the generated callback.
+ * @param _flag  Name of the generated flag, set while the peer has
+ *               @p _value enabled.
+ * @param _value CCC value to track, BT_GATT_CCC_NOTIFY or
+ *               BT_GATT_CCC_INDICATE.
+ */
+#define GATT_CHRC_CCC_DEFINE(_name, _flag, _value)                                                \
+	static bool _flag;                                                                         \
+                                                                                                   \
+	static void _name(const struct bt_gatt_attr *attr, uint16_t value)                         \
+	{                                                                                          \
+		_flag = (value == (_value));                                                       \
+	}
+
+/** @brief Define a function that notifies a scalar characteristic.
+ *
+ * The generated function returns -EACCES while notifications are disabled
+ * and the result of bt_gatt_notify() otherwise.
+ *
+ * @param _name Name of the generated function.
+ * @param _type Type of the characteristic value.
+ * @param _attr Characteristic value attribute, for example
+ *              &my_svc.attrs[2].
+ * @param _flag Flag generated by GATT_CHRC_CCC_DEFINE().
+ */
+#define GATT_CHRC_NOTIFY_DEFINE(_name, _type, _attr, _flag)                                       \
+	static inline int _name(_type val)                                                         \
+	{                                                                                          \
+		if (!_flag) {                                                                      \
+			return -EACCES;                                                            \
+		}                                                                                  \
+                                                                                                   \
+		return bt_gatt_notify(NULL, _attr, &val, sizeof(val));                             \
+	}
+
+/** @brief Define a function that notifies a scalar characteristic and
+ *  reports when the notification has been sent.
+ *
+ * Like GATT_CHRC_NOTIFY_DEFINE(), but the generated function takes the
+ * completion callback of bt_gatt_notify_cb() and its user data, both of
+ * which may be NULL.
+ *
+ * @param _name Name of the generated function.
+ * @param _type Type of the characteristic value.
+ * @param _attr Characteristic value attribute, for example
+ *              &my_svc.attrs[2].
+ * @param _flag Flag generated by GATT_CHRC_CCC_DEFINE().
+ */
+#define GATT_CHRC_NOTIFY_CB_DEFINE(_name, _type, _attr, _flag)                                    \
+	static inline int _name(_type val, bt_gatt_complete_func_t func, void *user_data)          \
+	{                                                                                          \
+		struct bt_gatt_notify_params params = {                                            \
+			.attr = _attr,                                                             \
+			.data = &val,                                                              \
+			.len = sizeof(val),                                                        \
+			.func = func,                                                              \
+			.user_data = user_data,                                                    \
+		};                                                                                 \
+                                                                                                   \
+		if (!_flag) {                                                                      \
+			return -EACCES;                                                            \
+		}                                                                                  \
+                                                                                                   \
+		return bt_gatt_notify_cb(NULL, &params);                                           \
+	}
+
+#ifdef __cplusplus
+}
+#endif
+
+/**
+ * @}
+ */
+
+#endif /* GATT_CHRC_H_ */
@@ -0,0 +1,448 @@
+/*
+ * Copyright (c) 2023 Nordic Semiconductor ASA
+ *
+ * SPDX-License-Identifier: LicenseRef-Nordic-5-Clause
+ */
+
+/** @file
+ *  @brief Advertising data manager
+ */
+
+#include <zephyr/types.h>
+#include <errno.h>
+#include <string.h>
+#include <zephyr/kernel.h>
+#include <zephyr/sys/atomic.h>
+#include <zephyr/sys/byteorder.h>
+#include <zephyr/bluetooth/bluetooth.h>
+#include <zephyr/bluetooth/gap.h>
+#include <zephyr/bluetooth/hci.h>
+
+#include "adv_mgr.h"
+#include "conn_time.h"
+
+#include <zephyr/logging/log.h>
+LOG_MODULE_REGISTER(adv_mgr, LOG_LEVEL_INF);
+
+#define ADV_MGR_MAX_FIELDS 8
+#if defined(CONFIG_BT_EXT_ADV)
+#define ADV_MGR_DATA_LEN CONFIG_APP_ADV_DATA_LEN_MAX
+#else
+#define ADV_MGR_DATA_LEN BT_GAP_ADV_MAX_ADV_DATA_LEN
+#endif
+
+enum adv_pdu {
+	ADV_PDU_AD,
+	ADV_PDU_SD,
+
+	ADV_PDU_COUNT,
+};
+
+/* Encoded AD structure and the application data it is built from */
+struct adv_mgr_field {
+	const struct bt_data *src;
+	uint8_t pdu;
+	/* Offset of the data (after length and type) in the PDU */
+	uint16_t offset;
+};
+
+struct adv_pdu_buf {
+	uint16_t len;
+	uint8_t data[ADV_MGR_DATA_LEN];
+};
+
+static struct adv_mgr_field fields[ADV_MGR_MAX_FIELDS];
+static size_t field_count;
+static struct adv_pdu_buf pdus[ADV_PDU_COUNT];
+
+static atomic_t dirty;
+static uint32_t interval_ms;
+
+/* Guards the PDUs, last_push and stats, which the application may change
+ * from any context.
+ */
+static struct k_spinlock pdu_lock;
+static int64_t last_push;
+static struct adv_mgr_stats stats;
+
+/* bt_data view of the payloads passed to adv_mgr_start_raw() and
+ * adv_mgr_payload_set()
+ */
+static struct bt_data raw_fields[ADV_PDU_COUNT][ADV_MGR_MAX_FIELDS];
+
+#if defined(CONFIG_BT_EXT_ADV)
+static struct bt_le_ext_adv *adv_set;
+#endif
+
+static int pdu_encode(enum adv_pdu pdu, const struct bt_data *data, size_t len)
+{
+	struct adv_pdu_buf *buf = &pdus[pdu];
+
+	buf->len = 0;
+
+	for (size_t i = 0; i < len; i++) {
+		if (buf->len + 2 + data[i].data_len > sizeof(buf->data)) {
+			LOG_ERR("AD structure 0x%02x does not fit", data[i].type);
+			return -EINVAL;
+		}
+
+		if (field_count == ARRAY_SIZE(fields)) {
+			return -ENOMEM;
+		}
+
+		buf->data[buf->len++] = data[i].data_len + 1;
+		buf->data[buf->len++] = data[i].type;
+		memcpy(&buf->data[buf->len], data[i].data, data[i].data_len);
+
+		fields[field_count].src = &data[i];
+		fields[field_count].pdu = pdu;
+		fields[field_count].offset = buf->len;
+		field_count++;
+
+		buf->len += data[i].data_len;
+	}
+
+	return 0;
+}
+
+#if defined(CONFIG_BT_EXT_ADV)
+static int data_write(void)
+{
+	/* bt_le_ext_adv_set_data() rewrites both PDUs, whichever changed, and
+	 * the host only takes bt_data arrays. Describe a snapshot of the
+	 * encoded PDUs with bt_data elements pointing into it.
+	 */
+	static struct adv_pdu_buf snap[ADV_PDU_COUNT];
+	struct bt_data data[ADV_PDU_COUNT][ADV_MGR_MAX_FIELDS];
+	size_t count[ADV_PDU_COUNT] = { 0 };
+	k_spinlock_key_t key;
+
+	key = k_spin_lock(&pdu_lock);
+	memcpy(snap, pdus, sizeof(snap));
+	for (int pdu = 0; pdu < ADV_PDU_COUNT; pdu++) {
+		stats.hci_cmds += DIV_ROUND_UP(snap[pdu].len, BT_HCI_LE_EXT_ADV_FRAG_MAX_LEN);
+	}
+	k_spin_unlock(&pdu_lock, key);
+
+	for (size_t i = 0; i < field_count; i++) {
+		const struct adv_mgr_field *field = &fields[i];
+		struct bt_data *d = &data[field->pdu][count[field->pdu]++];
+
+		d->type = snap[field->pdu].data[field->offset - 1];
+		d->data_len = field->src->data_len;
+		d->data = &snap[field->pdu].data[field->offset];
+	}
+
+	return bt_le_ext_adv_set_data(adv_set, data[ADV_PDU_AD], count[ADV_PDU_AD],
+				      data[ADV_PDU_SD], count[ADV_PDU_SD]);
+}
+#else
+static int pdu_write(enum adv_pdu pdu)
+{
+	/* Set Advertising Data and Set Scan Response Data share a layout. */
+	uint16_t opcode = (pdu == ADV_PDU_AD) ? BT_HCI_OP_LE_SET_ADV_DATA :
+						BT_HCI_OP_LE_SET_SCAN_RSP_DATA;
+	struct bt_hci_cp_le_set_adv_data *cp;
+	struct net_buf *buf;
+	k_spinlock_key_t key;
+
+	buf = bt_hci_cmd_create(opcode, sizeof(*cp));
+	if (!buf) {
+		return -ENOBUFS;
+	}
+
+	cp = net_buf_add(buf, sizeof(*cp));
+	memset(cp, 0, sizeof(*cp));
+
+	key = k_spin_lock(&pdu_lock);
+	cp->len = pdus[pdu].len;
+	memcpy(cp->data, pdus[pdu].data, pdus[pdu].len);
+	stats.hci_cmds++;
+	k_spin_unlock(&pdu_lock, key);
+
+	return bt_hci_cmd_send_sync(opcode, buf, NULL);
+}
+
+static int data_write(atomic_val_t pending)
+{
+	int err;
+
+	/* Legacy PDUs are written separately, so skip the unchanged one. */
+	for (int pdu = 0; pdu < ADV_PDU_COUNT; pdu++) {
+		if (!(pending & BIT(pdu))) {
+			continue;
+		}
+
+		err = pdu_write(pdu);
+		if (err) {
+			return err;
+		}
+	}
+
+	return 0;
+}
+#endif /* CONFIG_BT_EXT_ADV */
+
+static void push_work_handler(struct k_work *work)
+{
+	atomic_val_t pending = atomic_clear(&dirty);
+	k_spinlock_key_t key;
+	int err;
+
+	/* An earlier run already wrote the changes that rescheduled this one. */
+	if (!pending) {
+		return;
+	}
+
+	key = k_spin_lock(&pdu_lock);
+	last_push = k_uptime_get();
+	k_spin_unlock(&pdu_lock, key);
+
+#if defined(CONFIG_BT_EXT_ADV)
+	err = data_write();
+#else
+	err = data_write(pending);
+#endif
+	if (err) {
+		LOG_ERR("Failed to write advertising data (err %d)", err);
+	}
+}
+
+static K_WORK_DELAYABLE_DEFINE(push_work, push_work_handler);
+
+static void pdu_dirty(atomic_val_t pending)
+{
+	k_spinlock_key_t key;
+	int64_t elapsed;
+
+	key = k_spin_lock(&pdu_lock);
+	stats.requests++;
+	elapsed = k_uptime_get() - last_push;
+	k_spin_unlock(&pdu_lock, key);
+
+	atomic_or(&dirty, pending);
+
+	/* Coalesce with a pending write, or delay to the next interval. */
+	k_work_schedule(&push_work,
+			K_MSEC(elapsed >= interval_ms ? 0 : interval_ms - elapsed));
+}
+
+int adv_mgr_start(const struct bt_le_adv_param *param, const struct bt_data *ad, size_t ad_len,
+		  const struct bt_data *sd, size_t sd_len)
+{
+	k_spinlock_key_t key;
+	int err;
+
+	field_count = 0;
+
+	err = pdu_encode(ADV_PDU_AD, ad, ad_len);
+	if (err) {
+		return err;
+	}
+
+	err = pdu_encode(ADV_PDU_SD, sd, sd_len);
+	if (err) {
+		return err;
+	}
+
+	interval_ms = CONN_TIME_ADV_US(param->interval_min) / USEC_PER_MSEC;
+	atomic_clear(&dirty);
+
+	key = k_spin_lock(&pdu_lock);
+	last_push = k_uptime_get();
+	memset(&stats, 0, sizeof(stats));
+	k_spin_unlock(&pdu_lock, key);
+
+#if defined(CONFIG_BT_EXT_ADV)
+	if (!adv_set) {
+		err = bt_le_ext_adv_create(param, NULL, &adv_set);
+	} else {
+		err = bt_le_ext_adv_update_param(adv_set, param);
+	}
+	if (err) {
+		return err;
+	}
+
+	err = bt_le_ext_adv_set_data(adv_set, ad, ad_len, sd, sd_len);
+	if (err) {
+		return err;
+	}
+
+	return bt_le_ext_adv_start(adv_set, BT_LE_EXT_ADV_START_DEFAULT);
+#else
+	return bt_le_adv_start(param, ad, ad_len, sd, sd_len);
+#endif
+}
+
+static int raw_parse(const uint8_t *buf, size_t len, struct bt_data *data, size_t *count)
+{
+	size_t n = 0;
+
+	for (size_t i = 0; i < len; i += 1 + buf[i]) {
+		if (buf[i] == 0 || i + 1 + buf[i] > len) {
+			return -EINVAL;
+		}
+
+		if (n == ADV_MGR_MAX_FIELDS) {
+			return -ENOMEM;
+		}
+
+		data[n].type = buf[i + 1];
+		data[n].data_len = buf[i] - 1;
+		data[n].data = &buf[i + 2];
+		n++;
+	}
+
+	*count = n;
+
+	return 0;
+}
+
+int adv_mgr_start_raw(const struct bt_le_adv_param *param, const void *ad, size_t ad_len,
+		      const void *sd, size_t sd_len)
+{
+	size_t ad_count;
+	size_t sd_count;
+	int err;
+
+	err = raw_parse(ad, ad_len, raw_fields[ADV_PDU_AD], &ad_count);
+	if (err) {
+		return err;
+	}
+
+	err = raw_parse(sd, sd_len, raw_fields[ADV_PDU_SD], &sd_count);
+	if (err) {
+		return err;
+	}
+
+	return adv_mgr_start(param, raw_fields[ADV_PDU_AD], ad_count, raw_fields[ADV_PDU_SD],
+			     sd_count);
+}
+
+int adv_mgr_payload_set(const void *ad, size_t ad_len, const void *sd, size_t sd_len)
+{
+	const uint8_t *buf[ADV_PDU_COUNT] = { ad, sd };
+	size_t len[ADV_PDU_COUNT] = { ad_len, sd_len };
+	struct bt_data data[ADV_PDU_COUNT][ADV_MGR_MAX_FIELDS];
+	size_t count[ADV_PDU_COUNT];
+	atomic_val_t changed = 0;
+	k_spinlock_key_t key;
+	int err;
+
+	for (int pdu = 0; pdu < ADV_PDU_COUNT; pdu++) {
+		if (len[pdu] > ADV_MGR_DATA_LEN) {
+			return -EINVAL;
+		}
+
+		err = raw_parse(buf[pdu], len[pdu], data[pdu], &count[pdu]);
+		if (err) {
+			return err;
+		}
+	}
+
+	if (count[ADV_PDU_AD] + count[ADV_PDU_SD] > ADV_MGR_MAX_FIELDS) {
+		return -ENOMEM;
+	}
+
+	key = k_spin_lock(&pdu_lock);
+
+	/* The encoding of a payload is the payload itself, so compare the
+	 * bytes to leave an unchanged PDU alone.
+	 */
+	for (int pdu = 0; pdu < ADV_PDU_COUNT; pdu++) {
+		if (len[pdu] != pdus[pdu].len ||
+		    (len[pdu] && memcmp(pdus[pdu].data, buf[pdu], len[pdu]))) {
+			changed |= BIT(pdu);
+		}
+	}
+
+	if (changed) {
+		/* Cannot fail, the payloads were checked above. */
+		memcpy(raw_fields, data, sizeof(raw_fields));
+		field_count = 0;
+		(void)pdu_encode(ADV_PDU_AD, raw_fields[ADV_PDU_AD], count[ADV_PDU_AD]);
+		(void)pdu_encode(ADV_PDU_SD, raw_fields[ADV_PDU_SD], count[ADV_PDU_SD]);
+	}
+
+	k_spin_unlock(&pdu_lock, key);
+
+	if (changed) {
+		pdu_dirty(changed);
+	}
+
+	return 0;
+}
+
+int adv_mgr_data_changed(uint8_t type)
+{
+	const struct adv_mgr_field *field = adv_mgr_field_get(type);
+
+	if (!field) {
+		return -ENOENT;
+	}
+
+	return adv_mgr_field_write(field, 0, field->src->data, field->src->data_len);
+}
+
+#if defined(CONFIG_BT_EXT_ADV)
+struct bt_le_ext_adv *adv_mgr_adv_set(void)
+{
+	return adv_set;
+}
+#endif
+
+const struct adv_mgr_field *adv_mgr_field_get(uint8_t type)
+{
+	for (size_t i = 0; i < field_count; i++) {
+		if (fields[i].src->type == type) {
+			return &fields[i];
+		}
+	}
+
+	return NULL;
+}
+
+int adv_mgr_field_write(const struct adv_mgr_field *field, size_t offset, const void *data,
+			size_t len)
+{
+	k_spinlock_key_t key;
+
+	if (offset + len > field->src->data_len) {
+		return -EINVAL;
+	}
+
+	key = k_spin_lock(&pdu_lock);
+	memcpy(&pdus[field->pdu].data[field->offset + offset], data, len);
+	k_spin_unlock(&pdu_lock, key);
+
+	pdu_dirty(BIT(field->pdu));
+
+	return 0;
+}
+
+uint16_t adv_mgr_field_inc16(const struct adv_mgr_field *field, size_t offset)
+{
+	uint8_t *val = &pdus[field->pdu].data[field->offset + offset];
+	k_spinlock_key_t key;
+	uint16_t count;
+
+	__ASSERT_NO_MSG(offset + sizeof(count) <= field->src->data_len);
+
+	key = k_spin_lock(&pdu_lock);
+	count = sys_get_le16(val) + 1;
+	sys_put_le16(count, val);
+	k_spin_unlock(&pdu_lock, key);
+
+	pdu_dirty(BIT(field->pdu));
+
+	return count;
+}
+
+void adv_mgr_stats_get(struct adv_mgr_stats *out)
+{
+	k_spinlock_key_t key;
+
+	key = k_spin_lock(&pdu_lock);
+	*out = stats;
+	k_spin_unlock(&pdu_lock, key);
+}
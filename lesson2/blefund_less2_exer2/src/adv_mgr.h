@@ -0,0 +1,178 @@
+/*
+ * Copyright (c) 2023 Nordic Semiconductor ASA
+ *
+ * SPDX-License-Identifier: LicenseRef-Nordic-5-Clause
+ */
+
+#ifndef ADV_MGR_H_
+#define ADV_MGR_H_
+
+/**@file
+ * @defgroup adv_mgr Advertising data manager
+ * @{
+ * @brief Coalesced updates of the advertising and scan response data.
+ *
+ * The manager keeps an encoded copy of the advertising (AD) and scan
+ * response (SR) payloads. When the application changes the data behind
+ * one AD structure, only that structure is re-encoded and only the PDU
+ * holding it is marked dirty. Dirty PDUs are written to the controller
+ * at most once per advertising interval, so a burst of changes costs a
+ * single controller command per PDU.
+ *
+ * With CONFIG_BT_EXT_ADV the manager runs one extended advertising set
+ * instead, and the data can be up to CONFIG_APP_ADV_DATA_LEN_MAX bytes.
+ */
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <zephyr/types.h>
+#include <zephyr/bluetooth/bluetooth.h>
+
+/** @brief AD structure handled by the manager. */
+struct adv_mgr_field;
+
+/** @brief Advertising data manager statistics. */
+struct adv_mgr_stats {
+	/** Number of change requests from the application. */
+	uint32_t requests;
+	/** Number of HCI commands sent to update the data. Extended
+	 *  advertising data counts one command per fragment.
+	 */
+	uint32_t hci_cmds;
+};
+
+/** @brief Start advertising through the manager.
+ *
+ * Takes the same arguments as bt_le_adv_start(). The bt_data arrays and
+ * the data they point to must stay valid while advertising, the manager
+ * re-reads them on adv_mgr_data_changed().
+ *
+ * @param[in] param Advertising parameters.
+ * @param[in] ad Data to be used in advertisement packets.
+ * @param[in] ad_len Number of elements in @p ad.
+ * @param[in] sd Data to be used in scan response packets.
+ * @param[in] sd_len Number of elements in @p sd.
+ *
+ * @retval 0 If the operation was successful.
+ *           Otherwise, a (negative) error code is returned.
+ */
+int adv_mgr_start(const struct bt_le_adv_param *param, const struct bt_data *ad, size_t ad_len,
+		  const struct bt_data *sd, size_t sd_len);
+
+/** @brief Start advertising encoded payloads through the manager.
+ *
+ * Same as adv_mgr_start(), but takes the advertising and scan response
+ * data as encoded AD structures, for example laid out with adv_build.h.
+ * The payloads must stay valid while advertising. To update a field,
+ * change it in place and call adv_mgr_data_changed().
+ *
+ * @param[in] param Advertising parameters.
+ * @param[in] ad Encoded advertising data.
+ * @param[in] ad_len Length of @p ad in bytes.
+ * @param[in] sd Encoded scan response data, or NULL.
+ * @param[in] sd_len Length of @p sd in bytes.
+ *
+ * @retval 0 If the operation was successful.
+ * @retval -EINVAL If a payload is not correctly encoded.
+ *           Otherwise, a (negative) error code is returned.
+ */
+int adv_mgr_start_raw(const struct bt_le_adv_param *param, const void *ad, size_t ad_len,
+		      const void *sd, size_t sd_len);
+
+/** @brief Replace the advertising and scan response data.
+ *
+ * Takes encoded payloads like adv_mgr_start_raw(), and writes only the
+ * PDUs whose bytes differ from the current ones to the controller, at
+ * the next allowed point in time. The payloads must stay valid until
+ * they are replaced. Fields from adv_mgr_field_get() are invalidated.
+ *
+ * @param[in] ad Encoded advertising data.
+ * @param[in] ad_len Length of @p ad in bytes.
+ * @param[in] sd Encoded scan response data, or NULL.
+ * @param[in] sd_len Length of @p sd in bytes.
+ *
+ * @retval 0 If the operation was successful.
+ * @retval -EINVAL If a payload is not correctly encoded or too long.
+ *           Otherwise, a (negative) error code is returned.
+ */
+int adv_mgr_payload_set(const void *ad, size_t ad_len, const void *sd, size_t sd_len);
+
+/** @brief Notify the manager that the data of an AD structure changed.
+ *
+ * The structure is re-encoded from its bt_data element and its PDU is
+ * written to the controller at the next allowed point in time. The
+ * length of the data must not change.
+ *
+ * @param[in] type AD type of the structure, for example
+ *                 BT_DATA_MANUFACTURER_DATA.
+ *
+ * @retval 0 If the operation was successful.
+ * @retval -ENOENT If no structure of this type is advertised.
+ */
+int adv_mgr_data_changed(uint8_t type);
+
+/** @brief Get the AD structure of a type.
+ *
+ * The returned field stays valid until advertising is started again.
+ *
+ * @param[in] type AD type of the structure.
+ *
+ * @return The field, or NULL if no structure of this type is advertised.
+ */
+const struct adv_mgr_field *adv_mgr_field_get(uint8_t type);
+
+/** @brief Write part of an AD structure in place.
+ *
+ * Patches the encoded copy that is handed to the controller, without
+ * touching the application data the field was built from. Do not mix
+ * with adv_mgr_data_changed() for the same field, that copies the
+ * application data over the patch.
+ *
+ * @param[in] field Field from adv_mgr_field_get().
+ * @param[in] offset Offset in the data of the structure.
+ * @param[in] data Bytes to write.
+ * @param[in] len Number of bytes to write.
+ *
+ * @retval 0 If the operation was successful.
+ * @retval -EINVAL If the write does not fit in the structure.
+ */
+int adv_mgr_field_write(const struct adv_mgr_field *field, size_t offset, const void *data,
+			size_t len);
+
+/** @brief Increment a little-endian 16-bit counter in an AD structure.
+ *
+ * The read-modify-write is atomic with respect to other writers and to
+ * the controller update. Safe to call from any context.
+ *
+ * @param[in] field Field from adv_mgr_field_get().
+ * @param[in] offset Offset of the counter in the data of the structure.
+ *
+ * @return The new counter value.
+ */
+uint16_t adv_mgr_field_inc16(const struct adv_mgr_field *field, size_t offset);
+
+/** @brief Get the extended advertising set run by the manager.
+ *
+ * Only available with CONFIG_BT_EXT_ADV.
+ *
+ * @return The advertising set, or NULL if advertising was not started.
+ */
+struct bt_le_ext_adv *adv_mgr_adv_set(void);
+
+/** @brief Get the manager statistics.
+ *
+ * @param[out] stats Statistics since advertising was started.
+ */
+void adv_mgr_stats_get(struct adv_mgr_stats *stats);
+
+#ifdef __cplusplus
+}
+#endif
+
+/**
+ * @}
+ */
+
+#endif /* ADV_MGR_H_ */
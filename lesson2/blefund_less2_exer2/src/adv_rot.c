@@ -0,0 +1,163 @@
+/*
+ * Copyright (c) 2023 Nordic Semiconductor ASA
+ *
+ * SPDX-License-Identifier: LicenseRef-Nordic-5-Clause
+ */
+
+/** @file
+ *  @brief Advertising payload rotation
+ */
+
+#include <zephyr/types.h>
+#include <errno.h>
+#include <zephyr/kernel.h>
+#include <zephyr/bluetooth/bluetooth.h>
+
+#include "adv_mgr.h"
+#include "adv_rot.h"
+#include "adv_time.h"
+#include "conn_time.h"
+
+#include <zephyr/logging/log.h>
+LOG_MODULE_REGISTER(adv_rot, LOG_LEVEL_INF);
+
+#define ROT_EVENTS CONFIG_APP_ADV_ROTATION_EVENTS
+#define SEQ_MAX CONFIG_APP_ADV_ROTATION_SEQ_MAX
+#define MAX_PAYLOADS 8
+
+static const struct adv_rot_payload *rot_payloads;
+static size_t rot_count;
+
+/* Payload index of every turn, repeated forever */
+static uint8_t sequence[SEQ_MAX];
+static size_t seq_len;
+static size_t seq_pos;
+
+static uint32_t turn_ms;
+static int64_t next_turn;
+
+/* Only written from the system workqueue */
+static uint32_t turns[MAX_PAYLOADS];
+static uint32_t reported[MAX_PAYLOADS];
+
+/* Smooth weighted round robin: every turn, each payload gains its weight
+ * and the one with the most credit is picked and pays the total weight.
+ */
+static void sequence_build(uint32_t total)
+{
+	int32_t credit[MAX_PAYLOADS] = { 0 };
+
+	for (size_t n = 0; n < total; n++) {
+		size_t best = 0;
+
+		for (size_t i = 0; i < rot_count; i++) {
+			credit[i] += rot_payloads[i].weight;
+			if (credit[i] > credit[best]) {
+				best = i;
+			}
+		}
+
+		credit[best] -= total;
+		sequence[n] = best;
+	}
+
+	seq_len = total;
+}
+
+static void turn_work_handler(struct k_work *work);
+
+static K_WORK_DELAYABLE_DEFINE(turn_work, turn_work_handler);
+
+static void turn_work_handler(struct k_work *work)
+{
+	const struct adv_rot_payload *p;
+	int64_t now = k_uptime_get();
+	int err;
+
+	seq_pos = (seq_pos + 1) % seq_len;
+	p = &rot_payloads[sequence[seq_pos]];
+
+	err = adv_mgr_payload_set(p->ad, p->ad_len, p->sd, p->sd_len);
+	if (err) {
+		LOG_ERR("%s: failed to set payload (err %d)", p->name, err);
+	} else {
+		turns[sequence[seq_pos]]++;
+	}
+
+	/* Keep to the turn grid unless the workqueue fell behind. */
+	next_turn += turn_ms;
+	if (next_turn <= now) {
+		next_turn = now + turn_ms;
+	}
+
+	k_work_reschedule(&turn_work, K_TIMEOUT_ABS_MS(next_turn));
+}
+
+int adv_rot_start(const struct bt_le_adv_param *param, const struct adv_rot_payload *payloads,
+		  size_t count)
+{
+	uint32_t total = 0;
+	int err;
+
+	if (count == 0 || count > MAX_PAYLOADS) {
+		return -EINVAL;
+	}
+
+	for (size_t i = 0; i < count; i++) {
+		if (payloads[i].weight == 0) {
+			return -EINVAL;
+		}
+		total += payloads[i].weight;
+	}
+
+	if (total > SEQ_MAX) {
+		return -EINVAL;
+	}
+
+	rot_payloads = payloads;
+	rot_count = count;
+	sequence_build(total);
+	seq_pos = 0;
+
+	turn_ms = ROT_EVENTS * ADV_TIME_PERIOD_US(CONN_TIME_ADV_US(param->interval_min)) /
+		  USEC_PER_MSEC;
+
+	err = adv_mgr_start_raw(param, payloads[sequence[0]].ad, payloads[sequence[0]].ad_len,
+				payloads[sequence[0]].sd, payloads[sequence[0]].sd_len);
+	if (err) {
+		return err;
+	}
+
+	turns[sequence[0]]++;
+
+	if (seq_len > 1) {
+		next_turn = k_uptime_get() + turn_ms;
+		k_work_schedule(&turn_work, K_TIMEOUT_ABS_MS(next_turn));
+	}
+
+	return 0;
+}
+
+void adv_rot_report(void)
+{
+	uint32_t total = 0;
+
+	for (size_t i = 0; i < rot_count; i++) {
+		total += turns[i] - reported[i];
+	}
+
+	if (total == 0) {
+		return;
+	}
+
+	for (size_t i = 0; i < rot_count; i++) {
+		uint32_t n = turns[i] - reported[i];
+
+		/* Estimated from the turns, the controller does not report
+		 * legacy advertising events.
+		 */
+		LOG_INF("%s: weight %u, %u advertising events (%u%%)", rot_payloads[i].name,
+			rot_payloads[i].weight, n * ROT_EVENTS, n * 100U / total);
+		reported[i] += n;
+	}
+}
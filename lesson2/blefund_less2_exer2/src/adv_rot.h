@@ -0,0 +1,76 @@
+/*
+ * Copyright (c) 2023 Nordic Semiconductor ASA
+ *
+ * SPDX-License-Identifier: LicenseRef-Nordic-5-Clause
+ */
+
+#ifndef ADV_ROT_H_
+#define ADV_ROT_H_
+
+/**@file
+ * @defgroup adv_rot Advertising payload rotation
+ * @{
+ * @brief One advertiser that takes turns broadcasting several beacons.
+ *
+ * Every payload is shown for CONFIG_APP_ADV_ROTATION_EVENTS advertising
+ * events at a time, in proportion to its weight. The order is worked out
+ * once at start with a smooth weighted round robin, so the turns of a
+ * payload are spread out instead of bunched together, and each turn only
+ * costs a table lookup. The payloads are encoded ahead of time and handed
+ * to the advertising data manager, which leaves PDUs that do not change
+ * alone.
+ */
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <zephyr/types.h>
+#include <zephyr/bluetooth/bluetooth.h>
+
+/** @brief Beacon payload taking part in the rotation. */
+struct adv_rot_payload {
+	/** Name used in the report. */
+	const char *name;
+	/** Share of the advertising events, at least 1. */
+	uint8_t weight;
+	/** Encoded advertising data. */
+	const void *ad;
+	/** Length of @p ad in bytes. */
+	size_t ad_len;
+	/** Encoded scan response data, or NULL. */
+	const void *sd;
+	/** Length of @p sd in bytes. */
+	size_t sd_len;
+};
+
+/** @brief Start advertising and rotating the payloads.
+ *
+ * The payloads must stay valid while advertising.
+ *
+ * @param[in] param Advertising parameters.
+ * @param[in] payloads Payloads to rotate.
+ * @param[in] count Number of elements in @p payloads.
+ *
+ * @retval 0 If the operation was successful.
+ * @retval -EINVAL If a weight is 0 or the weights add up to more than
+ *                 CONFIG_APP_ADV_ROTATION_SEQ_MAX.
+ *           Otherwise, a (negative) error code is returned.
+ */
+int adv_rot_start(const struct bt_le_adv_param *param, const struct adv_rot_payload *payloads,
+		  size_t count);
+
+/** @brief Log the advertising events of every payload since the last
+ *  report.
+ */
+void adv_rot_report(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+/**
+ * @}
+ */
+
+#endif /* ADV_ROT_H_ */
@@ -10,71 +10,164 @@
 #include <zephyr/bluetooth/gap.h>
 #include <dk_buttons_and_leds.h>
 
+#include "adv_build.h"
+#include "adv_mgr.h"
+#include "conn_time.h"
+#if defined(CONFIG_APP_PER_ADV)
+#include "per_adv.h"
+#endif
+#if defined(CONFIG_APP_ADV_ROTATION)
+#include "adv_rot.h"
+#endif
+
 #define ADV_INTERVAL_MS 500
-#define ADV_INTERVAL_MIN (ADV_INTERVAL_MS / 0.625)
+#define ADV_INTERVAL_MIN CONN_TIME_MS_TO_ADV(ADV_INTERVAL_MS)
 #define ADV_INTERVAL_MAX (ADV_INTERVAL_MIN + 1)
 
+#if defined(CONFIG_BT_EXT_ADV)
+/* Non-scannable extended advertising, all data goes in the AD */
+#define ADV_OPTIONS (BT_LE_ADV_OPT_EXT_ADV | \
+                     (IS_ENABLED(CONFIG_APP_EXT_ADV_CODED) ? BT_LE_ADV_OPT_CODED : 0))
+#else
+#define ADV_OPTIONS BT_LE_ADV_OPT_NONE
+#endif
+
 #define USER_BUTTON DK_BTN1_MSK
 
  /* STEP 2.1 - Declare the Company identifier (Company ID) */
 #define COMPANY_IDENTIFIER 0x0059 /* Nordic Semiconductor ASA */
 
-/* STEP 2.2 - Declare the structure for your custom data  */
-typedef struct
-{
-    uint16_t company_identifier;
-    uint16_t number_press;          /* Number of button presses. */
-} adv_mfg_data_t;
+#define URL ADV_URI_HTTPS "//academy.nordicsemi.com"
 
 /* STEP 1 - Create an LE Advertising Parameters variable */
-static struct bt_le_adv_param * p_adv_param = BT_LE_ADV_PARAM(BT_LE_ADV_OPT_NONE,
+static struct bt_le_adv_param * p_adv_param = BT_LE_ADV_PARAM(ADV_OPTIONS,
                                                           ADV_INTERVAL_MIN,
                                                           ADV_INTERVAL_MAX,
                                                           NULL);
 
-/* STEP 2.3 - Define and initialize a variable of type adv_mfg_data_type */
-adv_mfg_data_t adv_mfg_data = {
-    .company_identifier = COMPANY_IDENTIFIER,
-    .number_press = 0,
-};
-
-static unsigned char url_data[] = { 0x17, '/', '/', 'a', 'c', 'a', 'd', 'e', 'm',
-                    'y',  '.', 'n', 'o', 'r', 'd', 'i', 'c', 's',
-                    'e',  'm', 'i', '.', 'c', 'o', 'm' };
 LOG_MODULE_REGISTER(Lesson2_Exercise2, LOG_LEVEL_INF);
 
 #define DEVICE_NAME CONFIG_BT_DEVICE_NAME
-#define DEVICE_NAME_LEN (sizeof(DEVICE_NAME) - 1)
 
 #define RUN_STATUS_LED DK_LED1
 #define RUN_LED_BLINK_INTERVAL 1000
+/* Report the advertising data update rate every 10 blinks */
+#define ADV_STATS_BLINKS 10
+
+/* STEP 2.2 - Declare the layout of the advertising data. The manufacturer
+ * data is the Company ID followed by the number of button presses, both
+ * little endian.
+ */
+#define MFG_DATA_LEN 4
+#define MFG_DATA_NUMBER_PRESS 2 /* Offset of the number of presses */
 
-static const struct bt_data ad[] = {
-    BT_DATA_BYTES(BT_DATA_FLAGS, BT_LE_AD_NO_BREDR),
-    BT_DATA(BT_DATA_NAME_COMPLETE, DEVICE_NAME, DEVICE_NAME_LEN),
+struct beacon_ad
+{
+    ADV_FIELD_BYTES(flags, 1);
+    ADV_FIELD_STR(name, DEVICE_NAME);
+    ADV_FIELD_BYTES(mfg_data, MFG_DATA_LEN);
+#if defined(CONFIG_BT_EXT_ADV)
+    /* Fits in the extended advertising data, no scan response needed */
+    ADV_FIELD_STR(uri, URL);
+#endif
+} __packed;
+
+/* STEP 2.3 - Encode the advertising data at build time. The number of
+ * presses is counted in place in the copy the advertising data manager
+ * hands to the controller, so this one is kept in flash.
+ */
+static const struct beacon_ad beacon_ad = {
+    ADV_FIELD_INIT(struct beacon_ad, flags, BT_DATA_FLAGS, { BT_LE_AD_NO_BREDR }),
+    ADV_FIELD_INIT(struct beacon_ad, name, BT_DATA_NAME_COMPLETE, DEVICE_NAME),
     /* STEP 3 - Include the Manufacturer Specific Data in the advertising packet. */
-    BT_DATA(BT_DATA_MANUFACTURER_DATA, (unsigned char *)&adv_mfg_data, sizeof(adv_mfg_data)),
+    ADV_FIELD_INIT(struct beacon_ad, mfg_data, BT_DATA_MANUFACTURER_DATA,
+                   { ADV_LE16(COMPANY_IDENTIFIER), ADV_LE16(0) }),
+#if defined(CONFIG_BT_EXT_ADV)
+    ADV_FIELD_INIT(struct beacon_ad, uri, BT_DATA_URI, URL),
+#endif
+};
+
+#if defined(CONFIG_BT_EXT_ADV)
+ADV_PAYLOAD_CHECK_LEN(struct beacon_ad, CONFIG_APP_ADV_DATA_LEN_MAX);
+
+#define SD NULL
+#define SD_LEN 0
+#else
+ADV_PAYLOAD_CHECK(struct beacon_ad);
+
+struct beacon_sd
+{
+    ADV_FIELD_STR(uri, URL);
+} __packed;
+
+/* The scan response never changes and is kept in flash */
+static const struct beacon_sd beacon_sd = {
+    ADV_FIELD_INIT(struct beacon_sd, uri, BT_DATA_URI, URL),
+};
+
+ADV_PAYLOAD_CHECK(struct beacon_sd);
+
+#define SD &beacon_sd
+#define SD_LEN sizeof(beacon_sd)
+#endif
+
+#if defined(CONFIG_APP_ADV_ROTATION)
+/* Further beacons that take turns with the one above */
+#define DEVZONE_URL ADV_URI_HTTPS "//devzone.nordicsemi.com"
+#define TAG_NAME "Nordic_Tag"
+#define TAG_ID 0x0001
+
+struct devzone_ad
+{
+    ADV_FIELD_BYTES(flags, 1);
+    ADV_FIELD_STR(uri, DEVZONE_URL);
+} __packed;
+
+static const struct devzone_ad devzone_ad = {
+    ADV_FIELD_INIT(struct devzone_ad, flags, BT_DATA_FLAGS, { BT_LE_AD_NO_BREDR }),
+    ADV_FIELD_INIT(struct devzone_ad, uri, BT_DATA_URI, DEVZONE_URL),
+};
+
+ADV_PAYLOAD_CHECK(struct devzone_ad);
+
+struct tag_ad
+{
+    ADV_FIELD_BYTES(flags, 1);
+    ADV_FIELD_STR(name, TAG_NAME);
+    ADV_FIELD_BYTES(mfg_data, MFG_DATA_LEN);
+} __packed;
+
+static const struct tag_ad tag_ad = {
+    ADV_FIELD_INIT(struct tag_ad, flags, BT_DATA_FLAGS, { BT_LE_AD_NO_BREDR }),
+    ADV_FIELD_INIT(struct tag_ad, name, BT_DATA_NAME_COMPLETE, TAG_NAME),
+    ADV_FIELD_INIT(struct tag_ad, mfg_data, BT_DATA_MANUFACTURER_DATA,
+                   { ADV_LE16(COMPANY_IDENTIFIER), ADV_LE16(TAG_ID) }),
 };
 
-static const struct bt_data sd[] = {
-    BT_DATA(BT_DATA_URI, url_data, sizeof(url_data)),
+ADV_PAYLOAD_CHECK(struct tag_ad);
+
+static const struct adv_rot_payload beacons[] = {
+    { "Academy", 4, &beacon_ad, sizeof(beacon_ad), SD, SD_LEN },
+    { "DevZone", 2, &devzone_ad, sizeof(devzone_ad), NULL, 0 },
+    { "Tag", 1, &tag_ad, sizeof(tag_ad), NULL, 0 },
 };
+#endif
+
+static const struct adv_mgr_field *mfg_data_field;
+
 /* STEP 5 - Add the definition of callback function and update the advertising data dynamically */
 void button_handler(uint32_t button_state, uint32_t has_changed)
 {
-    int err;
     if (has_changed & USER_BUTTON)
     {
-        if (button_state & USER_BUTTON)
+        if ((button_state & USER_BUTTON) && mfg_data_field)
         {
-            adv_mfg_data.number_press++;
-            /* STEP 5.1 - Update the advertising data */
-            err = bt_le_adv_update_data(ad, ARRAY_SIZE(ad), sd, ARRAY_SIZE(sd));
-            if (err)
-            {
-                LOG_ERR("Advertising failed to start (err %d)\n", err);
-                return;
-            }
+            /* STEP 5.1 - Update the advertising data.
+             * Only the counter in the manufacturer data is patched, and
+             * presses within one advertising interval are sent to the
+             * controller together.
+             */
+            adv_mgr_field_inc16(mfg_data_field, MFG_DATA_NUMBER_PRESS);
         }
     }
 }
@@ -94,6 +187,34 @@ static int init_button(void)
 
 
 
+static void report_adv_stats(void)
+{
+    static struct adv_mgr_stats last;
+    struct adv_mgr_stats stats;
+    uint32_t period_s = ADV_STATS_BLINKS * RUN_LED_BLINK_INTERVAL / MSEC_PER_SEC;
+
+    adv_mgr_stats_get(&stats);
+    if (stats.requests == last.requests)
+    {
+        return;
+    }
+
+    LOG_INF("Advertising data: %u updates, %u HCI commands in %u s (%u total)\n",
+            stats.requests - last.requests, stats.hci_cmds - last.hci_cmds, period_s,
+            stats.hci_cmds);
+    last = stats;
+}
+
+#if defined(CONFIG_APP_PER_ADV)
+/* Simulated temperature sensor in 0.01 degrees C, a slow triangle wave */
+static int16_t sensor_read(void)
+{
+    uint32_t phase = (k_uptime_get_32() / MSEC_PER_SEC) % 40;
+
+    return 2300 + 20 * (phase < 20 ? phase : 40 - phase);
+}
+#endif
+
 void main(void)
 {
     int blink_status = 0;
@@ -124,7 +245,11 @@ void main(void)
 
     LOG_INF("Bluetooth initialized\n");
 
-    err = bt_le_adv_start(p_adv_param, ad, ARRAY_SIZE(ad), sd, ARRAY_SIZE(sd));
+#if defined(CONFIG_APP_ADV_ROTATION)
+    err = adv_rot_start(p_adv_param, beacons, ARRAY_SIZE(beacons));
+#else
+    err = adv_mgr_start_raw(p_adv_param, &beacon_ad, sizeof(beacon_ad), SD, SD_LEN);
+#endif
     if (err)
     {
         LOG_ERR("Advertising failed to start (err %d)\n", err);
@@ -133,9 +258,33 @@ void main(void)
 
     LOG_INF("Advertising successfully started\n");
 
+#if !defined(CONFIG_APP_ADV_ROTATION)
+    /* The fields change with every turn of the rotation. */
+    mfg_data_field = adv_mgr_field_get(BT_DATA_MANUFACTURER_DATA);
+#endif
+
+#if defined(CONFIG_APP_PER_ADV)
+    err = per_adv_start(adv_mgr_adv_set(), COMPANY_IDENTIFIER);
+    if (err)
+    {
+        LOG_ERR("Periodic advertising failed to start (err %d)\n", err);
+        return;
+    }
+#endif
+
     for (;;)
     {
         dk_set_led(RUN_STATUS_LED, (++blink_status) % 2);
+        if (blink_status % ADV_STATS_BLINKS == 0)
+        {
+            report_adv_stats();
+#if defined(CONFIG_APP_ADV_ROTATION)
+            adv_rot_report();
+#endif
+        }
+#if defined(CONFIG_APP_PER_ADV)
+        per_adv_sample(sensor_read());
+#endif
         k_sleep(K_MSEC(RUN_LED_BLINK_INTERVAL));
     }
 }
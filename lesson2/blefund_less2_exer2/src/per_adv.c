@@ -0,0 +1,120 @@
+/*
+ * Copyright (c) 2023 Nordic Semiconductor ASA
+ *
+ * SPDX-License-Identifier: LicenseRef-Nordic-5-Clause
+ */
+
+/** @file
+ *  @brief Periodic advertising telemetry
+ */
+
+#include <zephyr/types.h>
+#include <string.h>
+#include <zephyr/kernel.h>
+#include <zephyr/sys/byteorder.h>
+#include <zephyr/bluetooth/bluetooth.h>
+
+#include "per_adv.h"
+#include "conn_time.h"
+
+#include <zephyr/logging/log.h>
+LOG_MODULE_REGISTER(per_adv, LOG_LEVEL_INF);
+
+#define PER_ADV_INTERVAL CONFIG_APP_PER_ADV_INTERVAL
+#define PER_ADV_SAMPLES CONFIG_APP_PER_ADV_SAMPLES
+
+static struct bt_le_ext_adv *per_adv_set;
+
+static struct per_adv_frame frame;
+static bool frame_dirty;
+static uint16_t frame_seq;
+static struct k_spinlock frame_lock;
+
+static void send_work_handler(struct k_work *work)
+{
+	struct per_adv_frame copy;
+	struct bt_data ad;
+	k_spinlock_key_t key;
+	int err;
+
+	key = k_spin_lock(&frame_lock);
+	if (!frame_dirty) {
+		k_spin_unlock(&frame_lock, key);
+		return;
+	}
+
+	frame.seq = sys_cpu_to_le16(frame_seq++);
+	copy = frame;
+	frame_dirty = false;
+	k_spin_unlock(&frame_lock, key);
+
+	ad.type = BT_DATA_MANUFACTURER_DATA;
+	ad.data_len = sizeof(copy);
+	ad.data = (const uint8_t *)&copy;
+
+	/* The stack copies the data, so the frame is free again on return. */
+	err = bt_le_per_adv_set_data(per_adv_set, &ad, 1);
+	if (err) {
+		LOG_ERR("Failed to set periodic advertising data (err %d)", err);
+	}
+}
+
+static K_WORK_DEFINE(send_work, send_work_handler);
+
+static void frame_timer_expired(struct k_timer *timer)
+{
+	k_work_submit(&send_work);
+}
+
+static K_TIMER_DEFINE(frame_timer, frame_timer_expired, NULL);
+
+int per_adv_start(struct bt_le_ext_adv *adv, uint16_t company_id)
+{
+	const struct bt_le_per_adv_param param =
+		BT_LE_PER_ADV_PARAM_INIT(PER_ADV_INTERVAL, PER_ADV_INTERVAL, BT_LE_PER_ADV_OPT_NONE);
+	int err;
+
+	per_adv_set = adv;
+	frame.company_id = sys_cpu_to_le16(company_id);
+	frame_dirty = true;
+
+	err = bt_le_per_adv_set_param(adv, &param);
+	if (err) {
+		return err;
+	}
+
+	/* Have data in place before the first periodic event. */
+	send_work_handler(NULL);
+
+	err = bt_le_per_adv_start(adv);
+	if (err) {
+		return err;
+	}
+
+	/* The controller sends one frame per periodic event, so updating
+	 * more often only costs HCI traffic. The timer is not aligned with
+	 * the events, a frame may be sent in more than one of them.
+	 */
+	k_timer_start(&frame_timer, K_USEC(CONN_TIME_INTERVAL_US(PER_ADV_INTERVAL)),
+		      K_USEC(CONN_TIME_INTERVAL_US(PER_ADV_INTERVAL)));
+
+	LOG_INF("Periodic advertising started, interval " CONN_TIME_FMT ", %zu byte frame",
+		CONN_TIME_ARGS(CONN_TIME_INTERVAL_US(PER_ADV_INTERVAL)),
+		sizeof(struct per_adv_frame));
+
+	return 0;
+}
+
+void per_adv_sample(int16_t sample)
+{
+	k_spinlock_key_t key = k_spin_lock(&frame_lock);
+
+	/* Shift the window, the newest sample goes last. */
+	memmove(&frame.samples[0], &frame.samples[1],
+		sizeof(frame.samples) - sizeof(frame.samples[0]));
+	frame.samples[PER_ADV_SAMPLES - 1] = sys_cpu_to_le16(sample);
+	frame.uptime_ms = sys_cpu_to_le32(k_uptime_get_32());
+	frame_dirty = true;
+
+	k_spin_unlock(&frame_lock, key);
+}
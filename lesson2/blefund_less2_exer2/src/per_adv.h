@@ -0,0 +1,71 @@
+/*
+ * Copyright (c) 2023 Nordic Semiconductor ASA
+ *
+ * SPDX-License-Identifier: LicenseRef-Nordic-5-Clause
+ */
+
+#ifndef PER_ADV_H_
+#define PER_ADV_H_
+
+/**@file
+ * @defgroup per_adv Periodic advertising telemetry
+ * @{
+ * @brief Rolling telemetry frame broadcast on a periodic advertising train.
+ *
+ * Samples are added to a single frame. At most once per periodic
+ * advertising interval the frame, if it changed, gets a new sequence
+ * number and is handed to the controller, which keeps sending it until
+ * the next update. The updates are paced by a timer and are not aligned
+ * with the periodic advertising events.
+ */
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <zephyr/types.h>
+#include <zephyr/bluetooth/bluetooth.h>
+
+/** @brief Telemetry frame, sent as manufacturer specific data.
+ *
+ * All fields are little endian.
+ */
+struct per_adv_frame {
+	/** Company identifier. */
+	uint16_t company_id;
+	/** Frame sequence number, incremented on every new frame. */
+	uint16_t seq;
+	/** Uptime of the newest sample in milliseconds. */
+	uint32_t uptime_ms;
+	/** Sample window, oldest first. */
+	int16_t samples[CONFIG_APP_PER_ADV_SAMPLES];
+} __packed;
+
+/** @brief Start the periodic advertising train.
+ *
+ * @param[in] adv Non-connectable, non-scannable extended advertising set.
+ * @param[in] company_id Company identifier to put in the frame.
+ *
+ * @retval 0 If the operation was successful.
+ *           Otherwise, a (negative) error code is returned.
+ */
+int per_adv_start(struct bt_le_ext_adv *adv, uint16_t company_id);
+
+/** @brief Add a sample to the telemetry frame.
+ *
+ * Safe to call from any thread. The sample is broadcast with the next
+ * frame update.
+ *
+ * @param[in] sample Sensor sample.
+ */
+void per_adv_sample(int16_t sample);
+
+#ifdef __cplusplus
+}
+#endif
+
+/**
+ * @}
+ */
+
+#endif /* PER_ADV_H_ */
@@ -0,0 +1,139 @@
+/*
+ * Copyright (c) 2023 Nordic Semiconductor ASA
+ *
+ * SPDX-License-Identifier: LicenseRef-Nordic-5-Clause
+ */
+
+/** @file
+ *  @brief Advertising data layout
+ */
+
+#include <zephyr/types.h>
+#include <errno.h>
+#include <zephyr/kernel.h>
+#include <zephyr/bluetooth/bluetooth.h>
+#include <zephyr/bluetooth/gap.h>
+
+#include "adv_layout.h"
+#include "adv_time.h"
+#include "conn_time.h"
+
+#include <zephyr/logging/log.h>
+LOG_MODULE_REGISTER(adv_layout, LOG_LEVEL_INF);
+
+#define PDU_DATA_LEN BT_GAP_ADV_MAX_ADV_DATA_LEN
+
+/* Default scan timing of BT_LE_SCAN_PASSIVE and BT_LE_SCAN_ACTIVE, in the
+ * same 0.625 ms units as the advertising interval
+ */
+#define SCAN_INTERVAL_US CONN_TIME_ADV_US(BT_GAP_SCAN_FAST_INTERVAL)
+#define SCAN_WINDOW_US CONN_TIME_ADV_US(BT_GAP_SCAN_FAST_WINDOW)
+
+/* On-air time of a PDU on the 1M PHY: preamble, access address, header,
+ * payload and CRC.
+ */
+#define PDU_US(payload) ((1 + 4 + 2 + (payload) + 3) * 8)
+#define T_IFS_US 150
+/* ScanA and AdvA */
+#define SCAN_REQ_LEN 12
+/* AdvA */
+#define SCAN_RSP_HDR_LEN 6
+
+static size_t field_len(const struct adv_layout_field *field)
+{
+	return 2 + field->data.data_len;
+}
+
+int adv_layout_pack(const struct adv_layout_field *fields, size_t count,
+		    struct adv_layout *layout)
+{
+	uint32_t best_mask = 0;
+	int32_t best_score = -1;
+	uint32_t required = 0;
+	size_t total = 0;
+
+	if (count > ADV_LAYOUT_MAX_FIELDS) {
+		return -EINVAL;
+	}
+
+	for (size_t i = 0; i < count; i++) {
+		total += field_len(&fields[i]);
+		if (fields[i].priority == ADV_LAYOUT_REQUIRED) {
+			required |= BIT(i);
+		}
+	}
+
+	/* Bit i of the mask puts structure i in the advertising data. */
+	for (uint32_t mask = 0; mask < BIT(count); mask++) {
+		size_t ad_bytes = 0;
+		int32_t score = 0;
+
+		if ((mask & required) != required) {
+			continue;
+		}
+
+		for (size_t i = 0; i < count; i++) {
+			if (mask & BIT(i)) {
+				ad_bytes += field_len(&fields[i]);
+				score += fields[i].priority;
+			}
+		}
+
+		if (ad_bytes > PDU_DATA_LEN || total - ad_bytes > PDU_DATA_LEN) {
+			continue;
+		}
+
+		/* On a tie, keep the scan response short. */
+		score = score * (PDU_DATA_LEN + 1) + ad_bytes;
+		if (score > best_score) {
+			best_score = score;
+			best_mask = mask;
+		}
+	}
+
+	if (best_score < 0) {
+		return -ENOSPC;
+	}
+
+	layout->ad_len = 0;
+	layout->sd_len = 0;
+
+	for (size_t i = 0; i < count; i++) {
+		if (best_mask & BIT(i)) {
+			layout->ad[layout->ad_len++] = fields[i].data;
+		} else {
+			layout->sd[layout->sd_len++] = fields[i].data;
+		}
+	}
+
+	return 0;
+}
+
+void adv_layout_report(const struct adv_layout *layout, uint32_t interval_ms)
+{
+	uint32_t interval_us = interval_ms * USEC_PER_MSEC;
+	uint32_t cont_ms = ADV_TIME_DISCOVERY_CONT_US(interval_us) / USEC_PER_MSEC;
+	uint32_t duty_ms = adv_time_discovery_us(interval_us, SCAN_INTERVAL_US, SCAN_WINDOW_US) /
+			   USEC_PER_MSEC;
+	size_t sd_bytes = 0;
+	uint32_t scan_us;
+
+	for (size_t i = 0; i < layout->sd_len; i++) {
+		sd_bytes += 2 + layout->sd[i].data_len;
+	}
+
+	scan_us = T_IFS_US + PDU_US(SCAN_REQ_LEN) + T_IFS_US + PDU_US(SCAN_RSP_HDR_LEN + sd_bytes);
+
+	LOG_INF("Discovery: %u ms scanning without gaps, %u ms with a %u/%u ms scan window",
+		cont_ms, duty_ms, SCAN_WINDOW_US / USEC_PER_MSEC, SCAN_INTERVAL_US / USEC_PER_MSEC);
+
+	for (size_t i = 0; i < layout->ad_len; i++) {
+		LOG_INF("AD 0x%02x (%u bytes): any scanner, %u/%u ms", layout->ad[i].type,
+			2 + layout->ad[i].data_len, cont_ms, duty_ms);
+	}
+
+	for (size_t i = 0; i < layout->sd_len; i++) {
+		LOG_INF("SR 0x%02x (%u bytes): active scanners only, %u/%u ms + %u us",
+			layout->sd[i].type, 2 + layout->sd[i].data_len, cont_ms, duty_ms, scan_us);
+	}
+}
@@ -0,0 +1,97 @@
+/*
+ * Copyright (c) 2023 Nordic Semiconductor ASA
+ *
+ * SPDX-License-Identifier: LicenseRef-Nordic-5-Clause
+ */
+
+#ifndef ADV_LAYOUT_H_
+#define ADV_LAYOUT_H_
+
+/**@file
+ * @defgroup adv_layout Advertising data layout
+ * @{
+ * @brief Place AD structures in the advertising data or scan response.
+ *
+ * A scanner sees the advertising data in the first advertising event it
+ * receives, but only sees the scan response after an active scan round
+ * trip, and passive or offloaded filtering scanners never see it. The
+ * layout puts the structures a scanner filters on in the advertising
+ * data: of all splits where both PDUs fit, it picks the one with the
+ * highest total priority in the advertising data. With at most
+ * ADV_LAYOUT_MAX_FIELDS structures every split is tried.
+ */
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <zephyr/types.h>
+#include <zephyr/bluetooth/bluetooth.h>
+
+/** Largest number of AD structures the layout handles. */
+#define ADV_LAYOUT_MAX_FIELDS 8
+
+/** Priority of a structure that must be in the advertising data. */
+#define ADV_LAYOUT_REQUIRED UINT8_MAX
+
+/** @brief AD structure with its placement priority. */
+struct adv_layout_field {
+	/** The structure. */
+	struct bt_data data;
+	/** How much it is worth to have the structure in the advertising
+	 *  data, for example because scanners filter on it.
+	 */
+	uint8_t priority;
+};
+
+/** @brief Advertising and scan response data picked by the layout. */
+struct adv_layout {
+	/** Advertising data. */
+	struct bt_data ad[ADV_LAYOUT_MAX_FIELDS];
+	/** Number of elements in @p ad. */
+	size_t ad_len;
+	/** Scan response data. */
+	struct bt_data sd[ADV_LAYOUT_MAX_FIELDS];
+	/** Number of elements in @p sd. */
+	size_t sd_len;
+};
+
+/** @brief Split AD structures between the advertising data and the scan
+ *  response of legacy advertising.
+ *
+ * The structures keep their order within each PDU. The layout points to
+ * the data of @p fields, which must stay valid while it is in use.
+ *
+ * @param[in] fields Structures to place.
+ * @param[in] count Number of elements in @p fields.
+ * @param[out] layout The best layout.
+ *
+ * @retval 0 If the operation was successful.
+ * @retval -EINVAL If there are more than ADV_LAYOUT_MAX_FIELDS structures.
+ * @retval -ENOSPC If the structures do not fit in the two PDUs.
+ */
+int adv_layout_pack(const struct adv_layout_field *fields, size_t count,
+		    struct adv_layout *layout);
+
+/** @brief Log the layout and the modelled discovery latency of each
+ *  structure.
+ *
+ * The latency is given for a scanner that listens without gaps and for
+ * one with the default scan window and interval of Zephyr, see
+ * adv_time.h. The scan response additionally takes a scan request round
+ * trip.
+ *
+ * @param[in] layout Layout from adv_layout_pack().
+ * @param[in] interval_ms Advertising interval in milliseconds.
+ */
+void adv_layout_report(const struct adv_layout *layout, uint32_t interval_ms);
+
+#ifdef __cplusplus
+}
+#endif
+
+/**
+ * @}
+ */
+
+#endif /* ADV_LAYOUT_H_ */
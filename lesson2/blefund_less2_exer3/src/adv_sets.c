@@ -0,0 +1,325 @@
+/*
+ * Copyright (c) 2023 Nordic Semiconductor ASA
+ *
+ * SPDX-License-Identifier: LicenseRef-Nordic-5-Clause
+ */
+
+/** @file
+ *  @brief Advertising set manager
+ */
+
+#include <zephyr/types.h>
+#include <errno.h>
+#include <zephyr/kernel.h>
+#include <zephyr/sys/byteorder.h>
+#include <zephyr/bluetooth/bluetooth.h>
+#include <zephyr/bluetooth/conn.h>
+#include <zephyr/bluetooth/hci.h>
+#include <zephyr/bluetooth/hci_vs.h>
+
+#include "adv_sets.h"
+
+#include <zephyr/logging/log.h>
+LOG_MODULE_REGISTER(adv_sets, LOG_LEVEL_INF);
+
+#define MAX_SETS CONFIG_BT_EXT_ADV_MAX_ADV_SET
+#define STATS_EVENTS CONFIG_APP_ADV_STATS_EVENTS
+
+/* On-air time of a PDU on the 1M PHY: preamble, access address, header,
+ * payload and CRC.
+ */
+#define PDU_US(payload) ((1 + 4 + 2 + (payload) + 3) * 8)
+#define PRIMARY_CHANNELS 3
+/* AdvA of legacy advertising and scan response PDUs */
+#define LEGACY_HDR_LEN 6
+/* ScanA and AdvA */
+#define SCAN_REQ_LEN 12
+/* Extended header of ADV_EXT_IND: length, flags, ADI and AuxPtr */
+#define ADV_EXT_IND_LEN 7
+/* Extended header of AUX_ADV_IND: length, flags, AdvA and ADI */
+#define AUX_ADV_IND_HDR_LEN 10
+
+struct adv_set {
+	const struct adv_set_config *config;
+	struct bt_le_ext_adv *adv;
+	struct bt_conn *conn;
+	struct k_work restart_work;
+	/* Estimated airtime of one advertising event and one scan exchange */
+	uint32_t event_us;
+	uint32_t scan_us;
+	struct adv_set_stats stats;
+	struct adv_set_stats reported;
+};
+
+static struct adv_set sets[MAX_SETS];
+static size_t set_count;
+static struct k_spinlock stats_lock;
+static int64_t last_report;
+
+static struct adv_set *set_find(struct bt_le_ext_adv *adv)
+{
+	for (size_t i = 0; i < set_count; i++) {
+		if (sets[i].adv == adv) {
+			return &sets[i];
+		}
+	}
+
+	return NULL;
+}
+
+static size_t encoded_len(const struct bt_data *data, size_t count)
+{
+	size_t len = 0;
+
+	for (size_t i = 0; i < count; i++) {
+		len += 2 + data[i].data_len;
+	}
+
+	return len;
+}
+
+static void airtime_update(struct adv_set *set, const struct bt_data *ad, size_t ad_len,
+			   const struct bt_data *sd, size_t sd_len)
+{
+	size_t ad_bytes = encoded_len(ad, ad_len);
+
+	if (set->config->param.options & BT_LE_ADV_OPT_EXT_ADV) {
+		set->event_us = PRIMARY_CHANNELS * PDU_US(ADV_EXT_IND_LEN) +
+				PDU_US(AUX_ADV_IND_HDR_LEN + ad_bytes);
+	} else {
+		set->event_us = PRIMARY_CHANNELS * PDU_US(LEGACY_HDR_LEN + ad_bytes);
+	}
+
+	set->scan_us = PDU_US(SCAN_REQ_LEN) + PDU_US(LEGACY_HDR_LEN + encoded_len(sd, sd_len));
+}
+
+static int tx_power_set(struct adv_set *set)
+{
+	struct bt_hci_cp_vs_write_tx_power_level *cp;
+	struct bt_hci_rp_vs_write_tx_power_level *rp;
+	struct net_buf *buf;
+	struct net_buf *rsp = NULL;
+	int err;
+
+	buf = bt_hci_cmd_create(BT_HCI_OP_VS_WRITE_TX_POWER_LEVEL, sizeof(*cp));
+	if (!buf) {
+		return -ENOBUFS;
+	}
+
+	cp = net_buf_add(buf, sizeof(*cp));
+	/* The host uses the set index as the advertising handle. */
+	cp->handle = sys_cpu_to_le16(bt_le_ext_adv_get_index(set->adv));
+	cp->handle_type = BT_HCI_VS_LL_HANDLE_TYPE_ADV;
+	cp->tx_power_level = set->config->tx_power;
+
+	err = bt_hci_cmd_send_sync(BT_HCI_OP_VS_WRITE_TX_POWER_LEVEL, buf, &rsp);
+	if (err) {
+		return err;
+	}
+
+	rp = (void *)rsp->data;
+	LOG_INF("%s: TX power %d dBm", set->config->name, rp->selected_tx_power);
+	net_buf_unref(rsp);
+
+	return 0;
+}
+
+static int set_start(struct adv_set *set)
+{
+	return bt_le_ext_adv_start(set->adv, BT_LE_EXT_ADV_START_PARAM(0, STATS_EVENTS));
+}
+
+static void restart_work_handler(struct k_work *work)
+{
+	struct adv_set *set = CONTAINER_OF(work, struct adv_set, restart_work);
+	int err;
+
+	err = set_start(set);
+	if (err) {
+		LOG_ERR("%s: failed to restart (err %d)", set->config->name, err);
+	}
+}
+
+static void adv_sent(struct bt_le_ext_adv *adv, struct bt_le_ext_adv_sent_info *info)
+{
+	struct adv_set *set = set_find(adv);
+	k_spinlock_key_t key;
+
+	if (!set) {
+		return;
+	}
+
+	key = k_spin_lock(&stats_lock);
+	set->stats.events += info->num_sent;
+	set->stats.airtime_us += (uint64_t)info->num_sent * set->event_us;
+	k_spin_unlock(&stats_lock, key);
+
+	/* The window is over, count the next one. */
+	k_work_submit(&set->restart_work);
+}
+
+static void adv_connected(struct bt_le_ext_adv *adv, struct bt_le_ext_adv_connected_info *info)
+{
+	struct adv_set *set = set_find(adv);
+	k_spinlock_key_t key;
+
+	if (!set) {
+		return;
+	}
+
+	/* The set stopped, restart it when the connection is gone. */
+	set->conn = info->conn;
+
+	key = k_spin_lock(&stats_lock);
+	set->stats.connections++;
+	k_spin_unlock(&stats_lock, key);
+}
+
+static void adv_scanned(struct bt_le_ext_adv *adv, struct bt_le_ext_adv_scanned_info *info)
+{
+	struct adv_set *set = set_find(adv);
+	k_spinlock_key_t key;
+
+	if (!set) {
+		return;
+	}
+
+	key = k_spin_lock(&stats_lock);
+	set->stats.scan_reqs++;
+	set->stats.airtime_us += set->scan_us;
+	k_spin_unlock(&stats_lock, key);
+}
+
+static const struct bt_le_ext_adv_cb adv_callbacks = {
+	.sent = adv_sent,
+	.connected = adv_connected,
+	.scanned = adv_scanned,
+};
+
+static void on_disconnected(struct bt_conn *conn, uint8_t reason)
+{
+	for (size_t i = 0; i < set_count; i++) {
+		if (sets[i].conn == conn) {
+			sets[i].conn = NULL;
+			k_work_submit(&sets[i].restart_work);
+		}
+	}
+}
+
+BT_CONN_CB_DEFINE(adv_sets_conn_callbacks) = {
+	.disconnected = on_disconnected,
+};
+
+int adv_sets_start(const struct adv_set_config *configs, size_t count)
+{
+	int err;
+
+	if (count > ARRAY_SIZE(sets)) {
+		return -ENOMEM;
+	}
+
+	for (size_t i = 0; i < count; i++) {
+		struct adv_set *set = &sets[i];
+		struct bt_le_adv_param param = configs[i].param;
+
+		set->config = &configs[i];
+		k_work_init(&set->restart_work, restart_work_handler);
+
+		if (configs[i].sd_len) {
+			param.options |= BT_LE_ADV_OPT_NOTIFY_SCAN_REQ;
+		}
+
+		err = bt_le_ext_adv_create(&param, &adv_callbacks, &set->adv);
+		if (err) {
+			LOG_ERR("%s: failed to create set (err %d)", configs[i].name, err);
+			return err;
+		}
+		set_count++;
+
+		err = adv_sets_data_update(i, configs[i].ad, configs[i].ad_len, configs[i].sd,
+					   configs[i].sd_len);
+		if (err) {
+			return err;
+		}
+
+		err = tx_power_set(set);
+		if (err) {
+			/* Not fatal, the set advertises at the default power. */
+			LOG_WRN("%s: failed to set TX power (err %d)", configs[i].name, err);
+		}
+
+		err = set_start(set);
+		if (err) {
+			LOG_ERR("%s: failed to start (err %d)", configs[i].name, err);
+			return err;
+		}
+	}
+
+	last_report = k_uptime_get();
+
+	return 0;
+}
+
+int adv_sets_data_update(size_t index, const struct bt_data *ad, size_t ad_len,
+			 const struct bt_data *sd, size_t sd_len)
+{
+	struct adv_set *set;
+	int err;
+
+	if (index >= set_count) {
+		return -EINVAL;
+	}
+
+	set = &sets[index];
+
+	err = bt_le_ext_adv_set_data(set->adv, ad, ad_len, sd, sd_len);
+	if (err) {
+		LOG_ERR("%s: failed to set data (err %d)", set->config->name, err);
+		return err;
+	}
+
+	airtime_update(set, ad, ad_len, sd, sd_len);
+
+	return 0;
+}
+
+void adv_sets_stats_get(size_t index, struct adv_set_stats *stats)
+{
+	k_spinlock_key_t key = k_spin_lock(&stats_lock);
+
+	*stats = sets[index].stats;
+
+	k_spin_unlock(&stats_lock, key);
+}
+
+void adv_sets_report(void)
+{
+	int64_t now = k_uptime_get();
+	uint32_t elapsed_ms = MAX(now - last_report, 1);
+	uint64_t total_us = 0;
+
+	last_report = now;
+
+	for (size_t i = 0; i < set_count; i++) {
+		struct adv_set *set = &sets[i];
+		struct adv_set_stats stats;
+		uint32_t airtime_us;
+		/* Microseconds on air per millisecond is the share in per mille. */
+		uint32_t permille;
+
+		adv_sets_stats_get(i, &stats);
+		airtime_us = stats.airtime_us - set->reported.airtime_us;
+		permille = airtime_us / elapsed_ms;
+		total_us += airtime_us;
+
+		LOG_INF("%s: %u events, %u scan requests, %u connections, airtime %u us (%u.%u%%)",
+			set->config->name, stats.events - set->reported.events,
+			stats.scan_reqs - set->reported.scan_reqs,
+			stats.connections - set->reported.connections, airtime_us, permille / 10,
+			permille % 10);
+
+		set->reported = stats;
+	}
+
+	LOG_INF("All sets: airtime %u us in %u ms", (uint32_t)total_us, elapsed_ms);
+}
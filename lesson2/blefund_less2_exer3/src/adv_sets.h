@@ -0,0 +1,103 @@
+/*
+ * Copyright (c) 2023 Nordic Semiconductor ASA
+ *
+ * SPDX-License-Identifier: LicenseRef-Nordic-5-Clause
+ */
+
+#ifndef ADV_SETS_H_
+#define ADV_SETS_H_
+
+/**@file
+ * @defgroup adv_sets Advertising set manager
+ * @{
+ * @brief Concurrent extended advertising sets with airtime statistics.
+ *
+ * Every set is started for a window of CONFIG_APP_ADV_STATS_EVENTS
+ * advertising events. When the window ends the events are counted and
+ * the set is restarted, which gives exact per-set event counts without
+ * controller support for event reports. The airtime of an event is
+ * estimated from the PDU sizes on the 1M PHY.
+ */
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <zephyr/types.h>
+#include <zephyr/bluetooth/bluetooth.h>
+
+/** @brief Configuration of one advertising set. */
+struct adv_set_config {
+	/** Name used in the statistics reports. */
+	const char *name;
+	/** Advertising parameters. */
+	struct bt_le_adv_param param;
+	/** Requested TX power in dBm. */
+	int8_t tx_power;
+	/** Advertising data. */
+	const struct bt_data *ad;
+	/** Number of elements in @p ad. */
+	size_t ad_len;
+	/** Scan response data. */
+	const struct bt_data *sd;
+	/** Number of elements in @p sd. */
+	size_t sd_len;
+};
+
+/** @brief Statistics of one advertising set. */
+struct adv_set_stats {
+	/** Number of completed advertising events. */
+	uint32_t events;
+	/** Number of received scan requests. */
+	uint32_t scan_reqs;
+	/** Number of connections. */
+	uint32_t connections;
+	/** Estimated on-air time of all events in microseconds. */
+	uint64_t airtime_us;
+};
+
+/** @brief Create and start the advertising sets.
+ *
+ * The configurations must stay valid while advertising.
+ *
+ * @param[in] configs Set configurations.
+ * @param[in] count Number of sets, at most CONFIG_BT_EXT_ADV_MAX_ADV_SET.
+ *
+ * @retval 0 If the operation was successful.
+ *           Otherwise, a (negative) error code is returned.
+ */
+int adv_sets_start(const struct adv_set_config *configs, size_t count);
+
+/** @brief Update the data of a set.
+ *
+ * @param[in] index Index of the set in the configuration array.
+ * @param[in] ad Advertising data.
+ * @param[in] ad_len Number of elements in @p ad.
+ * @param[in] sd Scan response data.
+ * @param[in] sd_len Number of elements in @p sd.
+ *
+ * @retval 0 If the operation was successful.
+ *           Otherwise, a (negative) error code is returned.
+ */
+int adv_sets_data_update(size_t index, const struct bt_data *ad, size_t ad_len,
+			 const struct bt_data *sd, size_t sd_len);
+
+/** @brief Get the statistics of a set.
+ *
+ * @param[in] index Index of the set in the configuration array.
+ * @param[out] stats Statistics since the set was started.
+ */
+void adv_sets_stats_get(size_t index, struct adv_set_stats *stats);
+
+/** @brief Log the airtime share of every set since the previous report. */
+void adv_sets_report(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+/**
+ * @}
+ */
+
+#endif /* ADV_SETS_H_ */
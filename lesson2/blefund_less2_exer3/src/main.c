@@ -16,16 +16,31 @@
 #include <zephyr/bluetooth/addr.h>
 #include <dk_buttons_and_leds.h>
 
+#include "conn_time.h"
+
+#if defined(CONFIG_APP_ADV_LAYOUT)
+#include "adv_layout.h"
+#endif
+
+#if defined(CONFIG_APP_MULTI_ADV)
+#include <zephyr/sys/byteorder.h>
+
+#include "adv_build.h"
+#include "adv_sets.h"
+#endif
+
 #define ADV_INTERVAL_MS 500
-#define ADV_INTERVAL_MIN (ADV_INTERVAL_MS / 0.625)
+#define ADV_INTERVAL_MIN CONN_TIME_MS_TO_ADV(ADV_INTERVAL_MS)
 #define ADV_INTERVAL_MAX (ADV_INTERVAL_MIN + 1)
 
+#if !defined(CONFIG_APP_MULTI_ADV)
 /* STEP 5.1 - Create the advertising parameter for connectable advertising */
 static struct bt_le_adv_param * p_adv_param = BT_LE_ADV_PARAM(
      (BT_LE_ADV_OPT_CONNECTABLE | BT_LE_ADV_OPT_USE_IDENTITY), /* Connectable advertising and use identity address */
      ADV_INTERVAL_MIN,
      ADV_INTERVAL_MAX,
      NULL);
+#endif
 
 LOG_MODULE_REGISTER(Lesson2_Exercise3, LOG_LEVEL_INF);
 
@@ -37,6 +52,8 @@ LOG_MODULE_REGISTER(Lesson2_Exercise3, LOG_LEVEL_INF);
 
 #define RANDOM_STATIC_ADDR "FF:EE:DD:CC:BB:AA"
 
+/* With CONFIG_APP_ADV_LAYOUT, the single advertiser uses lbs_fields instead. */
+#if defined(CONFIG_APP_MULTI_ADV) || !defined(CONFIG_APP_ADV_LAYOUT)
 static const struct bt_data ad[] = {
      /* STEP 3.1 - Set the flags and populate the device name in the advertising packet */
      BT_DATA_BYTES(BT_DATA_FLAGS, (BT_LE_AD_GENERAL | BT_LE_AD_NO_BREDR)),
@@ -47,6 +64,89 @@ static const struct bt_data sd[] = {
      /* STEP 3.2.2 - Include the 16-bytes (128-Bits) UUID of the LBS service in the scan response packet */
      BT_DATA_BYTES(BT_DATA_UUID128_ALL, BT_UUID_LBS_VAL),
 };
+#endif
+
+#if defined(CONFIG_APP_ADV_LAYOUT)
+/* The same structures, placed by priority instead of by hand. Scanners
+ * that filter on the LBS UUID find it without a scan request.
+ */
+static const struct adv_layout_field lbs_fields[] = {
+     { BT_DATA_BYTES(BT_DATA_FLAGS, (BT_LE_AD_GENERAL | BT_LE_AD_NO_BREDR)), ADV_LAYOUT_REQUIRED },
+     { BT_DATA(BT_DATA_NAME_COMPLETE, DEVICE_NAME, DEVICE_NAME_LEN),
+       CONFIG_APP_ADV_LAYOUT_NAME_PRIORITY },
+     { BT_DATA_BYTES(BT_DATA_UUID128_ALL, BT_UUID_LBS_VAL), CONFIG_APP_ADV_LAYOUT_UUID_PRIORITY },
+};
+
+static struct adv_layout lbs_layout;
+#endif
+
+#if defined(CONFIG_APP_MULTI_ADV)
+#define COMPANY_IDENTIFIER 0x0059 /* Nordic Semiconductor ASA */
+
+/* Report the airtime of the advertising sets every 10 blinks */
+#define ADV_STATS_BLINKS 10
+
+enum
+{
+     ADV_SET_LBS,
+     ADV_SET_TELEMETRY,
+     ADV_SET_URI,
+};
+
+/* Manufacturer data: company identifier (2), uptime in seconds (4), both
+ * little-endian
+ */
+#define TELEMETRY_UPTIME_OFFSET 2
+
+static uint8_t telemetry_mfg[6] = { BT_BYTES_LIST_LE16(COMPANY_IDENTIFIER) };
+
+static const struct bt_data telemetry_ad[] = {
+     BT_DATA(BT_DATA_MANUFACTURER_DATA, telemetry_mfg, sizeof(telemetry_mfg)),
+};
+
+#define URL ADV_URI_HTTPS "//academy.nordicsemi.com"
+
+static const struct bt_data uri_ad[] = {
+     BT_DATA(BT_DATA_URI, URL, sizeof(URL) - 1),
+};
+
+static struct adv_set_config adv_set_configs[] = {
+     [ADV_SET_LBS] = {
+          .name = "LBS",
+          .param = BT_LE_ADV_PARAM_INIT(BT_LE_ADV_OPT_CONNECTABLE | BT_LE_ADV_OPT_USE_IDENTITY,
+                                        CONN_TIME_MS_TO_ADV(CONFIG_APP_ADV_LBS_INTERVAL_MS),
+                                        CONN_TIME_MS_TO_ADV(CONFIG_APP_ADV_LBS_INTERVAL_MS) + 1,
+                                        NULL),
+          .tx_power = CONFIG_APP_ADV_LBS_TX_POWER,
+          .ad = ad,
+          .ad_len = ARRAY_SIZE(ad),
+          .sd = sd,
+          .sd_len = ARRAY_SIZE(sd),
+     },
+     /* Non-connectable extended advertising, nothing to scan */
+     [ADV_SET_TELEMETRY] = {
+          .name = "Telemetry",
+          .param = BT_LE_ADV_PARAM_INIT(BT_LE_ADV_OPT_EXT_ADV,
+                                        CONN_TIME_MS_TO_ADV(CONFIG_APP_ADV_TELEMETRY_INTERVAL_MS),
+                                        CONN_TIME_MS_TO_ADV(CONFIG_APP_ADV_TELEMETRY_INTERVAL_MS) + 1,
+                                        NULL),
+          .tx_power = CONFIG_APP_ADV_TELEMETRY_TX_POWER,
+          .ad = telemetry_ad,
+          .ad_len = ARRAY_SIZE(telemetry_ad),
+     },
+     /* Legacy non-connectable advertising, so any phone sees the URI */
+     [ADV_SET_URI] = {
+          .name = "URI",
+          .param = BT_LE_ADV_PARAM_INIT(BT_LE_ADV_OPT_NONE,
+                                        CONN_TIME_MS_TO_ADV(CONFIG_APP_ADV_URI_INTERVAL_MS),
+                                        CONN_TIME_MS_TO_ADV(CONFIG_APP_ADV_URI_INTERVAL_MS) + 1,
+                                        NULL),
+          .tx_power = CONFIG_APP_ADV_URI_TX_POWER,
+          .ad = uri_ad,
+          .ad_len = ARRAY_SIZE(uri_ad),
+     },
+};
+#endif /* CONFIG_APP_MULTI_ADV */
 
 void main(void)
 {
@@ -87,8 +187,34 @@ void main(void)
 
      LOG_INF("Bluetooth initialized\n");
 
+#if defined(CONFIG_APP_ADV_LAYOUT)
+     err = adv_layout_pack(lbs_fields, ARRAY_SIZE(lbs_fields), &lbs_layout);
+     if (err)
+     {
+          LOG_ERR("Advertising data does not fit (err %d)\n", err);
+          return;
+     }
+
+#if defined(CONFIG_APP_MULTI_ADV)
+     adv_set_configs[ADV_SET_LBS].ad = lbs_layout.ad;
+     adv_set_configs[ADV_SET_LBS].ad_len = lbs_layout.ad_len;
+     adv_set_configs[ADV_SET_LBS].sd = lbs_layout.sd;
+     adv_set_configs[ADV_SET_LBS].sd_len = lbs_layout.sd_len;
+     adv_layout_report(&lbs_layout, CONFIG_APP_ADV_LBS_INTERVAL_MS);
+#else
+     adv_layout_report(&lbs_layout, ADV_INTERVAL_MS);
+#endif
+#endif
+
      /* STEP 5.2 - Start advertising */
+#if defined(CONFIG_APP_MULTI_ADV)
+     err = adv_sets_start(adv_set_configs, ARRAY_SIZE(adv_set_configs));
+#elif defined(CONFIG_APP_ADV_LAYOUT)
+     err = bt_le_adv_start(p_adv_param, lbs_layout.ad, lbs_layout.ad_len, lbs_layout.sd,
+                           lbs_layout.sd_len);
+#else
      err = bt_le_adv_start(p_adv_param, ad, ARRAY_SIZE(ad), sd, ARRAY_SIZE(sd));
+#endif
      if (err)
      {
           LOG_ERR("Advertising failed to start (err %d)\n", err);
@@ -99,6 +225,16 @@ void main(void)
      for (;;)
      {
           dk_set_led(RUN_STATUS_LED, (++blink_status) % 2);
+#if defined(CONFIG_APP_MULTI_ADV)
+          sys_put_le32(k_uptime_get_32() / MSEC_PER_SEC,
+                       &telemetry_mfg[TELEMETRY_UPTIME_OFFSET]);
+          adv_sets_data_update(ADV_SET_TELEMETRY, telemetry_ad, ARRAY_SIZE(telemetry_ad),
+                               NULL, 0);
+          if (blink_status % ADV_STATS_BLINKS == 0)
+          {
+               adv_sets_report();
+          }
+#endif
           k_sleep(K_MSEC(RUN_LED_BLINK_INTERVAL));
      }
 }
@@ -0,0 +1,45 @@
+#!/usr/bin/env bash
+#
+# Copyright (c) 2023 Nordic Semiconductor ASA
+#
+# SPDX-License-Identifier: LicenseRef-Nordic-5-Clause
+#
+# Measures the discovery latency in nrf52_bsim. Runs lesson2_exer3 with
+# the LBS UUID in the scan response (sr) or, placed by CONFIG_APP_ADV_LAYOUT,
+# in the advertising data (ad) against the discovery benchmark of this
+# observer. The measured latency is logged next to the modelled one.
+#
+# Usage: bsim_run.sh [run...], all runs if none is given.
+
+APP_DIR="$(cd "$(dirname "$0")" && pwd)"
+source "${APP_DIR}/../../scripts/bsim_common.sh"
+
+ADVERTISER_DIR="${APP_DIR}/../blefund_less2_exer3"
+
+# CONFIG_APP_DISCOVERY_SAMPLES scans, with margin for misses
+SIM_LENGTH_S=60
+
+declare -A ADVERTISERS=(
+	[sr]=""
+	[ad]="-DCONFIG_APP_ADV_LAYOUT=y"
+)
+declare -A SCANNERS=(
+	[passive]=""
+	[active]="-DCONFIG_APP_DISCOVERY_ACTIVE=y"
+	[continuous]="-DCONFIG_APP_DISCOVERY_SCAN_WINDOW=96"
+)
+# <advertiser>-<scanner>
+ORDER="sr-passive sr-active ad-passive ad-active ad-continuous"
+
+for run in ${@:-${ORDER}}; do
+	a=${run%%-*}
+	s=${run#*-}
+
+	echo "=== ${run} ==="
+	# shellcheck disable=SC2086
+	advertiser=$(bsim_build "discovery_adv_${a}" "${ADVERTISER_DIR}" ${ADVERTISERS[${a}]})
+	# shellcheck disable=SC2086
+	scanner=$(bsim_build "discovery_scan_${s}" "${APP_DIR}" -DCONFIG_APP_DISCOVERY_BENCH=y \
+		${SCANNERS[${s}]})
+	bsim_run "discovery_${run//-/_}" "${SIM_LENGTH_S}" "${advertiser}" "${scanner}"
+done
@@ -0,0 +1,222 @@
+/*
+ * Copyright (c) 2023 Nordic Semiconductor ASA
+ *
+ * SPDX-License-Identifier: LicenseRef-Nordic-5-Clause
+ */
+
+/** @file
+ *  @brief Discovery latency benchmark
+ */
+
+#include <zephyr/types.h>
+#include <errno.h>
+#include <string.h>
+#include <zephyr/kernel.h>
+#include <zephyr/random/rand32.h>
+#include <zephyr/sys/atomic.h>
+#include <zephyr/bluetooth/bluetooth.h>
+#include <zephyr/bluetooth/gap.h>
+#include <zephyr/bluetooth/uuid.h>
+
+#include "adv_time.h"
+#include "conn_time.h"
+#include "discovery_bench.h"
+
+#include <zephyr/logging/log.h>
+LOG_MODULE_REGISTER(discovery_bench, LOG_LEVEL_INF);
+
+#define ADV_INTERVAL_US (CONFIG_APP_DISCOVERY_ADV_INTERVAL_MS * USEC_PER_MSEC)
+#define SCAN_INTERVAL_US CONN_TIME_ADV_US(CONFIG_APP_DISCOVERY_SCAN_INTERVAL)
+#define SCAN_WINDOW_US CONN_TIME_ADV_US(CONFIG_APP_DISCOVERY_SCAN_WINDOW)
+
+#define SCAN_ACTIVE IS_ENABLED(CONFIG_APP_DISCOVERY_ACTIVE)
+
+/* Lets the reports of the previous scan drain before the next one */
+#define SCAN_GAP_MS 20
+
+BUILD_ASSERT(CONFIG_APP_DISCOVERY_SCAN_WINDOW <= CONFIG_APP_DISCOVERY_SCAN_INTERVAL,
+	     "Scan window longer than the scan interval");
+
+enum {
+	/* First report from the advertiser */
+	FOUND_DEVICE,
+	/* First report with the LBS UUID */
+	FOUND_UUID,
+	/* A scan response arrived, the UUID will not come in a later one */
+	FOUND_SCAN_RSP,
+	FOUND_COUNT,
+};
+
+struct latency {
+	uint32_t count;
+	uint64_t sum_us;
+	uint32_t min_us;
+	uint32_t max_us;
+};
+
+static const uint8_t lbs_uuid[] = { BT_UUID_128_ENCODE(0x00001523, 0x1212, 0xefde, 0x1523,
+						      0x785feabcd123) };
+
+static bt_addr_le_t peer;
+
+/* Written only by the scan callback, and before the bit is set */
+static atomic_t found;
+static int64_t found_ticks[FOUND_COUNT];
+
+static K_SEM_DEFINE(done_sem, 0, 1);
+
+static bool uuid_find(struct bt_data *data, void *user_data)
+{
+	bool *has_uuid = user_data;
+
+	if (data->type != BT_DATA_UUID128_ALL && data->type != BT_DATA_UUID128_SOME) {
+		return true;
+	}
+
+	for (uint8_t off = 0; off + sizeof(lbs_uuid) <= data->data_len; off += sizeof(lbs_uuid)) {
+		if (memcmp(&data->data[off], lbs_uuid, sizeof(lbs_uuid)) == 0) {
+			*has_uuid = true;
+			return false;
+		}
+	}
+
+	return true;
+}
+
+static void found_set(int bit, int64_t now)
+{
+	if (!atomic_test_bit(&found, bit)) {
+		found_ticks[bit] = now;
+		atomic_set_bit(&found, bit);
+	}
+}
+
+static void device_found(const bt_addr_le_t *addr, int8_t rssi, uint8_t type,
+			 struct net_buf_simple *ad)
+{
+	int64_t now = k_uptime_ticks();
+	bool has_uuid = false;
+
+	if (bt_addr_le_cmp(addr, &peer) != 0) {
+		return;
+	}
+
+	found_set(FOUND_DEVICE, now);
+
+	bt_data_parse(ad, uuid_find, &has_uuid);
+	if (has_uuid) {
+		found_set(FOUND_UUID, now);
+	}
+
+	if (type == BT_GAP_ADV_TYPE_SCAN_RSP) {
+		found_set(FOUND_SCAN_RSP, now);
+	}
+
+	/* Nothing more to learn from this scan */
+	if (atomic_test_bit(&found, FOUND_UUID) || !SCAN_ACTIVE ||
+	    atomic_test_bit(&found, FOUND_SCAN_RSP)) {
+		k_sem_give(&done_sem);
+	}
+}
+
+static void latency_add(struct latency *lat, int64_t start, int bit)
+{
+	uint32_t us;
+
+	if (!atomic_test_bit(&found, bit)) {
+		return;
+	}
+
+	us = k_ticks_to_us_floor64(found_ticks[bit] - start);
+
+	lat->min_us = lat->count ? MIN(lat->min_us, us) : us;
+	lat->max_us = MAX(lat->max_us, us);
+	lat->sum_us += us;
+	lat->count++;
+}
+
+static void latency_log(const char *what, const struct latency *lat)
+{
+	if (!lat->count) {
+		LOG_INF("%s: never found in %u scans", what, CONFIG_APP_DISCOVERY_SAMPLES);
+		return;
+	}
+
+	LOG_INF("%s: found in %u of %u scans, avg %u ms, min %u ms, max %u ms", what, lat->count,
+		CONFIG_APP_DISCOVERY_SAMPLES, (uint32_t)(lat->sum_us / lat->count / USEC_PER_MSEC),
+		lat->min_us / USEC_PER_MSEC, lat->max_us / USEC_PER_MSEC);
+}
+
+/* Scan once from a random time and record the latencies */
+static int sample_run(const struct bt_le_scan_param *param, struct latency *device,
+		      struct latency *uuid)
+{
+	int64_t start;
+	int err;
+
+	k_sleep(K_MSEC(SCAN_GAP_MS));
+	k_sleep(K_USEC(sys_rand32_get() % ADV_TIME_PERIOD_US(ADV_INTERVAL_US)));
+
+	atomic_clear(&found);
+	k_sem_reset(&done_sem);
+	start = k_uptime_ticks();
+
+	err = bt_le_scan_start(param, device_found);
+	if (err) {
+		return err;
+	}
+
+	k_sem_take(&done_sem, K_MSEC(CONFIG_APP_DISCOVERY_TIMEOUT_MS));
+
+	err = bt_le_scan_stop();
+	if (err) {
+		return err;
+	}
+
+	latency_add(device, start, FOUND_DEVICE);
+	latency_add(uuid, start, FOUND_UUID);
+
+	return 0;
+}
+
+int discovery_bench_run(void)
+{
+	const struct bt_le_scan_param param = {
+		.type = SCAN_ACTIVE ? BT_LE_SCAN_TYPE_ACTIVE : BT_LE_SCAN_TYPE_PASSIVE,
+		.options = BT_LE_SCAN_OPT_NONE,
+		.interval = CONFIG_APP_DISCOVERY_SCAN_INTERVAL,
+		.window = CONFIG_APP_DISCOVERY_SCAN_WINDOW,
+	};
+	uint32_t model_us;
+	int err;
+
+	err = bt_addr_le_from_str(CONFIG_APP_DISCOVERY_PEER_ADDR, "random", &peer);
+	if (err) {
+		LOG_ERR("Invalid peer address (err %d)", err);
+		return err;
+	}
+
+	LOG_INF("Discovery of %s, %s scan window " CONN_TIME_FMT " every " CONN_TIME_FMT,
+		CONFIG_APP_DISCOVERY_PEER_ADDR, SCAN_ACTIVE ? "active" : "passive",
+		CONN_TIME_ARGS(SCAN_WINDOW_US), CONN_TIME_ARGS(SCAN_INTERVAL_US));
+
+	model_us = adv_time_discovery_us(ADV_INTERVAL_US, SCAN_INTERVAL_US, SCAN_WINDOW_US);
+
+	for (;;) {
+		struct latency device = { 0 };
+		struct latency uuid = { 0 };
+
+		for (int i = 0; i < CONFIG_APP_DISCOVERY_SAMPLES; i++) {
+			err = sample_run(&param, &device, &uuid);
+			if (err) {
+				LOG_ERR("Scanning failed (err %d)", err);
+				return err;
+			}
+		}
+
+		LOG_INF("Modelled: avg %u ms at an advertising interval of %u ms",
+			model_us / USEC_PER_MSEC, CONFIG_APP_DISCOVERY_ADV_INTERVAL_MS);
+		latency_log("Device", &device);
+		latency_log("LBS UUID", &uuid);
+	}
+}
@@ -0,0 +1,44 @@
+/*
+ * Copyright (c) 2023 Nordic Semiconductor ASA
+ *
+ * SPDX-License-Identifier: LicenseRef-Nordic-5-Clause
+ */
+
+#ifndef DISCOVERY_BENCH_H_
+#define DISCOVERY_BENCH_H_
+
+/**@file
+ * @defgroup discovery_bench Discovery latency benchmark
+ * @{
+ * @brief Measures how long a scanner takes to find an advertiser.
+ *
+ * Scanning is started again and again at a random time against the
+ * advertising events of one advertiser, and the time to its first
+ * advertising report and to the first report that carries the LED Button
+ * Service UUID is measured. A passive scanner only finds the UUID when it
+ * is in the advertising data, an active scanner also in the scan
+ * response. Every CONFIG_APP_DISCOVERY_SAMPLES scans the measured latency
+ * is logged next to the one adv_time.h models.
+ */
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** @brief Run the benchmark.
+ *
+ * Call after bt_enable(). Does not return unless scanning fails.
+ *
+ * @return A (negative) error code.
+ */
+int discovery_bench_run(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+/**
+ * @}
+ */
+
+#endif /* DISCOVERY_BENCH_H_ */
@@ -0,0 +1,394 @@
+/*
+ * Copyright (c) 2023 Nordic Semiconductor ASA
+ *
+ * SPDX-License-Identifier: LicenseRef-Nordic-5-Clause
+ */
+
+/** @file
+ *  @brief Observer that tracks a fleet of lesson 2 beacons
+ *
+ * Scans passively without duplicate filtering and keeps counters for every
+ * advertiser that matches the company ID or service UUID filter. The scan
+ * callback runs for every advertising report, so it does a single pass
+ * over the advertising data and a hash table lookup, and nothing else.
+ *
+ * With CONFIG_APP_DISCOVERY_BENCH it measures how long discovering one
+ * advertiser takes instead, see discovery_bench.h.
+ */
+
+#include <string.h>
+#include <zephyr/kernel.h>
+#include <zephyr/logging/log.h>
+#include <zephyr/sys/byteorder.h>
+#include <zephyr/sys/util.h>
+#include <zephyr/bluetooth/bluetooth.h>
+#include <zephyr/bluetooth/gap.h>
+#include <zephyr/bluetooth/uuid.h>
+
+#include "discovery_bench.h"
+
+LOG_MODULE_REGISTER(Lesson2_Observer, LOG_LEVEL_INF);
+
+#define TABLE_SIZE CONFIG_APP_DEVICE_TABLE_SIZE
+/* Keep free slots so that probe sequences stay short and terminate */
+#define TABLE_MAX_DEVICES (TABLE_SIZE * 3 / 4)
+
+BUILD_ASSERT(IS_POWER_OF_TWO(TABLE_SIZE), "Device table size must be a power of two");
+
+/* The lesson2_exer2 beacon puts the number of presses after the company ID */
+#define MFG_COUNTER_OFFSET 2
+
+#define UUID128_LEN 16
+
+enum filter_kind {
+	FILTER_NONE,
+	FILTER_COMPANY_ID,
+	FILTER_UUID128,
+};
+
+/* Filter to apply to an AD structure, by AD type */
+static const uint8_t filter_by_type[UINT8_MAX + 1] = {
+	[BT_DATA_MANUFACTURER_DATA] = FILTER_COMPANY_ID,
+	[BT_DATA_UUID128_SOME] = FILTER_UUID128,
+	[BT_DATA_UUID128_ALL] = FILTER_UUID128,
+};
+
+static const uint8_t filter_uuid128[][UUID128_LEN] = {
+	/* LED Button Service */
+	{ BT_UUID_128_ENCODE(0x00001523, 0x1212, 0xefde, 0x1523, 0x785feabcd123) },
+};
+
+struct device {
+	bt_addr_le_t addr;
+	bool used;
+	bool has_counter;
+	int8_t rssi;
+	uint16_t counter;
+	uint32_t reports;
+	int32_t rssi_sum;
+	uint32_t last_seen;
+};
+
+static struct device devices[TABLE_SIZE];
+static size_t device_count;
+static K_MUTEX_DEFINE(table_lock);
+
+/* Counters of the current report, protected by table_lock */
+static uint32_t reports_total;
+static uint32_t reports_matched;
+static uint32_t reports_untracked;
+
+static uint32_t addr_hash(const bt_addr_le_t *addr)
+{
+	/* FNV-1a over the address type and value */
+	uint32_t hash = 2166136261U;
+
+	hash = (hash ^ addr->type) * 16777619U;
+	for (int i = 0; i < sizeof(addr->a.val); i++) {
+		hash = (hash ^ addr->a.val[i]) * 16777619U;
+	}
+
+	return hash;
+}
+
+/* Slot of the device, or the free slot that ends its probe sequence */
+static struct device *device_slot(struct device *table, const bt_addr_le_t *addr)
+{
+	uint32_t i = addr_hash(addr) & (TABLE_SIZE - 1);
+
+	/* Linear probing, the table always has free slots. */
+	while (table[i].used) {
+		if (bt_addr_le_cmp(&table[i].addr, addr) == 0) {
+			break;
+		}
+		i = (i + 1) & (TABLE_SIZE - 1);
+	}
+
+	return &table[i];
+}
+
+static struct device *device_lookup(struct device *table, const bt_addr_le_t *addr)
+{
+	struct device *dev = device_slot(table, addr);
+
+	if (dev->used) {
+		return dev;
+	}
+
+	if (device_count == TABLE_MAX_DEVICES) {
+		return NULL;
+	}
+
+	memset(dev, 0, sizeof(*dev));
+	bt_addr_le_copy(&dev->addr, addr);
+	dev->used = true;
+	device_count++;
+
+	return dev;
+}
+
+/* Backward shift deletion. Devices further down the probe sequence move
+ * into the hole unless that would put them before their home slot, so
+ * lookups never need tombstones.
+ */
+static void device_remove(struct device *table, struct device *dev)
+{
+	uint32_t hole = dev - table;
+	uint32_t i = hole;
+
+	for (;;) {
+		uint32_t home;
+
+		i = (i + 1) & (TABLE_SIZE - 1);
+		if (!table[i].used) {
+			break;
+		}
+
+		home = addr_hash(&table[i].addr) & (TABLE_SIZE - 1);
+		if (((i - home) & (TABLE_SIZE - 1)) >= ((i - hole) & (TABLE_SIZE - 1))) {
+			table[hole] = table[i];
+			hole = i;
+		}
+	}
+
+	table[hole].used = false;
+	device_count--;
+}
+
+static bool uuid128_match(const uint8_t *uuids, uint8_t len)
+{
+	for (uint8_t off = 0; off + UUID128_LEN <= len; off += UUID128_LEN) {
+		for (int i = 0; i < ARRAY_SIZE(filter_uuid128); i++) {
+			if (memcmp(&uuids[off], filter_uuid128[i], UUID128_LEN) == 0) {
+				return true;
+			}
+		}
+	}
+
+	return false;
+}
+
+/* Single pass over the advertising data. Sets counter to the press count
+ * of a lesson2_exer2 beacon if there is one.
+ */
+static bool ad_match(const uint8_t *data, uint16_t len, int32_t *counter)
+{
+	bool match = false;
+
+	while (len > 1) {
+		uint8_t field_len = data[0];
+		const uint8_t *val = &data[2];
+		uint8_t val_len = field_len - 1;
+
+		if (field_len == 0 || field_len >= len) {
+			/* Early termination or malformed data */
+			break;
+		}
+
+		switch (filter_by_type[data[1]]) {
+		case FILTER_COMPANY_ID:
+			if (val_len >= sizeof(uint16_t) &&
+			    sys_get_le16(val) == CONFIG_APP_FILTER_COMPANY_ID) {
+				match = true;
+				if (val_len >= MFG_COUNTER_OFFSET + sizeof(uint16_t)) {
+					*counter = sys_get_le16(&val[MFG_COUNTER_OFFSET]);
+				}
+			}
+			break;
+		case FILTER_UUID128:
+			if (uuid128_match(val, val_len)) {
+				match = true;
+			}
+			break;
+		default:
+			break;
+		}
+
+		data += field_len + 1;
+		len -= field_len + 1;
+	}
+
+	return match;
+}
+
+static void device_found(const bt_addr_le_t *addr, int8_t rssi, uint8_t type,
+			 struct net_buf_simple *ad)
+{
+	int32_t counter = -1;
+	bool match = ad_match(ad->data, ad->len, &counter);
+	struct device *dev;
+
+	k_mutex_lock(&table_lock, K_FOREVER);
+
+	reports_total++;
+	if (!match) {
+		goto out;
+	}
+
+	reports_matched++;
+
+	dev = device_lookup(devices, addr);
+	if (!dev) {
+		reports_untracked++;
+		goto out;
+	}
+
+	dev->reports++;
+	dev->rssi = rssi;
+	dev->rssi_sum += rssi;
+	dev->last_seen = k_uptime_get_32();
+	if (counter >= 0) {
+		dev->counter = counter;
+		dev->has_counter = true;
+	}
+
+out:
+	k_mutex_unlock(&table_lock);
+}
+
+static bool device_expired(const struct device *dev, uint32_t now)
+{
+	return now - dev->last_seen >= CONFIG_APP_DEVICE_TIMEOUT_S * MSEC_PER_SEC;
+}
+
+/* Remove a device that timed out in the snapshot, unless it was heard
+ * again since. Locks the table for one deletion only, so the scan callback
+ * waits at most a probe sequence.
+ */
+static void device_expire(const bt_addr_le_t *addr)
+{
+	struct device *dev;
+
+	k_mutex_lock(&table_lock, K_FOREVER);
+
+	dev = device_slot(devices, addr);
+	if (dev->used && device_expired(dev, k_uptime_get_32())) {
+		device_remove(devices, dev);
+	}
+
+	k_mutex_unlock(&table_lock);
+}
+
+static void report(uint32_t elapsed_ms)
+{
+	/* Only used by the main thread */
+	static struct device snapshot[TABLE_SIZE];
+	struct device top[CONFIG_APP_REPORT_DEVICES];
+	size_t top_count = 0;
+	uint32_t total;
+	uint32_t matched;
+	uint32_t untracked;
+	uint32_t now;
+	size_t count = 0;
+
+	/* Copy the table out, the scan callback runs in the Bluetooth RX
+	 * thread and must not wait for the expiry and the sort.
+	 */
+	k_mutex_lock(&table_lock, K_FOREVER);
+
+	total = reports_total;
+	matched = reports_matched;
+	untracked = reports_untracked;
+	reports_total = 0;
+	reports_matched = 0;
+	reports_untracked = 0;
+
+	memcpy(snapshot, devices, sizeof(snapshot));
+
+	k_mutex_unlock(&table_lock);
+
+	now = k_uptime_get_32();
+
+	/* Insertion sort of the devices with the most reports */
+	for (int i = 0; i < TABLE_SIZE; i++) {
+		size_t pos;
+
+		if (!snapshot[i].used) {
+			continue;
+		}
+
+		if (device_expired(&snapshot[i], now)) {
+			device_expire(&snapshot[i].addr);
+			continue;
+		}
+
+		count++;
+
+		for (pos = top_count; pos > 0 && top[pos - 1].reports < snapshot[i].reports;
+		     pos--) {
+			if (pos < ARRAY_SIZE(top)) {
+				top[pos] = top[pos - 1];
+			}
+		}
+
+		if (pos < ARRAY_SIZE(top)) {
+			top[pos] = snapshot[i];
+			top_count = MIN(top_count + 1, ARRAY_SIZE(top));
+		}
+	}
+
+	LOG_INF("Reports %u/s, matched %u/s, untracked %u, devices %u",
+		total * MSEC_PER_SEC / elapsed_ms, matched * MSEC_PER_SEC / elapsed_ms, untracked,
+		count);
+
+	for (size_t i = 0; i < top_count; i++) {
+		char addr_str[BT_ADDR_LE_STR_LEN];
+
+		bt_addr_le_to_str(&top[i].addr, addr_str, sizeof(addr_str));
+		if (top[i].has_counter) {
+			LOG_INF("  %s: %u reports, RSSI %d (avg %d), counter %u", addr_str,
+				top[i].reports, top[i].rssi, top[i].rssi_sum / (int32_t)top[i].reports,
+				top[i].counter);
+		} else {
+			LOG_INF("  %s: %u reports, RSSI %d (avg %d)", addr_str, top[i].reports,
+				top[i].rssi, top[i].rssi_sum / (int32_t)top[i].reports);
+		}
+	}
+}
+
+void main(void)
+{
+	/* Scan all the time, and report every advertising event. */
+	struct bt_le_scan_param scan_param = {
+		.type = BT_LE_SCAN_TYPE_PASSIVE,
+		.options = BT_LE_SCAN_OPT_NONE,
+		.interval = BT_GAP_SCAN_FAST_INTERVAL,
+		.window = BT_GAP_SCAN_FAST_INTERVAL,
+	};
+	int64_t last_report;
+	int err;
+
+	LOG_INF("Starting Lesson 2 - Observer\n");
+
+	err = bt_enable(NULL);
+	if (err) {
+		LOG_ERR("Bluetooth init failed (err %d)", err);
+		return;
+	}
+
+	LOG_INF("Bluetooth initialized");
+
+	if (IS_ENABLED(CONFIG_APP_DISCOVERY_BENCH)) {
+		discovery_bench_run();
+		return;
+	}
+
+	err = bt_le_scan_start(&scan_param, device_found);
+	if (err) {
+		LOG_ERR("Scanning failed to start (err %d)", err);
+		return;
+	}
+
+	LOG_INF("Scanning for company ID 0x%04x", CONFIG_APP_FILTER_COMPANY_ID);
+	last_report = k_uptime_get();
+
+	for (;;) {
+		int64_t now;
+
+		k_sleep(K_SECONDS(CONFIG_APP_REPORT_INTERVAL_S));
+
+		now = k_uptime_get();
+		report(MAX(now - last_report, 1));
+		last_report = now;
+	}
+}
@@ -0,0 +1,223 @@
+/*
+ * Copyright (c) 2023 Nordic Semiconductor ASA
+ *
+ * SPDX-License-Identifier: LicenseRef-Nordic-5-Clause
+ */
+
+/** @file
+ *  @brief Receiver for the periodic advertising telemetry of lesson 2
+ *
+ * Scans for the beacon of lesson2_exer2 built with overlay-per-adv.conf,
+ * synchronizes to its periodic advertising train and stops scanning. From
+ * then on the controller only wakes up for the periodic events.
+ */
+
+#include <string.h>
+#include <zephyr/kernel.h>
+#include <zephyr/logging/log.h>
+#include <zephyr/sys/byteorder.h>
+#include <zephyr/bluetooth/bluetooth.h>
+#include <zephyr/bluetooth/gap.h>
+#include <zephyr/bluetooth/hci.h>
+
+#include "conn_time.h"
+
+LOG_MODULE_REGISTER(Lesson2_Per_Sync, LOG_LEVEL_INF);
+
+#define COMPANY_IDENTIFIER 0x0059 /* Nordic Semiconductor ASA */
+
+/* Company ID (2), sequence number (2), uptime (4), then the samples */
+#define FRAME_HEADER_LEN 8
+
+#define SCAN_OPTIONS (IS_ENABLED(CONFIG_APP_SCAN_CODED) ? BT_LE_SCAN_OPT_CODED : BT_LE_SCAN_OPT_NONE)
+
+static struct bt_le_scan_param scan_param = {
+	.type = BT_LE_SCAN_TYPE_PASSIVE,
+	.options = SCAN_OPTIONS,
+	.interval = BT_GAP_SCAN_FAST_INTERVAL,
+	.window = BT_GAP_SCAN_FAST_WINDOW,
+};
+
+static struct bt_le_per_adv_sync *per_sync;
+
+/* Reception statistics of the current report */
+static uint32_t frames;
+static uint32_t lost;
+static uint32_t repeated;
+static uint32_t incomplete;
+static uint16_t next_seq;
+static bool seq_valid;
+
+static bool name_matches(struct bt_data *data, void *user_data)
+{
+	bool *found = user_data;
+
+	if (data->type == BT_DATA_NAME_COMPLETE &&
+	    data->data_len == sizeof(CONFIG_APP_PEER_NAME) - 1 &&
+	    memcmp(data->data, CONFIG_APP_PEER_NAME, data->data_len) == 0) {
+		*found = true;
+		return false;
+	}
+
+	return true;
+}
+
+static void scan_work_handler(struct k_work *work)
+{
+	int err;
+
+	/* Scan only while looking for a train, not while synchronized. */
+	if (per_sync) {
+		err = bt_le_scan_stop();
+		if (err && err != -EALREADY) {
+			LOG_ERR("Stop LE scan failed (err %d)", err);
+		}
+		return;
+	}
+
+	err = bt_le_scan_start(&scan_param, NULL);
+	if (err && err != -EALREADY) {
+		LOG_ERR("Scanning failed to start (err %d)", err);
+		return;
+	}
+
+	LOG_INF("Scanning for %s", CONFIG_APP_PEER_NAME);
+}
+
+static K_WORK_DEFINE(scan_work, scan_work_handler);
+
+static void scan_recv(const struct bt_le_scan_recv_info *info, struct net_buf_simple *buf)
+{
+	struct bt_le_per_adv_sync_param param;
+	bool found = false;
+	int err;
+
+	/* A nonzero interval means the set has a periodic advertising train. */
+	if (per_sync || info->interval == 0) {
+		return;
+	}
+
+	bt_data_parse(buf, name_matches, &found);
+	if (!found) {
+		return;
+	}
+
+	bt_addr_le_copy(&param.addr, info->addr);
+	param.sid = info->sid;
+	param.options = BT_LE_PER_ADV_SYNC_OPT_NONE;
+	param.skip = CONFIG_APP_SYNC_SKIP;
+	/* Lose the sync after about ten missed events, in 10 ms units. */
+	param.timeout = CLAMP(info->interval * 5U / 4U * (CONFIG_APP_SYNC_SKIP + 1),
+			      BT_GAP_PER_ADV_MIN_TIMEOUT, BT_GAP_PER_ADV_MAX_TIMEOUT);
+
+	err = bt_le_per_adv_sync_create(&param, &per_sync);
+	if (err) {
+		LOG_ERR("Failed to create sync (err %d)", err);
+		per_sync = NULL;
+		return;
+	}
+
+	LOG_INF("Synchronizing, SID %u, interval " CONN_TIME_FMT, info->sid,
+		CONN_TIME_ARGS(CONN_TIME_INTERVAL_US(info->interval)));
+}
+
+static struct bt_le_scan_cb scan_callbacks = {
+	.recv = scan_recv,
+};
+
+static void report(int8_t rssi, int16_t sample)
+{
+	LOG_INF("Frames %u, lost %u, repeated %u, incomplete %u, RSSI %d, newest sample %d",
+		frames, lost, repeated, incomplete, rssi, sample);
+
+	frames = 0;
+	lost = 0;
+	repeated = 0;
+	incomplete = 0;
+}
+
+static void synced(struct bt_le_per_adv_sync *sync, struct bt_le_per_adv_sync_synced_info *info)
+{
+	LOG_INF("Synchronized, interval " CONN_TIME_FMT,
+		CONN_TIME_ARGS(CONN_TIME_INTERVAL_US(info->interval)));
+
+	seq_valid = false;
+	k_work_submit(&scan_work);
+}
+
+static void term(struct bt_le_per_adv_sync *sync,
+		 const struct bt_le_per_adv_sync_term_info *info)
+{
+	LOG_INF("Sync lost (reason %u)", info->reason);
+
+	per_sync = NULL;
+	k_work_submit(&scan_work);
+}
+
+static void recv(struct bt_le_per_adv_sync *sync,
+		 const struct bt_le_per_adv_sync_recv_info *info, struct net_buf_simple *buf)
+{
+	const uint8_t *frame;
+	uint16_t seq;
+	uint8_t len;
+
+	if (info->data_status != BT_HCI_LE_ADV_EVT_TYPE_DATA_STATUS_COMPLETE) {
+		incomplete++;
+		return;
+	}
+
+	/* The train carries a single manufacturer specific data structure. */
+	if (buf->len < 2 || buf->data[1] != BT_DATA_MANUFACTURER_DATA) {
+		return;
+	}
+
+	len = buf->data[0] - 1;
+	frame = &buf->data[2];
+	if (len < FRAME_HEADER_LEN + sizeof(int16_t) || len > buf->len - 2 ||
+	    sys_get_le16(frame) != COMPANY_IDENTIFIER) {
+		return;
+	}
+
+	seq = sys_get_le16(&frame[2]);
+	if (seq_valid && seq == (uint16_t)(next_seq - 1)) {
+		/* The broadcaster repeats a frame until it has a new one. */
+		repeated++;
+		return;
+	}
+
+	if (seq_valid) {
+		lost += (uint16_t)(seq - next_seq);
+	}
+	next_seq = seq + 1;
+	seq_valid = true;
+
+	if (++frames == CONFIG_APP_REPORT_FRAMES) {
+		report(info->rssi, (int16_t)sys_get_le16(&frame[len - sizeof(int16_t)]));
+	}
+}
+
+static struct bt_le_per_adv_sync_cb sync_callbacks = {
+	.synced = synced,
+	.term = term,
+	.recv = recv,
+};
+
+void main(void)
+{
+	int err;
+
+	LOG_INF("Starting Lesson 2 - Periodic advertising receiver\n");
+
+	err = bt_enable(NULL);
+	if (err) {
+		LOG_ERR("Bluetooth init failed (err %d)", err);
+		return;
+	}
+
+	LOG_INF("Bluetooth initialized");
+
+	bt_le_scan_cb_register(&scan_callbacks);
+	bt_le_per_adv_sync_cb_register(&sync_callbacks);
+
+	k_work_submit(&scan_work);
+}
@@ -23,13 +23,14 @@
 #include <zephyr/bluetooth/gatt.h>
 
 #include "my_lbs.h"
+#include "gatt_chrc.h"
 
 LOG_MODULE_DECLARE(Lesson4_Exercise2);
 
 static bool notify_mysensor_enabled;
 static bool indicate_enabled;
-static bool button_state;
 static struct my_lbs_cb lbs_cb;
+static atomic_t led_write_count;
 
 /* STEP 4 - Define an indication parameter */
 
@@ -43,67 +44,56 @@ static void indicate_cb(struct bt_conn *conn, struct bt_gatt_indicate_params *pa
 	LOG_DBG("Indication %s\n", err != 0U ? "fail" : "success");
 }
 
-static ssize_t write_led(struct bt_conn *conn, const struct bt_gatt_attr *attr, const void *buf,
-			 uint16_t len, uint16_t offset, uint8_t flags)
+static inline void my_lbs_led_write(uint8_t val)
 {
-	LOG_DBG("Attribute write, handle: %u, conn: %p", attr->handle, (void *)conn);
-
-	if (len != 1U) {
-		LOG_DBG("Write led: Incorrect data length");
-		return BT_GATT_ERR(BT_ATT_ERR_INVALID_ATTRIBUTE_LEN);
-	}
-
-	if (offset != 0) {
-		LOG_DBG("Write led: Incorrect data offset");
-		return BT_GATT_ERR(BT_ATT_ERR_INVALID_OFFSET);
-	}
+	atomic_inc(&led_write_count);
 
 	if (lbs_cb.led_cb) {
-		// Read the received value
-		uint8_t val = *((uint8_t *)buf);
-
-		if (val == 0x00 || val == 0x01) {
-			// Call the application callback function to update the LED state
-			lbs_cb.led_cb(val ? true : false);
-		} else {
-			LOG_DBG("Write led: Incorrect value");
-			return BT_GATT_ERR(BT_ATT_ERR_VALUE_NOT_ALLOWED);
-		}
+		// Call the application callback function to update the LED state
+		lbs_cb.led_cb(val ? true : false);
 	}
-
-	return len;
 }
 
-static ssize_t read_button(struct bt_conn *conn, const struct bt_gatt_attr *attr, void *buf,
-			   uint16_t len, uint16_t offset)
+static inline bool my_lbs_button_read(void)
 {
-	// get a pointer to button_state which is passed in the BT_GATT_CHARACTERISTIC() and stored in attr->user_data
-	const char *value = attr->user_data;
-
-	LOG_DBG("Attribute read, handle: %u, conn: %p", attr->handle, (void *)conn);
-
-	if (lbs_cb.button_cb) {
-		// Call the application callback function to update the get the current value of the button
-		button_state = lbs_cb.button_cb();
-		return bt_gatt_attr_read(conn, attr, buf, len, offset, value, sizeof(*value));
-	}
-
-	return 0;
+	// Call the application callback function to get the current value of the button
+	return lbs_cb.button_cb ? lbs_cb.button_cb() : false;
 }
 
+#if defined(CONFIG_BT_LBS_LED_WRITE_WITHOUT_RESP)
+GATT_CHRC_SEQ_WRITE_DEFINE(write_led, uint8_t, 0x00, 0x01, my_lbs_led_write)
+#define LBS_LED_PROPS (BT_GATT_CHRC_WRITE | BT_GATT_CHRC_WRITE_WITHOUT_RESP)
+#else
+GATT_CHRC_WRITE_DEFINE(write_led, uint8_t, 0x00, 0x01, my_lbs_led_write)
+#define LBS_LED_PROPS BT_GATT_CHRC_WRITE
+#endif
+GATT_CHRC_READ_DEFINE(read_button, bool, my_lbs_button_read)
+
 /* LED Button Service Declaration */
 BT_GATT_SERVICE_DEFINE(
 	my_lbs_svc, BT_GATT_PRIMARY_SERVICE(BT_UUID_LBS),
 	/* STEP 1 - Modify the Button characteristic declaration to support indication */
 	BT_GATT_CHARACTERISTIC(BT_UUID_LBS_BUTTON, BT_GATT_CHRC_READ, BT_GATT_PERM_READ,
-			       read_button, NULL, &button_state),
+			       read_button, NULL, NULL),
 	/* STEP 2 - Create and add the Client Characteristic Configuration Descriptor */
 
-	BT_GATT_CHARACTERISTIC(BT_UUID_LBS_LED, BT_GATT_CHRC_WRITE, BT_GATT_PERM_WRITE, NULL,
-			       write_led, NULL),
+	BT_GATT_CHARACTERISTIC(BT_UUID_LBS_LED, LBS_LED_PROPS, BT_GATT_PERM_WRITE, NULL, write_led,
+			       NULL),
 	/* STEP 12 - Create and add the MYSENSOR characteristic and its CCCD  */
 
 );
+
+#if defined(CONFIG_BT_LBS_LED_WRITE_WITHOUT_RESP)
+static void my_lbs_disconnected(struct bt_conn *conn, uint8_t reason)
+{
+	write_led_seq_reset(conn);
+}
+
+BT_CONN_CB_DEFINE(my_lbs_conn_callbacks) = {
+	.disconnected = my_lbs_disconnected,
+};
+#endif
+
 /* A function to register application callbacks for the LED and Button characteristics  */
 int my_lbs_init(struct my_lbs_cb *callbacks)
 {
@@ -115,6 +105,11 @@ int my_lbs_init(struct my_lbs_cb *callbacks)
 	return 0;
 }
 
+uint32_t my_lbs_led_write_count(void)
+{
+	return (uint32_t)atomic_get(&led_write_count);
+}
+
 /* STEP 5.1 - Define the function to send indications */
 
 /* STEP 14 - Define the function to send notifications for the MYSENSOR characteristic */
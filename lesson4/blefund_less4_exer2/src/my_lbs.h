@@ -102,6 +102,17 @@ int my_lbs_send_button_state_notify(bool button_state);
  */
 int my_lbs_send_sensor_notify(uint32_t sensor_value);
 
+/** @brief Get the number of LED commands applied.
+ *
+ * With CONFIG_BT_LBS_LED_WRITE_WITHOUT_RESP the LED Characteristic also
+ * takes writes without response, optionally followed by a one byte
+ * sequence number; a write repeating the previous sequence number is
+ * dropped and not counted. The counter wraps around.
+ *
+ * @return Number of LED commands passed to the application since boot.
+ */
+uint32_t my_lbs_led_write_count(void);
+
 #ifdef __cplusplus
 }
 #endif
@@ -23,73 +23,60 @@
 #include <zephyr/bluetooth/gatt.h>
 
 #include "lbs.h"
+#include "gatt_chrc.h"
 
 #include <zephyr/logging/log.h>
 #define CONFIG_BT_LBS_LOG_LEVEL 3
 LOG_MODULE_REGISTER(bt_lbs, CONFIG_BT_LBS_LOG_LEVEL);
 
-static bool notify_enabled;
-static bool button_state;
 static struct bt_lbs_cb lbs_cb;
+static atomic_t led_write_count;
 
-static void lbslc_ccc_cfg_changed(const struct bt_gatt_attr *attr, uint16_t value)
+static inline void lbs_led_write(uint8_t val)
 {
-	notify_enabled = (value == BT_GATT_CCC_NOTIFY);
-}
-
-static ssize_t write_led(struct bt_conn *conn, const struct bt_gatt_attr *attr, const void *buf,
-			 uint16_t len, uint16_t offset, uint8_t flags)
-{
-	LOG_DBG("Attribute write, handle: %u, conn: %p", attr->handle, (void *)conn);
-
-	if (len != 1U) {
-		LOG_DBG("Write led: Incorrect data length");
-		return BT_GATT_ERR(BT_ATT_ERR_INVALID_ATTRIBUTE_LEN);
-	}
-
-	if (offset != 0) {
-		LOG_DBG("Write led: Incorrect data offset");
-		return BT_GATT_ERR(BT_ATT_ERR_INVALID_OFFSET);
-	}
+	atomic_inc(&led_write_count);
 
 	if (lbs_cb.led_cb) {
-		uint8_t val = *((uint8_t *)buf);
-
-		if (val == 0x00 || val == 0x01) {
-			lbs_cb.led_cb(val ? true : false);
-		} else {
-			LOG_DBG("Write led: Incorrect value");
-			return BT_GATT_ERR(BT_ATT_ERR_VALUE_NOT_ALLOWED);
-		}
+		lbs_cb.led_cb(val ? true : false);
 	}
-
-	return len;
 }
-static ssize_t read_button(struct bt_conn *conn, const struct bt_gatt_attr *attr, void *buf,
-			   uint16_t len, uint16_t offset)
-{
-	const char *value = attr->user_data;
-
-	LOG_DBG("Attribute read, handle: %u, conn: %p", attr->handle, (void *)conn);
-
-	if (lbs_cb.button_cb) {
-		button_state = lbs_cb.button_cb();
-		return bt_gatt_attr_read(conn, attr, buf, len, offset, value, sizeof(*value));
-	}
 
-	return 0;
+static inline bool lbs_button_read(void)
+{
+	return lbs_cb.button_cb ? lbs_cb.button_cb() : false;
 }
 
+GATT_CHRC_CCC_DEFINE(lbslc_ccc_cfg_changed, notify_enabled, BT_GATT_CCC_NOTIFY)
+#if defined(CONFIG_BT_LBS_LED_WRITE_WITHOUT_RESP)
+GATT_CHRC_SEQ_WRITE_DEFINE(write_led, uint8_t, 0x00, 0x01, lbs_led_write)
+#define LBS_LED_PROPS (BT_GATT_CHRC_WRITE | BT_GATT_CHRC_WRITE_WITHOUT_RESP)
+#else
+GATT_CHRC_WRITE_DEFINE(write_led, uint8_t, 0x00, 0x01, lbs_led_write)
+#define LBS_LED_PROPS BT_GATT_CHRC_WRITE
+#endif
+GATT_CHRC_READ_DEFINE(read_button, bool, lbs_button_read)
+
 /* LED Button Service Declaration */
 BT_GATT_SERVICE_DEFINE(
 	lbs_svc, BT_GATT_PRIMARY_SERVICE(BT_UUID_LBS),
 	BT_GATT_CHARACTERISTIC(BT_UUID_LBS_BUTTON, BT_GATT_CHRC_READ | BT_GATT_CHRC_NOTIFY,
-			       BT_GATT_PERM_READ, read_button, NULL, &button_state),
+			       BT_GATT_PERM_READ, read_button, NULL, NULL),
 	BT_GATT_CCC(lbslc_ccc_cfg_changed, BT_GATT_PERM_READ | BT_GATT_PERM_WRITE),
 	/* STEP 1.1 - Change the LED characteristic permission to require encryption */
 	/* STEP 8 - Change the LED characteristic permission to require pairing with authentication */
-	BT_GATT_CHARACTERISTIC(BT_UUID_LBS_LED, BT_GATT_CHRC_WRITE, BT_GATT_PERM_WRITE, NULL,
-			       write_led, NULL), );
+	BT_GATT_CHARACTERISTIC(BT_UUID_LBS_LED, LBS_LED_PROPS, BT_GATT_PERM_WRITE, NULL, write_led,
+			       NULL), );
+
+#if defined(CONFIG_BT_LBS_LED_WRITE_WITHOUT_RESP)
+static void lbs_disconnected(struct bt_conn *conn, uint8_t reason)
+{
+	write_led_seq_reset(conn);
+}
+
+BT_CONN_CB_DEFINE(lbs_conn_callbacks) = {
+	.disconnected = lbs_disconnected,
+};
+#endif
 
 int bt_lbs_init(struct bt_lbs_cb *callbacks)
 {
@@ -101,11 +88,14 @@ int bt_lbs_init(struct bt_lbs_cb *callbacks)
 	return 0;
 }
 
+GATT_CHRC_NOTIFY_DEFINE(lbs_button_notify, bool, &lbs_svc.attrs[2], notify_enabled)
+
 int bt_lbs_send_button_state(bool button_state)
 {
-	if (!notify_enabled) {
-		return -EACCES;
-	}
+	return lbs_button_notify(button_state);
+}
 
-	return bt_gatt_notify(NULL, &lbs_svc.attrs[2], &button_state, sizeof(button_state));
+uint32_t bt_lbs_led_write_count(void)
+{
+	return (uint32_t)atomic_get(&led_write_count);
 }
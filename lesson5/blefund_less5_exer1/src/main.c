@@ -111,6 +111,8 @@ static int init_button(void)
 void main(void)
 {
 	int blink_status = 0;
+	uint32_t last_led_writes = 0;
+	uint32_t led_writes;
 	int err;
 
 	LOG_INF("Starting Bluetooth Peripheral LBS example\n");
@@ -156,5 +158,13 @@ void main(void)
 	for (;;) {
 		dk_set_led(RUN_STATUS_LED, (++blink_status) % 2);
 		k_sleep(K_MSEC(RUN_LED_BLINK_INTERVAL));
+
+		led_writes = bt_lbs_led_write_count();
+		if (led_writes != last_led_writes) {
+			LOG_INF("LED commands: %u/s",
+				(led_writes - last_led_writes) * MSEC_PER_SEC /
+					RUN_LED_BLINK_INTERVAL);
+			last_led_writes = led_writes;
+		}
 	}
 }
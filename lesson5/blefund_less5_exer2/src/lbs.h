@@ -54,7 +54,10 @@ struct bt_lbs_cb {
  * Send notifications for the Button Characteristic to let connected peers know
  * when the button state changes.
  * Write to the LED Characteristic to change the state of the LED on the
- * board.
+ * board. With CONFIG_BT_LBS_LED_WRITE_WITHOUT_RESP the LED Characteristic
+ * also takes writes without response, optionally followed by a one byte
+ * sequence number; a write repeating the previous sequence number is
+ * dropped.
  *
  * @param[in] callbacks Struct containing pointers to callback functions
  *			used by the service. This pointer can be NULL
@@ -78,6 +81,14 @@ int bt_lbs_init(struct bt_lbs_cb *callbacks);
  */
 int bt_lbs_send_button_state(bool button_state);
 
+/** @brief Get the number of LED commands applied.
+ *
+ * Duplicate sequenced writes are not counted. The counter wraps around.
+ *
+ * @return Number of LED commands passed to the application since boot.
+ */
+uint32_t bt_lbs_led_write_count(void);
+
 #ifdef __cplusplus
 }
 #endif
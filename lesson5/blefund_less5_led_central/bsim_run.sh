@@ -0,0 +1,39 @@
+#!/usr/bin/env bash
+#
+# Copyright (c) 2023 Nordic Semiconductor ASA
+#
+# SPDX-License-Identifier: LicenseRef-Nordic-5-Clause
+#
+# Measures the LED command rate in nrf52_bsim. Runs lesson5_exer1 against
+# this central, once with write requests and once with writes without
+# response. The central logs the completed commands per second, the
+# peripheral (d_0) the applied ones.
+#
+# Usage: bsim_run.sh [mode...], both modes if none is given.
+
+APP_DIR="$(cd "$(dirname "$0")" && pwd)"
+source "${APP_DIR}/../../scripts/bsim_common.sh"
+
+PERIPHERAL_DIR="${APP_DIR}/../blefund_less5_exer1"
+
+# CONFIG_APP_TEST_ROUNDS rounds, with margin
+SIM_LENGTH_S=45
+
+declare -A PERIPHERALS=(
+	[write]=""
+	[write_without_resp]="-DCONFIG_BT_LBS_LED_WRITE_WITHOUT_RESP=y"
+)
+declare -A CENTRALS=(
+	[write]=""
+	[write_without_resp]="-DCONFIG_APP_WRITE_WITHOUT_RESP=y"
+)
+ORDER="write write_without_resp"
+
+for mode in ${@:-${ORDER}}; do
+	echo "=== ${mode} ==="
+	# shellcheck disable=SC2086
+	peripheral=$(bsim_build "led_peripheral_${mode}" "${PERIPHERAL_DIR}" ${PERIPHERALS[${mode}]})
+	# shellcheck disable=SC2086
+	central=$(bsim_build "led_central_${mode}" "${APP_DIR}" ${CENTRALS[${mode}]})
+	bsim_run "led_${mode}" "${SIM_LENGTH_S}" "${peripheral}" "${central}"
+done
@@ -0,0 +1,374 @@
+/*
+ * Copyright (c) 2023 Nordic Semiconductor ASA
+ *
+ * SPDX-License-Identifier: LicenseRef-Nordic-5-Clause
+ */
+
+/** @file
+ *  @brief Central that measures the LED command rate of the LBS
+ *
+ * Connects to lesson5_exer1, discovers the LED characteristic and toggles
+ * the LED as fast as the link allows for a number of test rounds. Every
+ * command is either a write request, which waits for its response, or
+ * with CONFIG_APP_WRITE_WITHOUT_RESP a write without response followed by
+ * a sequence number. The rate of completed commands is logged per round,
+ * the peripheral logs the rate of applied commands.
+ */
+
+#include <errno.h>
+#include <string.h>
+#include <zephyr/kernel.h>
+#include <zephyr/logging/log.h>
+#include <zephyr/sys/atomic.h>
+#include <zephyr/bluetooth/bluetooth.h>
+#include <zephyr/bluetooth/gap.h>
+#include <zephyr/bluetooth/gatt.h>
+#include <zephyr/bluetooth/uuid.h>
+#include <zephyr/bluetooth/conn.h>
+
+#include "lbs.h"
+
+LOG_MODULE_REGISTER(Lesson5_LED_Central, LOG_LEVEL_INF);
+
+#define ROUND_MS (CONFIG_APP_TEST_DURATION_S * MSEC_PER_SEC)
+
+#if defined(CONFIG_APP_WRITE_WITHOUT_RESP)
+#define TX_WINDOW CONFIG_APP_TX_WINDOW
+#else
+#define TX_WINDOW 1
+#endif
+
+#define TEST_STACK_SIZE 1024
+#define TEST_PRIORITY 7
+
+static struct bt_le_conn_param *conn_param =
+	BT_LE_CONN_PARAM(CONFIG_APP_CONN_INTERVAL, CONFIG_APP_CONN_INTERVAL, 0, 400);
+
+static struct bt_conn *my_conn;
+
+static struct bt_uuid_128 led_uuid = BT_UUID_INIT_128(BT_UUID_LBS_LED_VAL);
+static struct bt_gatt_discover_params discover_params;
+static struct bt_gatt_write_params write_params;
+
+static uint16_t led_handle;
+
+/* Commands completed in the current round */
+static atomic_t commands;
+/* Changed on every disconnection, ends the test of the connection */
+static atomic_t conn_gen;
+
+struct test_req {
+	/* Referenced connection to test */
+	struct bt_conn *conn;
+	atomic_val_t gen;
+};
+
+K_MSGQ_DEFINE(start_msgq, sizeof(struct test_req), 1, 4);
+/* Commands in flight */
+static K_SEM_DEFINE(tx_sem, TX_WINDOW, TX_WINDOW);
+
+static void scan_start(void);
+
+static void write_rsp(struct bt_conn *conn, uint8_t err, struct bt_gatt_write_params *params)
+{
+	if (!err) {
+		atomic_inc(&commands);
+	}
+
+	k_sem_give(&tx_sem);
+}
+
+static void write_done(struct bt_conn *conn, void *user_data)
+{
+	atomic_inc(&commands);
+	k_sem_give(&tx_sem);
+}
+
+/* Send the LED command with the given sequence number */
+static int command_send(struct bt_conn *conn, uint8_t seq)
+{
+	/* Only used by the test thread, stays valid while a write request
+	 * is pending.
+	 */
+	static uint8_t cmd[2];
+
+	/* LED value, then the sequence number */
+	cmd[0] = seq & 1;
+	cmd[1] = seq;
+
+	if (IS_ENABLED(CONFIG_APP_WRITE_WITHOUT_RESP)) {
+		return bt_gatt_write_without_response_cb(conn, led_handle, cmd, sizeof(cmd), false,
+							 write_done, NULL);
+	}
+
+	write_params.func = write_rsp;
+	write_params.handle = led_handle;
+	write_params.offset = 0;
+	write_params.data = cmd;
+	write_params.length = 1;
+
+	return bt_gatt_write(conn, &write_params);
+}
+
+/* Run a test round and get the completed commands per second */
+static int round_run(struct bt_conn *conn, atomic_val_t gen, uint8_t *seq, uint32_t *rate)
+{
+	uint32_t start;
+	uint32_t elapsed_ms;
+	int err;
+
+	atomic_clear(&commands);
+	start = k_uptime_get_32();
+
+	while (k_uptime_get_32() - start < ROUND_MS) {
+		if (atomic_get(&conn_gen) != gen) {
+			return -ENOTCONN;
+		}
+
+		if (k_sem_take(&tx_sem, K_MSEC(100))) {
+			continue;
+		}
+
+		err = command_send(conn, *seq);
+		if (err) {
+			k_sem_give(&tx_sem);
+			if (err == -ENOTCONN) {
+				return err;
+			}
+			/* Out of buffers, let the stack catch up. */
+			k_sleep(K_MSEC(10));
+			continue;
+		}
+
+		(*seq)++;
+	}
+
+	/* Commands still in flight belong to this round. */
+	for (int i = 0; i < TX_WINDOW; i++) {
+		if (k_sem_take(&tx_sem, K_SECONDS(4))) {
+			return -ETIMEDOUT;
+		}
+	}
+	for (int i = 0; i < TX_WINDOW; i++) {
+		k_sem_give(&tx_sem);
+	}
+
+	elapsed_ms = MAX(k_uptime_get_32() - start, 1);
+	*rate = (uint64_t)atomic_get(&commands) * MSEC_PER_SEC / elapsed_ms;
+
+	LOG_INF("LED commands: %u/s, %u in %u ms", *rate, (uint32_t)atomic_get(&commands),
+		elapsed_ms);
+
+	return 0;
+}
+
+static void test_run(struct bt_conn *conn, atomic_val_t gen)
+{
+	uint8_t seq = 0;
+	uint32_t rate;
+	uint32_t rate_min = UINT32_MAX;
+	uint64_t rate_sum = 0;
+	int rounds;
+	int err;
+
+	/* Completions of the previous connection may never come. */
+	k_sem_init(&tx_sem, TX_WINDOW, TX_WINDOW);
+
+	for (rounds = 0; rounds < CONFIG_APP_TEST_ROUNDS; rounds++) {
+		LOG_INF("Round %d of %d", rounds + 1, CONFIG_APP_TEST_ROUNDS);
+
+		err = round_run(conn, gen, &seq, &rate);
+		if (err) {
+			LOG_WRN("Round aborted (err %d)", err);
+			break;
+		}
+
+		rate_sum += rate;
+		rate_min = MIN(rate_min, rate);
+	}
+
+	if (!rounds) {
+		return;
+	}
+
+	LOG_INF("Test done, %d rounds of %u s, %s", rounds, CONFIG_APP_TEST_DURATION_S,
+		IS_ENABLED(CONFIG_APP_WRITE_WITHOUT_RESP) ? "write without response" :
+							    "write request");
+	LOG_INF("LED commands: %u/s avg, %u/s min", (uint32_t)(rate_sum / rounds), rate_min);
+}
+
+static void test_thread(void)
+{
+	struct test_req req;
+
+	for (;;) {
+		k_msgq_get(&start_msgq, &req, K_FOREVER);
+		test_run(req.conn, req.gen);
+		bt_conn_unref(req.conn);
+	}
+}
+
+K_THREAD_DEFINE(test_thread_id, TEST_STACK_SIZE, test_thread, NULL, NULL, NULL, TEST_PRIORITY, 0,
+		0);
+
+static void test_start(struct bt_conn *conn)
+{
+	struct test_req req = {
+		.conn = bt_conn_ref(conn),
+		.gen = atomic_get(&conn_gen),
+	};
+
+	if (k_msgq_put(&start_msgq, &req, K_NO_WAIT)) {
+		LOG_ERR("Test already pending");
+		bt_conn_unref(req.conn);
+	}
+}
+
+static uint8_t discover_func(struct bt_conn *conn, const struct bt_gatt_attr *attr,
+			     struct bt_gatt_discover_params *params)
+{
+	struct bt_gatt_chrc *chrc;
+
+	if (!attr) {
+		LOG_ERR("LED characteristic not found");
+		memset(params, 0, sizeof(*params));
+		return BT_GATT_ITER_STOP;
+	}
+
+	chrc = attr->user_data;
+
+	if (IS_ENABLED(CONFIG_APP_WRITE_WITHOUT_RESP) &&
+	    !(chrc->properties & BT_GATT_CHRC_WRITE_WITHOUT_RESP)) {
+		LOG_ERR("LED characteristic takes no writes without response, build the "
+			"peripheral with CONFIG_BT_LBS_LED_WRITE_WITHOUT_RESP");
+		return BT_GATT_ITER_STOP;
+	}
+
+	led_handle = chrc->value_handle;
+	LOG_INF("LED characteristic found, handle %u", led_handle);
+	test_start(conn);
+
+	return BT_GATT_ITER_STOP;
+}
+
+static void discover_led(struct bt_conn *conn)
+{
+	int err;
+
+	led_handle = 0;
+
+	discover_params.uuid = &led_uuid.uuid;
+	discover_params.func = discover_func;
+	discover_params.start_handle = BT_ATT_FIRST_ATTRIBUTE_HANDLE;
+	discover_params.end_handle = BT_ATT_LAST_ATTRIBUTE_HANDLE;
+	discover_params.type = BT_GATT_DISCOVER_CHARACTERISTIC;
+
+	err = bt_gatt_discover(conn, &discover_params);
+	if (err) {
+		LOG_ERR("Discovery failed (err %d)", err);
+	}
+}
+
+static bool name_matches(struct bt_data *data, void *user_data)
+{
+	bool *found = user_data;
+
+	if (data->type == BT_DATA_NAME_COMPLETE &&
+	    data->data_len == sizeof(CONFIG_APP_PEER_NAME) - 1 &&
+	    memcmp(data->data, CONFIG_APP_PEER_NAME, data->data_len) == 0) {
+		*found = true;
+		return false;
+	}
+
+	return true;
+}
+
+static void device_found(const bt_addr_le_t *addr, int8_t rssi, uint8_t type,
+			 struct net_buf_simple *ad)
+{
+	bool found = false;
+	int err;
+
+	if (type != BT_GAP_ADV_TYPE_ADV_IND) {
+		return;
+	}
+
+	bt_data_parse(ad, name_matches, &found);
+	if (!found) {
+		return;
+	}
+
+	err = bt_le_scan_stop();
+	if (err) {
+		LOG_ERR("Stop LE scan failed (err %d)", err);
+		return;
+	}
+
+	err = bt_conn_le_create(addr, BT_CONN_LE_CREATE_CONN, conn_param, &my_conn);
+	if (err) {
+		LOG_ERR("Create connection failed (err %d)", err);
+		scan_start();
+	}
+}
+
+static void scan_start(void)
+{
+	int err;
+
+	err = bt_le_scan_start(BT_LE_SCAN_PASSIVE, device_found);
+	if (err) {
+		LOG_ERR("Scanning failed to start (err %d)", err);
+		return;
+	}
+
+	LOG_INF("Scanning for %s", CONFIG_APP_PEER_NAME);
+}
+
+/* Callbacks */
+void on_connected(struct bt_conn *conn, uint8_t err)
+{
+	if (err) {
+		LOG_ERR("Connection error %d", err);
+		bt_conn_unref(my_conn);
+		my_conn = NULL;
+		scan_start();
+		return;
+	}
+
+	LOG_INF("Connected");
+	discover_led(conn);
+}
+
+void on_disconnected(struct bt_conn *conn, uint8_t reason)
+{
+	LOG_INF("Disconnected. Reason %d", reason);
+
+	atomic_inc(&conn_gen);
+
+	bt_conn_unref(my_conn);
+	my_conn = NULL;
+	scan_start();
+}
+
+struct bt_conn_cb connection_callbacks = {
+	.connected = on_connected,
+	.disconnected = on_disconnected,
+};
+
+void main(void)
+{
+	int err;
+
+	LOG_INF("Starting Lesson 5 - LED write central\n");
+
+	bt_conn_cb_register(&connection_callbacks);
+
+	err = bt_enable(NULL);
+	if (err) {
+		LOG_ERR("Bluetooth init failed (err %d)", err);
+		return;
+	}
+
+	LOG_INF("Bluetooth initialized");
+	scan_start();
+}
@@ -0,0 +1,253 @@
+/*
+ * Copyright (c) 2023 Nordic Semiconductor ASA
+ *
+ * SPDX-License-Identifier: LicenseRef-Nordic-5-Clause
+ */
+
+/** @file
+ *  @brief Advertising scheduler
+ */
+
+#include <zephyr/types.h>
+#include <errno.h>
+#include <zephyr/kernel.h>
+#include <zephyr/sys/atomic.h>
+#include <zephyr/bluetooth/bluetooth.h>
+#include <zephyr/bluetooth/conn.h>
+
+#include "adv_sched.h"
+#include "adv_time.h"
+#include "conn_time.h"
+
+#include <zephyr/logging/log.h>
+LOG_MODULE_REGISTER(adv_sched, LOG_LEVEL_INF);
+
+/* The scheduler restarts advertising itself after a disconnection. */
+#define ADV_OPTIONS (BT_LE_ADV_OPT_CONNECTABLE | BT_LE_ADV_OPT_USE_IDENTITY | BT_LE_ADV_OPT_ONE_TIME)
+
+#define EVENT_CHARGE_NC CONFIG_APP_ADV_EVENT_CHARGE_NC
+#define SLEEP_CURRENT_NA CONFIG_APP_ADV_SLEEP_CURRENT_NA
+
+#define PHASE_NONE -1
+
+/* Right after a disconnection the connection object may not be free yet. */
+#define ADV_RETRY_MS 100
+
+struct adv_phase {
+	uint16_t interval_ms;
+	/* 0 keeps the phase until a central connects */
+	uint16_t duration_s;
+};
+
+static const struct adv_phase phases[] = {
+	{ CONFIG_APP_ADV_FAST_INTERVAL_MS, CONFIG_APP_ADV_FAST_DURATION_S },
+	{ CONFIG_APP_ADV_MEDIUM_INTERVAL_MS, CONFIG_APP_ADV_MEDIUM_DURATION_S },
+	{ CONFIG_APP_ADV_SLOW_INTERVAL_MS, 0 },
+};
+
+static const struct bt_data *adv_ad;
+static size_t adv_ad_len;
+static const struct bt_data *adv_sd;
+static size_t adv_sd_len;
+
+/* Only changed from the system workqueue, except the connected flag */
+static atomic_t connected;
+static int phase = PHASE_NONE;
+static int retry_phase;
+static int64_t phase_start;
+static int64_t burst_start;
+static uint64_t phase_time_ms[ARRAY_SIZE(phases)];
+static uint32_t connections;
+static uint64_t connect_time_ms;
+
+static void phase_account(void)
+{
+	int64_t now = k_uptime_get();
+
+	if (phase != PHASE_NONE) {
+		phase_time_ms[phase] += now - phase_start;
+	}
+
+	phase_start = now;
+}
+
+static void phase_work_handler(struct k_work *work);
+static void retry_work_handler(struct k_work *work);
+
+static K_WORK_DELAYABLE_DEFINE(phase_work, phase_work_handler);
+static K_WORK_DELAYABLE_DEFINE(retry_work, retry_work_handler);
+
+static void phase_enter(int next)
+{
+	const struct adv_phase *p = &phases[next];
+	struct bt_le_adv_param param =
+		BT_LE_ADV_PARAM_INIT(ADV_OPTIONS, CONN_TIME_MS_TO_ADV(p->interval_ms),
+				     CONN_TIME_MS_TO_ADV(p->interval_ms) + 1, NULL);
+	int err;
+
+	/* The interval of a running advertiser cannot be changed. */
+	err = bt_le_adv_stop();
+	if (err) {
+		LOG_WRN("Failed to stop advertising (err %d)", err);
+	}
+
+	phase_account();
+	phase = PHASE_NONE;
+
+	err = bt_le_adv_start(&param, adv_ad, adv_ad_len, adv_sd, adv_sd_len);
+	if (err) {
+		LOG_ERR("Advertising failed to start (err %d), retrying", err);
+		retry_phase = next;
+		k_work_reschedule(&retry_work, K_MSEC(ADV_RETRY_MS));
+		return;
+	}
+
+	k_work_cancel_delayable(&retry_work);
+	phase = next;
+	LOG_INF("Advertising phase %d, interval %u ms", next, p->interval_ms);
+
+	if (p->duration_s) {
+		k_work_reschedule(&phase_work, K_SECONDS(p->duration_s));
+	} else {
+		k_work_cancel_delayable(&phase_work);
+	}
+}
+
+static void phase_work_handler(struct k_work *work)
+{
+	int next = phase + 1;
+
+	if (atomic_get(&connected) || phase == PHASE_NONE) {
+		return;
+	}
+
+	/* Skip phases that are configured away, but never the last one. */
+	while (next < ARRAY_SIZE(phases) - 1 && phases[next].duration_s == 0) {
+		next++;
+	}
+
+	phase_enter(next);
+}
+
+static void retry_work_handler(struct k_work *work)
+{
+	if (atomic_get(&connected)) {
+		return;
+	}
+
+	phase_enter(retry_phase);
+}
+
+static void start_work_handler(struct k_work *work)
+{
+	if (atomic_get(&connected)) {
+		return;
+	}
+
+	burst_start = k_uptime_get();
+	phase_enter(0);
+}
+
+static K_WORK_DEFINE(start_work, start_work_handler);
+
+static void connected_work_handler(struct k_work *work)
+{
+	int64_t elapsed = k_uptime_get() - burst_start;
+
+	k_work_cancel_delayable(&phase_work);
+	k_work_cancel_delayable(&retry_work);
+
+	if (phase == PHASE_NONE) {
+		return;
+	}
+
+	LOG_INF("Connected after %u ms of advertising, in phase %d", (uint32_t)elapsed, phase);
+	connections++;
+	connect_time_ms += elapsed;
+
+	/* Advertising stopped with the connection. */
+	phase_account();
+	phase = PHASE_NONE;
+}
+
+static K_WORK_DEFINE(connected_work, connected_work_handler);
+
+static void on_connected(struct bt_conn *conn, uint8_t err)
+{
+	if (err) {
+		return;
+	}
+
+	atomic_set(&connected, true);
+	k_work_submit(&connected_work);
+}
+
+static void on_disconnected(struct bt_conn *conn, uint8_t reason)
+{
+	atomic_set(&connected, false);
+	k_work_submit(&start_work);
+}
+
+BT_CONN_CB_DEFINE(adv_sched_conn_callbacks) = {
+	.connected = on_connected,
+	.disconnected = on_disconnected,
+};
+
+int adv_sched_start(const struct bt_data *ad, size_t ad_len, const struct bt_data *sd,
+		    size_t sd_len)
+{
+	adv_ad = ad;
+	adv_ad_len = ad_len;
+	adv_sd = sd;
+	adv_sd_len = sd_len;
+
+	return k_work_submit(&start_work) < 0 ? -EIO : 0;
+}
+
+void adv_sched_kick(void)
+{
+	if (!atomic_get(&connected)) {
+		k_work_submit(&start_work);
+	}
+}
+
+/* Modelled average current while advertising at the given interval */
+static uint32_t phase_current_na(const struct adv_phase *p)
+{
+	uint32_t period_us = ADV_TIME_PERIOD_US(p->interval_ms * USEC_PER_MSEC);
+
+	return (uint64_t)EVENT_CHARGE_NC * USEC_PER_SEC / period_us + SLEEP_CURRENT_NA;
+}
+
+void adv_sched_report(void)
+{
+	uint64_t total_nc = 0;
+
+	for (int i = 0; i < ARRAY_SIZE(phases); i++) {
+		const struct adv_phase *p = &phases[i];
+		uint32_t current_na = phase_current_na(p);
+		uint64_t time_ms = phase_time_ms[i];
+		uint64_t charge_nc;
+		uint32_t discovery_us;
+
+		if (i == phase) {
+			time_ms += k_uptime_get() - phase_start;
+		}
+
+		/* nA * ms is pC */
+		charge_nc = (uint64_t)current_na * time_ms / 1000U;
+		total_nc += charge_nc;
+
+		/* Discovery by a central scanning without gaps */
+		discovery_us = ADV_TIME_DISCOVERY_CONT_US(p->interval_ms * USEC_PER_MSEC);
+
+		LOG_INF("Phase %d: interval %u ms, %u.%03u uA, discovery %u ms avg, %u s used, %u uC",
+			i, p->interval_ms, current_na / 1000U, current_na % 1000U,
+			discovery_us / USEC_PER_MSEC, (uint32_t)(time_ms / MSEC_PER_SEC),
+			(uint32_t)(charge_nc / 1000U));
+	}
+
+	LOG_INF("Advertising charge %u uC, %u connections, %u ms average time to connect",
+		(uint32_t)(total_nc / 1000U), connections,
+		connections ? (uint32_t)(connect_time_ms / connections) : 0);
+}
@@ -0,0 +1,64 @@
+/*
+ * Copyright (c) 2023 Nordic Semiconductor ASA
+ *
+ * SPDX-License-Identifier: LicenseRef-Nordic-5-Clause
+ */
+
+#ifndef ADV_SCHED_H_
+#define ADV_SCHED_H_
+
+/**@file
+ * @defgroup adv_sched Advertising scheduler
+ * @{
+ * @brief Connectable advertising that steps down from fast to slow.
+ *
+ * Advertising starts in a fast phase and moves to longer intervals after
+ * the phase durations set in Kconfig. Boot, a disconnection and
+ * adv_sched_kick() all restart the fast phase. The scheduler keeps track
+ * of the time spent in each phase and reports the simulated charge used
+ * and the time it took a central to connect.
+ */
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <zephyr/types.h>
+#include <zephyr/bluetooth/bluetooth.h>
+
+/** @brief Start advertising in the fast phase.
+ *
+ * The data arrays must stay valid, advertising is restarted with them
+ * after every disconnection.
+ *
+ * @param[in] ad Data to be used in advertisement packets.
+ * @param[in] ad_len Number of elements in @p ad.
+ * @param[in] sd Data to be used in scan response packets.
+ * @param[in] sd_len Number of elements in @p sd.
+ *
+ * @retval 0 If the operation was successful.
+ *           Otherwise, a (negative) error code is returned.
+ */
+int adv_sched_start(const struct bt_data *ad, size_t ad_len, const struct bt_data *sd,
+		    size_t sd_len);
+
+/** @brief Go back to the fast phase on an application event.
+ *
+ * Does nothing while connected.
+ */
+void adv_sched_kick(void);
+
+/** @brief Log the modelled current and discovery latency of every phase,
+ *  and the simulated charge used so far.
+ */
+void adv_sched_report(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+/**
+ * @}
+ */
+
+#endif /* ADV_SCHED_H_ */
@@ -0,0 +1,241 @@
+/*
+ * Copyright (c) 2023 Nordic Semiconductor ASA
+ *
+ * SPDX-License-Identifier: LicenseRef-Nordic-5-Clause
+ */
+
+/** @file
+ *  @brief Bulk transfer service
+ */
+
+#include <zephyr/types.h>
+#include <errno.h>
+#include <zephyr/kernel.h>
+#include <zephyr/sys/atomic.h>
+#include <zephyr/sys/byteorder.h>
+#include <zephyr/bluetooth/bluetooth.h>
+#include <zephyr/bluetooth/conn.h>
+#include <zephyr/bluetooth/uuid.h>
+#include <zephyr/bluetooth/gatt.h>
+
+#include "bulk_svc.h"
+#include "link_chunk.h"
+#include "link_setup.h"
+#include "gatt_chrc.h"
+
+#include <zephyr/logging/log.h>
+LOG_MODULE_REGISTER(bulk_svc, LOG_LEVEL_INF);
+
+#define BULK_LEN_MAX (CONFIG_BT_L2CAP_TX_MTU - 3)
+#define TX_WINDOW CONFIG_APP_BULK_SVC_TX_WINDOW
+#define REPORT_MS 1000
+
+#define BULK_STACK_SIZE 1024
+#define BULK_PRIORITY 7
+
+static struct bulk_svc_cb bulk_cb;
+static uint8_t tx_data[BULK_LEN_MAX];
+static bool notify_enabled;
+
+/* Traffic of the current report period */
+static atomic_t tx_bytes;
+static atomic_t rx_bytes;
+/* Received since the connection was established */
+static atomic_t rx_total;
+/* Notified bytes not sent yet */
+static atomic_t in_flight;
+static uint32_t report_since;
+
+static K_SEM_DEFINE(start_sem, 0, 1);
+/* Notifications in flight */
+static K_SEM_DEFINE(tx_sem, TX_WINDOW, TX_WINDOW);
+
+static void tx_ccc_changed(const struct bt_gatt_attr *attr, uint16_t value)
+{
+	notify_enabled = (value == BT_GATT_CCC_NOTIFY);
+	if (notify_enabled) {
+		k_sem_give(&start_sem);
+	}
+}
+
+static ssize_t write_rx(struct bt_conn *conn, const struct bt_gatt_attr *attr, const void *buf,
+			uint16_t len, uint16_t offset, uint8_t flags)
+{
+	if (offset != 0) {
+		return BT_GATT_ERR(BT_ATT_ERR_INVALID_OFFSET);
+	}
+
+	atomic_add(&rx_bytes, len);
+	atomic_add(&rx_total, len);
+	if (bulk_cb.received_cb) {
+		bulk_cb.received_cb(conn, len);
+	}
+
+	return len;
+}
+
+static inline uint32_t rx_count_get(void)
+{
+	return sys_cpu_to_le32(atomic_get(&rx_total));
+}
+
+GATT_CHRC_READ_DEFINE(read_rx_count, uint32_t, rx_count_get)
+
+/* Bulk Service Declaration */
+BT_GATT_SERVICE_DEFINE(bulk_svc, BT_GATT_PRIMARY_SERVICE(BT_UUID_BULK),
+		       BT_GATT_CHARACTERISTIC(BT_UUID_BULK_TX, BT_GATT_CHRC_NOTIFY,
+					      BT_GATT_PERM_NONE, NULL, NULL, NULL),
+		       BT_GATT_CCC(tx_ccc_changed, BT_GATT_PERM_READ | BT_GATT_PERM_WRITE),
+		       BT_GATT_CHARACTERISTIC(BT_UUID_BULK_RX, BT_GATT_CHRC_WRITE_WITHOUT_RESP,
+					      BT_GATT_PERM_WRITE, NULL, write_rx, NULL),
+		       BT_GATT_CHARACTERISTIC(BT_UUID_BULK_RX_COUNT, BT_GATT_CHRC_READ,
+					      BT_GATT_PERM_READ, read_rx_count, NULL, NULL), );
+
+static void report_work_handler(struct k_work *work);
+
+static K_WORK_DELAYABLE_DEFINE(report_work, report_work_handler);
+
+static void report_work_handler(struct k_work *work)
+{
+	uint32_t now = k_uptime_get_32();
+	uint32_t elapsed_ms = MAX(now - report_since, 1);
+	uint32_t tx = atomic_clear(&tx_bytes);
+	uint32_t rx = atomic_clear(&rx_bytes);
+
+	report_since = now;
+
+	/* Bytes per millisecond times 8 is kbit/s. */
+	LOG_INF("TX %u kbps, RX %u kbps", tx * 8 / elapsed_ms, rx * 8 / elapsed_ms);
+
+	k_work_reschedule(&report_work, K_MSEC(REPORT_MS));
+}
+
+static void backlog_add(atomic_val_t len)
+{
+	atomic_val_t bytes = atomic_add(&in_flight, len) + len;
+
+	/* Completions still come in after streaming stopped. */
+	if (bulk_cb.backlog_cb) {
+		bulk_cb.backlog_cb(MAX(bytes, 0));
+	}
+}
+
+static void notify_sent(struct bt_conn *conn, void *user_data)
+{
+	size_t len = POINTER_TO_UINT(user_data);
+
+	atomic_add(&tx_bytes, len);
+	if (bulk_cb.sent_cb) {
+		bulk_cb.sent_cb(conn, len);
+	}
+	backlog_add(-(atomic_val_t)len);
+
+	k_sem_give(&tx_sem);
+}
+
+static void bulk_run(uint16_t len)
+{
+	struct bt_gatt_notify_params params = {
+		.attr = &bulk_svc.attrs[2],
+		.data = tx_data,
+		.func = notify_sent,
+	};
+	uint16_t chunk;
+	int err;
+
+	/* Completions of the previous connection may never come. */
+	k_sem_init(&tx_sem, TX_WINDOW, TX_WINDOW);
+	atomic_clear(&in_flight);
+	atomic_clear(&tx_bytes);
+	atomic_clear(&rx_bytes);
+	report_since = k_uptime_get_32();
+	k_work_reschedule(&report_work, K_MSEC(REPORT_MS));
+
+	while (notify_enabled) {
+		if (k_sem_take(&tx_sem, K_MSEC(REPORT_MS))) {
+			continue;
+		}
+
+		/* The data length may change while streaming. */
+		chunk = IS_ENABLED(CONFIG_APP_BULK_SVC_PDU_ALIGN) ? link_chunk_size(NULL, len) : 0;
+		if (!chunk) {
+			chunk = len;
+		}
+
+		if (chunk != params.len) {
+			LOG_INF("Streaming %u byte notifications", chunk);
+			params.len = chunk;
+			params.user_data = UINT_TO_POINTER(chunk);
+		}
+
+		/* Counted before, the notification may be sent right away. */
+		backlog_add(params.len);
+
+		err = bt_gatt_notify_cb(NULL, &params);
+		if (err) {
+			backlog_add(-(atomic_val_t)params.len);
+			k_sem_give(&tx_sem);
+			if (bulk_cb.failed_cb) {
+				bulk_cb.failed_cb(err);
+			}
+			if (err == -ENOTCONN) {
+				break;
+			}
+			/* Out of buffers, let the stack catch up. */
+			k_sleep(K_MSEC(10));
+		}
+	}
+
+	k_work_cancel_delayable(&report_work);
+	/* Completions of a lost connection never come. */
+	atomic_clear(&in_flight);
+	backlog_add(0);
+	LOG_INF("Streaming stopped");
+}
+
+static void bulk_thread(void)
+{
+	struct link_setup_result link;
+
+	for (int i = 0; i < sizeof(tx_data); i++) {
+		tx_data[i] = i;
+	}
+
+	for (;;) {
+		k_sem_take(&start_sem, K_FOREVER);
+
+		/* Stream with the negotiated MTU, not the default one. */
+		link_setup_wait(K_FOREVER, &link);
+		if (!notify_enabled) {
+			continue;
+		}
+
+		bulk_run(MIN(link.mtu - 3, BULK_LEN_MAX));
+	}
+}
+
+K_THREAD_DEFINE(bulk_thread_id, BULK_STACK_SIZE, bulk_thread, NULL, NULL, NULL, BULK_PRIORITY, 0,
+		0);
+
+static void on_connected(struct bt_conn *conn, uint8_t err)
+{
+	if (!err) {
+		atomic_clear(&rx_total);
+	}
+}
+
+BT_CONN_CB_DEFINE(bulk_svc_conn_callbacks) = {
+	.connected = on_connected,
+};
+
+int bulk_svc_init(const struct bulk_svc_cb *callbacks)
+{
+	if (callbacks) {
+		bulk_cb.sent_cb = callbacks->sent_cb;
+		bulk_cb.received_cb = callbacks->received_cb;
+		bulk_cb.failed_cb = callbacks->failed_cb;
+		bulk_cb.backlog_cb = callbacks->backlog_cb;
+	}
+
+	return 0;
+}
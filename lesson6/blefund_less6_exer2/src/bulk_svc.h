@@ -0,0 +1,94 @@
+/*
+ * Copyright (c) 2023 Nordic Semiconductor ASA
+ *
+ * SPDX-License-Identifier: LicenseRef-Nordic-5-Clause
+ */
+
+#ifndef BULK_SVC_H_
+#define BULK_SVC_H_
+
+/**@file
+ * @defgroup bulk_svc Bulk transfer service
+ * @{
+ * @brief GATT service that streams data to the central and sinks data
+ *  written by it, to measure the throughput of the link.
+ *
+ * Once the central enables notifications of the TX characteristic and the
+ * link setup is done, the peripheral notifies as fast as the stack takes
+ * the data, with ATT MTU - 3 bytes per notification. Data written without
+ * response to the RX characteristic is counted and dropped. The TX and RX
+ * throughput is logged every second, and the RX byte count can be read
+ * by the central.
+ */
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <zephyr/types.h>
+#include <zephyr/bluetooth/conn.h>
+#include <zephyr/bluetooth/uuid.h>
+
+/** @brief Bulk Service UUID. */
+#define BT_UUID_BULK_VAL BT_UUID_128_ENCODE(0x00001600, 0x1212, 0xefde, 0x1523, 0x785feabcd123)
+
+/** @brief TX Characteristic UUID, notified by the peripheral. */
+#define BT_UUID_BULK_TX_VAL BT_UUID_128_ENCODE(0x00001601, 0x1212, 0xefde, 0x1523, 0x785feabcd123)
+
+/** @brief RX Characteristic UUID, written by the central. */
+#define BT_UUID_BULK_RX_VAL BT_UUID_128_ENCODE(0x00001602, 0x1212, 0xefde, 0x1523, 0x785feabcd123)
+
+/** @brief RX Count Characteristic UUID, bytes received since the
+ *  connection was established as a little-endian uint32.
+ */
+#define BT_UUID_BULK_RX_COUNT_VAL                                                                  \
+	BT_UUID_128_ENCODE(0x00001603, 0x1212, 0xefde, 0x1523, 0x785feabcd123)
+
+#define BT_UUID_BULK BT_UUID_DECLARE_128(BT_UUID_BULK_VAL)
+#define BT_UUID_BULK_TX BT_UUID_DECLARE_128(BT_UUID_BULK_TX_VAL)
+#define BT_UUID_BULK_RX BT_UUID_DECLARE_128(BT_UUID_BULK_RX_VAL)
+#define BT_UUID_BULK_RX_COUNT BT_UUID_DECLARE_128(BT_UUID_BULK_RX_COUNT_VAL)
+
+/** @brief Callback type for when data has been sent or received. */
+typedef void (*bulk_data_cb_t)(struct bt_conn *conn, size_t len);
+
+/** @brief Callback type for when a notification could not be queued. */
+typedef void (*bulk_failed_cb_t)(int err);
+
+/** @brief Callback type for when the bytes in flight have changed. */
+typedef void (*bulk_backlog_cb_t)(size_t bytes);
+
+/** @brief Callback struct used by the Bulk Service. */
+struct bulk_svc_cb {
+	/** Data sent callback, called from the Bluetooth TX context. */
+	bulk_data_cb_t sent_cb;
+	/** Data received callback, called from the Bluetooth RX thread. */
+	bulk_data_cb_t received_cb;
+	/** Notification failure callback. */
+	bulk_failed_cb_t failed_cb;
+	/** Bytes queued in the stack and not sent yet, called from the
+	 *  Bluetooth TX context and the bulk thread.
+	 */
+	bulk_backlog_cb_t backlog_cb;
+};
+
+/** @brief Initialize the Bulk Service.
+ *
+ * @param[in] callbacks Struct containing pointers to callback functions
+ *			used by the service. This pointer can be NULL
+ *			if no callback functions are defined.
+ *
+ * @retval 0 If the operation was successful.
+ *           Otherwise, a (negative) error code is returned.
+ */
+int bulk_svc_init(const struct bulk_svc_cb *callbacks);
+
+#ifdef __cplusplus
+}
+#endif
+
+/**
+ * @}
+ */
+
+#endif /* BULK_SVC_H_ */
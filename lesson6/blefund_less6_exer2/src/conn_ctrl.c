@@ -0,0 +1,270 @@
+/*
+ * Copyright (c) 2023 Nordic Semiconductor ASA
+ *
+ * SPDX-License-Identifier: LicenseRef-Nordic-5-Clause
+ */
+
+/** @file
+ *  @brief Connection interval controller
+ */
+
+#include <zephyr/types.h>
+#include <string.h>
+#include <zephyr/kernel.h>
+#include <zephyr/sys/atomic.h>
+#include <zephyr/bluetooth/bluetooth.h>
+#include <zephyr/bluetooth/conn.h>
+
+#include "conn_ctrl.h"
+#include "conn_time.h"
+
+#include <zephyr/logging/log.h>
+LOG_MODULE_REGISTER(conn_ctrl, LOG_LEVEL_INF);
+
+#define WINDOW_MS CONFIG_APP_CONN_CTRL_WINDOW_MS
+
+enum conn_mode {
+	MODE_IDLE,
+	MODE_BURST,
+
+	MODE_COUNT,
+};
+
+static const char *const mode_name[MODE_COUNT] = {
+	[MODE_IDLE] = "idle",
+	[MODE_BURST] = "burst",
+};
+
+static const struct bt_le_conn_param mode_param[MODE_COUNT] = {
+	[MODE_IDLE] = BT_LE_CONN_PARAM_INIT(CONFIG_APP_CONN_CTRL_IDLE_INTERVAL,
+					    CONFIG_APP_CONN_CTRL_IDLE_INTERVAL,
+					    CONFIG_APP_CONN_CTRL_IDLE_LATENCY,
+					    CONFIG_APP_CONN_CTRL_IDLE_TIMEOUT),
+	[MODE_BURST] = BT_LE_CONN_PARAM_INIT(CONFIG_APP_CONN_CTRL_BURST_INTERVAL_MIN,
+					     CONFIG_APP_CONN_CTRL_BURST_INTERVAL_MAX, 0,
+					     CONFIG_APP_CONN_CTRL_BURST_TIMEOUT),
+};
+
+BUILD_ASSERT(CONFIG_APP_CONN_CTRL_IDLE_TIMEOUT * 4 >
+		     (1 + CONFIG_APP_CONN_CTRL_IDLE_LATENCY) * CONFIG_APP_CONN_CTRL_IDLE_INTERVAL,
+	     "Idle supervision timeout too short for the interval and latency");
+
+/* Traffic of the current window, written from any context */
+static atomic_t notified;
+static atomic_t notified_bytes;
+static atomic_t backlog;
+
+/* Connection events, handed to the system workqueue */
+static atomic_ptr_t new_conn;
+static atomic_ptr_t gone_conn;
+static atomic_t new_params;
+
+/* Only written from the system workqueue */
+static struct bt_conn *ctrl_conn;
+static enum conn_mode mode;
+static int64_t quiet_since;
+static int64_t last_request;
+static uint16_t conn_interval;
+static uint16_t conn_latency;
+static int64_t mode_since;
+static uint64_t mode_time_ms[MODE_COUNT];
+static uint32_t requests;
+static uint32_t updates;
+
+/* Mode that the current connection parameters amount to */
+static enum conn_mode mode_of(uint16_t interval)
+{
+	return interval <= CONFIG_APP_CONN_CTRL_BURST_INTERVAL_MAX ? MODE_BURST : MODE_IDLE;
+}
+
+static bool params_match(enum conn_mode m)
+{
+	if (m == MODE_BURST) {
+		return conn_interval <= CONFIG_APP_CONN_CTRL_BURST_INTERVAL_MAX;
+	}
+
+	/* The central may turn down the latency, a long interval will do. */
+	return conn_interval >= CONFIG_APP_CONN_CTRL_IDLE_INTERVAL;
+}
+
+static void mode_account(int64_t now)
+{
+	if (ctrl_conn) {
+		mode_time_ms[mode_of(conn_interval)] += now - mode_since;
+	}
+
+	mode_since = now;
+}
+
+static void window_work_handler(struct k_work *work);
+
+static K_WORK_DELAYABLE_DEFINE(window_work, window_work_handler);
+
+static void window_work_handler(struct k_work *work)
+{
+	uint32_t count = atomic_clear(&notified);
+	uint32_t bytes = atomic_clear(&notified_bytes);
+	uint32_t queued = atomic_get(&backlog);
+	int64_t now = k_uptime_get();
+	int err;
+
+	if (!ctrl_conn) {
+		return;
+	}
+
+	/* Hysteresis: a burst starts above the burst thresholds, but only
+	 * ends after the traffic stayed below the idle thresholds for the
+	 * hold time.
+	 */
+	if (count >= CONFIG_APP_CONN_CTRL_BURST_NOTIFY ||
+	    queued >= CONFIG_APP_CONN_CTRL_BURST_BYTES) {
+		mode = MODE_BURST;
+		quiet_since = now;
+	} else if (count > CONFIG_APP_CONN_CTRL_IDLE_NOTIFY || queued > 0) {
+		quiet_since = now;
+	} else if (now - quiet_since >= CONFIG_APP_CONN_CTRL_IDLE_HOLD_MS) {
+		mode = MODE_IDLE;
+	}
+
+	if (!params_match(mode) &&
+	    now - last_request >= CONFIG_APP_CONN_CTRL_MIN_UPDATE_MS) {
+		LOG_INF("Requesting %s parameters (%u notifications, %u bytes in %u ms, %u queued)",
+			mode_name[mode], count, bytes, WINDOW_MS, queued);
+
+		last_request = now;
+		requests++;
+
+		err = bt_conn_le_param_update(ctrl_conn, &mode_param[mode]);
+		if (err) {
+			LOG_WRN("Connection parameter update failed (err %d)", err);
+		}
+	}
+
+	k_work_reschedule(&window_work, K_MSEC(WINDOW_MS));
+}
+
+static void connected_work_handler(struct k_work *work)
+{
+	struct bt_conn *conn = atomic_ptr_clear(&new_conn);
+	struct bt_conn_info info;
+	int64_t now = k_uptime_get();
+
+	if (!conn) {
+		return;
+	}
+
+	if (ctrl_conn || bt_conn_get_info(conn, &info)) {
+		bt_conn_unref(conn);
+		return;
+	}
+
+	ctrl_conn = conn;
+	conn_interval = info.le.interval;
+	conn_latency = info.le.latency;
+	mode = MODE_IDLE;
+	mode_since = now;
+	quiet_since = now;
+	/* Leave the central and the automatic update the first word. */
+	last_request = now;
+
+	atomic_clear(&notified);
+	atomic_clear(&notified_bytes);
+
+	k_work_reschedule(&window_work, K_MSEC(WINDOW_MS));
+}
+
+static K_WORK_DEFINE(connected_work, connected_work_handler);
+
+static void disconnected_work_handler(struct k_work *work)
+{
+	struct bt_conn *conn = atomic_ptr_clear(&gone_conn);
+
+	if (!conn || conn != ctrl_conn) {
+		return;
+	}
+
+	mode_account(k_uptime_get());
+	k_work_cancel_delayable(&window_work);
+	bt_conn_unref(ctrl_conn);
+	ctrl_conn = NULL;
+}
+
+static K_WORK_DEFINE(disconnected_work, disconnected_work_handler);
+
+static void params_work_handler(struct k_work *work)
+{
+	atomic_val_t params = atomic_get(&new_params);
+
+	if (!ctrl_conn) {
+		return;
+	}
+
+	mode_account(k_uptime_get());
+	conn_interval = params & 0xffff;
+	conn_latency = params >> 16;
+	updates++;
+}
+
+static K_WORK_DEFINE(params_work, params_work_handler);
+
+/* The sample allows a single connection. The callbacks run in the
+ * Bluetooth RX thread and hand over to the system workqueue.
+ */
+static void on_connected(struct bt_conn *conn, uint8_t err)
+{
+	if (err) {
+		return;
+	}
+
+	atomic_ptr_set(&new_conn, bt_conn_ref(conn));
+	k_work_submit(&connected_work);
+}
+
+static void on_disconnected(struct bt_conn *conn, uint8_t reason)
+{
+	atomic_ptr_set(&gone_conn, conn);
+	k_work_submit(&disconnected_work);
+}
+
+static void on_le_param_updated(struct bt_conn *conn, uint16_t interval, uint16_t latency,
+				uint16_t timeout)
+{
+	atomic_set(&new_params, interval | (latency << 16));
+	k_work_submit(&params_work);
+}
+
+BT_CONN_CB_DEFINE(conn_ctrl_conn_callbacks) = {
+	.connected = on_connected,
+	.disconnected = on_disconnected,
+	.le_param_updated = on_le_param_updated,
+};
+
+void conn_ctrl_notified(size_t len)
+{
+	atomic_inc(&notified);
+	atomic_add(&notified_bytes, len);
+}
+
+void conn_ctrl_backlog_set(size_t bytes)
+{
+	atomic_set(&backlog, bytes);
+}
+
+void conn_ctrl_report(void)
+{
+	uint64_t time_ms[MODE_COUNT];
+
+	memcpy(time_ms, mode_time_ms, sizeof(time_ms));
+	if (ctrl_conn) {
+		time_ms[mode_of(conn_interval)] += k_uptime_get() - mode_since;
+	}
+
+	LOG_INF("Connection interval: %u requests, %u updates, %u s short, %u s long",
+		requests, updates, (uint32_t)(time_ms[MODE_BURST] / MSEC_PER_SEC),
+		(uint32_t)(time_ms[MODE_IDLE] / MSEC_PER_SEC));
+
+	if (ctrl_conn) {
+		LOG_INF("Current interval " CONN_TIME_FMT ", latency %u",
+			CONN_TIME_ARGS(CONN_TIME_INTERVAL_US(conn_interval)), conn_latency);
+	}
+}
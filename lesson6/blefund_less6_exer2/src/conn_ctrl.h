@@ -0,0 +1,59 @@
+/*
+ * Copyright (c) 2023 Nordic Semiconductor ASA
+ *
+ * SPDX-License-Identifier: LicenseRef-Nordic-5-Clause
+ */
+
+#ifndef CONN_CTRL_H_
+#define CONN_CTRL_H_
+
+/**@file
+ * @defgroup conn_ctrl Connection interval controller
+ * @{
+ * @brief Connection parameters that follow the application traffic.
+ *
+ * The application reports the notifications it sends and the bytes it
+ * has waiting. Once per window the controller looks at the traffic. A
+ * burst asks the central for a short connection interval. Once the link
+ * has been quiet for a while, the controller asks for a long interval
+ * with peripheral latency. The thresholds to enter and leave a burst
+ * differ, and update requests are at least
+ * CONFIG_APP_CONN_CTRL_MIN_UPDATE_MS apart.
+ */
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <zephyr/types.h>
+
+/** @brief Count a notification sent by the application.
+ *
+ * Safe to call from any context.
+ *
+ * @param[in] len Length of the notification in bytes.
+ */
+void conn_ctrl_notified(size_t len);
+
+/** @brief Set the number of bytes the application has waiting to send.
+ *
+ * Safe to call from any context.
+ *
+ * @param[in] bytes Bytes queued in the application.
+ */
+void conn_ctrl_backlog_set(size_t bytes);
+
+/** @brief Log the update requests and the time spent with short and long
+ *  connection intervals.
+ */
+void conn_ctrl_report(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+/**
+ * @}
+ */
+
+#endif /* CONN_CTRL_H_ */
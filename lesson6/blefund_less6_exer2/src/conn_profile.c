@@ -0,0 +1,389 @@
+/*
+ * Copyright (c) 2023 Nordic Semiconductor ASA
+ *
+ * SPDX-License-Identifier: LicenseRef-Nordic-5-Clause
+ */
+
+/** @file
+ *  @brief Connection profiles
+ */
+
+#include <zephyr/types.h>
+#include <errno.h>
+#include <zephyr/kernel.h>
+#include <zephyr/sys/atomic.h>
+#include <zephyr/bluetooth/bluetooth.h>
+#include <zephyr/bluetooth/conn.h>
+#include <zephyr/bluetooth/uuid.h>
+#include <zephyr/bluetooth/gatt.h>
+
+#include "conn_profile.h"
+#include "gatt_chrc.h"
+#include "link_setup.h"
+
+#include <zephyr/logging/log.h>
+LOG_MODULE_REGISTER(conn_profile, LOG_LEVEL_INF);
+
+#define STEP_TIMEOUT_MS CONFIG_APP_CONN_PROFILE_STEP_TIMEOUT_MS
+#define PROFILE_NONE UINT8_MAX
+
+/* The PHY goes first because the time a packet takes on air depends on
+ * it, then the data length, and the interval last, when the shape of the
+ * link is known.
+ */
+enum profile_step {
+	STEP_PHY,
+	STEP_DATA_LEN,
+	STEP_CONN_PARAM,
+
+	STEP_COUNT,
+};
+
+static const char *const step_name[STEP_COUNT] = {
+	[STEP_PHY] = "PHY",
+	[STEP_DATA_LEN] = "data length",
+	[STEP_CONN_PARAM] = "connection parameter",
+};
+
+struct conn_profile {
+	const char *name;
+	struct bt_conn_le_phy_param phy;
+	struct bt_conn_le_data_len_param data_len;
+	struct bt_le_conn_param param;
+};
+
+#define PHY_PARAM(_phy)                                                                            \
+	{                                                                                          \
+		.options = BT_CONN_LE_PHY_OPT_NONE, .pref_tx_phy = (_phy), .pref_rx_phy = (_phy),  \
+	}
+
+#define DATA_LEN_PARAM(_len, _time)                                                                \
+	{                                                                                          \
+		.tx_max_len = (_len), .tx_max_time = (_time),                                      \
+	}
+
+static const struct conn_profile profiles[CONN_PROFILE_COUNT] = {
+	[CONN_PROFILE_BULK] = {
+		.name = "bulk-transfer",
+		.phy = PHY_PARAM(BT_GAP_LE_PHY_2M),
+		.data_len = DATA_LEN_PARAM(BT_GAP_DATA_LEN_MAX, BT_GAP_DATA_TIME_MAX),
+		.param = BT_LE_CONN_PARAM_INIT(40, 40, 0, 400),
+	},
+	[CONN_PROFILE_INTERACTIVE] = {
+		.name = "interactive",
+		.phy = PHY_PARAM(BT_GAP_LE_PHY_2M),
+		.data_len = DATA_LEN_PARAM(BT_GAP_DATA_LEN_DEFAULT, BT_GAP_DATA_TIME_DEFAULT),
+		.param = BT_LE_CONN_PARAM_INIT(6, 12, 0, 400),
+	},
+	[CONN_PROFILE_IDLE_SENSOR] = {
+		.name = "idle-sensor",
+		.phy = PHY_PARAM(BT_GAP_LE_PHY_1M),
+		.data_len = DATA_LEN_PARAM(BT_GAP_DATA_LEN_DEFAULT, BT_GAP_DATA_TIME_DEFAULT),
+		.param = BT_LE_CONN_PARAM_INIT(400, 400, 4, 600),
+	},
+	[CONN_PROFILE_FW_UPDATE] = {
+		.name = "firmware-update",
+		.phy = PHY_PARAM(BT_GAP_LE_PHY_2M),
+		.data_len = DATA_LEN_PARAM(BT_GAP_DATA_LEN_MAX, BT_GAP_DATA_TIME_MAX),
+		.param = BT_LE_CONN_PARAM_INIT(12, 24, 0, 400),
+	},
+};
+
+static struct bt_conn *prof_conn;
+static struct k_spinlock conn_lock;
+
+/* ID + 1 of the latest requested profile, 0 if none */
+static atomic_t requested;
+static atomic_t current_id = ATOMIC_INIT(PROFILE_NONE);
+/* Step + 1 of the procedure that was requested last, 0 once it completed */
+static atomic_t step_wait;
+/* Procedures that completed, a bit per enum profile_step */
+static atomic_t step_done;
+/* Procedures that completed other than requested, a bit per enum profile_step */
+static atomic_t step_mismatch;
+/* Set on disconnection, the profile being applied is dropped. */
+static atomic_t dropped;
+
+/* Only used from the system workqueue */
+static bool running;
+static enum conn_profile_id target;
+static enum profile_step step;
+static int64_t step_deadline;
+/* No event is also an outcome of the current step, see step_request() */
+static bool step_settles;
+static int64_t apply_start;
+static uint32_t failed;
+
+static int step_request(struct bt_conn *conn, enum profile_step s, const struct bt_conn_info *info,
+			uint32_t *wait_ms)
+{
+	const struct conn_profile *p = &profiles[target];
+
+	/* The controller only reports a change, so check for none. */
+	switch (s) {
+	case STEP_PHY:
+		if (info->le.phy->tx_phy == p->phy.pref_tx_phy &&
+		    info->le.phy->rx_phy == p->phy.pref_rx_phy) {
+			return -EALREADY;
+		}
+		return bt_conn_le_phy_update(conn, &p->phy);
+	case STEP_DATA_LEN:
+		if (info->le.data_len->tx_max_len == p->data_len.tx_max_len) {
+			return -EALREADY;
+		}
+		/* No event comes when the peer keeps the current length. */
+		*wait_ms = link_setup_data_len_settle_ms(info, STEP_TIMEOUT_MS);
+		return bt_conn_le_data_len_update(conn, &p->data_len);
+	case STEP_CONN_PARAM:
+		return bt_conn_le_param_update(conn, &p->param);
+	default:
+		return -EINVAL;
+	}
+}
+
+/* Start a step. Its completion only counts when it arrives after the
+ * request, so that procedures of other modules finishing meanwhile are
+ * not taken for it.
+ */
+static int step_start(struct bt_conn *conn, enum profile_step s, uint32_t *wait_ms)
+{
+	struct bt_conn_info info;
+	int err;
+
+	err = bt_conn_get_info(conn, &info);
+	if (err) {
+		return err;
+	}
+
+	*wait_ms = STEP_TIMEOUT_MS;
+	atomic_clear(&step_done);
+	atomic_clear(&step_mismatch);
+	atomic_set(&step_wait, s + 1);
+
+	err = step_request(conn, s, &info, wait_ms);
+	if (err) {
+		atomic_clear(&step_wait);
+	}
+
+	return err;
+}
+
+static void step_work_handler(struct k_work *work);
+
+static K_WORK_DELAYABLE_DEFINE(step_work, step_work_handler);
+
+static void step_work_handler(struct k_work *work)
+{
+	k_spinlock_key_t key = k_spin_lock(&conn_lock);
+	struct bt_conn *conn = prof_conn ? bt_conn_ref(prof_conn) : NULL;
+	int64_t now = k_uptime_get();
+	atomic_val_t id;
+	uint32_t wait_ms;
+	int err;
+
+	k_spin_unlock(&conn_lock, key);
+
+	if (atomic_clear(&dropped)) {
+		running = false;
+	}
+
+	if (!conn) {
+		return;
+	}
+
+	if (running) {
+		if (!atomic_test_bit(&step_done, step)) {
+			if (now < step_deadline) {
+				/* Woken by a request or another procedure. */
+				k_work_reschedule(&step_work, K_MSEC(step_deadline - now));
+				goto out;
+			}
+
+			atomic_clear(&step_wait);
+
+			if (step_settles) {
+				LOG_INF("%s: %s kept by the peer", profiles[target].name,
+					step_name[step]);
+			} else {
+				LOG_WRN("%s: %s update timed out", profiles[target].name,
+					step_name[step]);
+				failed |= BIT(step);
+			}
+		} else if (atomic_test_bit(&step_mismatch, step)) {
+			LOG_WRN("%s: %s update not as requested", profiles[target].name,
+				step_name[step]);
+			failed |= BIT(step);
+		}
+		step++;
+	} else {
+		id = atomic_clear(&requested);
+		if (!id) {
+			goto out;
+		}
+
+		target = id - 1;
+		running = true;
+		step = STEP_PHY;
+		failed = 0;
+		apply_start = now;
+		LOG_INF("Applying profile %s", profiles[target].name);
+	}
+
+	for (; step < STEP_COUNT; step++) {
+		err = step_start(conn, step, &wait_ms);
+		if (!err) {
+			step_settles = (step == STEP_DATA_LEN);
+			step_deadline = now + wait_ms;
+			k_work_reschedule(&step_work, K_MSEC(wait_ms));
+			goto out;
+		}
+
+		if (err != -EALREADY) {
+			LOG_WRN("%s: %s update failed (err %d)", profiles[target].name,
+				step_name[step], err);
+			failed |= BIT(step);
+		}
+	}
+
+	running = false;
+	atomic_set(&current_id, target);
+
+	if (failed) {
+		LOG_WRN("Profile %s partly applied in %u ms", profiles[target].name,
+			(uint32_t)(now - apply_start));
+	} else {
+		LOG_INF("Profile %s applied in %u ms", profiles[target].name,
+			(uint32_t)(now - apply_start));
+	}
+
+	/* Apply what was requested in the meantime. */
+	if (atomic_get(&requested)) {
+		k_work_reschedule(&step_work, K_NO_WAIT);
+	}
+
+out:
+	bt_conn_unref(conn);
+}
+
+static void profile_request(uint8_t id)
+{
+	atomic_set(&requested, id + 1);
+	k_work_reschedule(&step_work, K_NO_WAIT);
+}
+
+static inline uint8_t profile_read(void)
+{
+	return atomic_get(&current_id);
+}
+
+GATT_CHRC_WRITE_DEFINE(write_profile, uint8_t, 0, CONN_PROFILE_COUNT - 1, profile_request)
+GATT_CHRC_READ_DEFINE(read_profile, uint8_t, profile_read)
+
+/* Connection Profile Service Declaration */
+BT_GATT_SERVICE_DEFINE(conn_profile_svc, BT_GATT_PRIMARY_SERVICE(BT_UUID_CONN_PROFILE_SVC),
+		       BT_GATT_CHARACTERISTIC(BT_UUID_CONN_PROFILE,
+					      BT_GATT_CHRC_READ | BT_GATT_CHRC_WRITE,
+					      BT_GATT_PERM_READ | BT_GATT_PERM_WRITE, read_profile,
+					      write_profile, NULL), );
+
+static void step_completed(struct bt_conn *conn, enum profile_step s, bool match)
+{
+	if (conn != prof_conn || !atomic_cas(&step_wait, s + 1, 0)) {
+		return;
+	}
+
+	if (!match) {
+		atomic_set_bit(&step_mismatch, s);
+	}
+	atomic_set_bit(&step_done, s);
+	k_work_reschedule(&step_work, K_NO_WAIT);
+}
+
+static void on_connected(struct bt_conn *conn, uint8_t err)
+{
+	k_spinlock_key_t key;
+
+	if (err) {
+		return;
+	}
+
+	key = k_spin_lock(&conn_lock);
+	if (!prof_conn) {
+		prof_conn = bt_conn_ref(conn);
+	}
+	k_spin_unlock(&conn_lock, key);
+}
+
+static void on_disconnected(struct bt_conn *conn, uint8_t reason)
+{
+	k_spinlock_key_t key = k_spin_lock(&conn_lock);
+
+	if (conn != prof_conn) {
+		k_spin_unlock(&conn_lock, key);
+		return;
+	}
+
+	prof_conn = NULL;
+	k_spin_unlock(&conn_lock, key);
+
+	atomic_clear(&requested);
+	atomic_clear(&step_wait);
+	atomic_set(&current_id, PROFILE_NONE);
+	atomic_set(&dropped, 1);
+	k_work_reschedule(&step_work, K_NO_WAIT);
+	bt_conn_unref(conn);
+}
+
+/* The profile only changes while no step is waiting for its event. */
+static void on_le_param_updated(struct bt_conn *conn, uint16_t interval, uint16_t latency,
+				uint16_t timeout)
+{
+	const struct bt_le_conn_param *p = &profiles[target].param;
+
+	step_completed(conn, STEP_CONN_PARAM,
+		       interval >= p->interval_min && interval <= p->interval_max &&
+			       latency == p->latency && timeout == p->timeout);
+}
+
+static void on_le_phy_updated(struct bt_conn *conn, struct bt_conn_le_phy_info *param)
+{
+	const struct bt_conn_le_phy_param *p = &profiles[target].phy;
+
+	step_completed(conn, STEP_PHY,
+		       param->tx_phy == p->pref_tx_phy && param->rx_phy == p->pref_rx_phy);
+}
+
+static void on_le_data_len_updated(struct bt_conn *conn, struct bt_conn_le_data_len_info *info)
+{
+	/* The peer may take less than asked for, but not more. */
+	step_completed(conn, STEP_DATA_LEN,
+		       info->tx_max_len <= profiles[target].data_len.tx_max_len);
+}
+
+BT_CONN_CB_DEFINE(conn_profile_conn_callbacks) = {
+	.connected = on_connected,
+	.disconnected = on_disconnected,
+	.le_param_updated = on_le_param_updated,
+	.le_phy_updated = on_le_phy_updated,
+	.le_data_len_updated = on_le_data_len_updated,
+};
+
+int conn_profile_apply(struct bt_conn *conn, enum conn_profile_id id)
+{
+	if (id >= CONN_PROFILE_COUNT) {
+		return -EINVAL;
+	}
+
+	if (!conn || conn != prof_conn) {
+		return -ENOTCONN;
+	}
+
+	profile_request(id);
+
+	return 0;
+}
+
+const char *conn_profile_name(enum conn_profile_id id)
+{
+	return id < CONN_PROFILE_COUNT ? profiles[id].name : "unknown";
+}
@@ -0,0 +1,92 @@
+/*
+ * Copyright (c) 2023 Nordic Semiconductor ASA
+ *
+ * SPDX-License-Identifier: LicenseRef-Nordic-5-Clause
+ */
+
+#ifndef CONN_PROFILE_H_
+#define CONN_PROFILE_H_
+
+/**@file
+ * @defgroup conn_profile Connection profiles
+ * @{
+ * @brief Switch the connection between named workloads at runtime.
+ *
+ * A profile bundles the PHY, the data length and the connection
+ * parameters. Applying it runs the PHY update, the data length update and
+ * the connection parameter update one after the other, each waiting for
+ * the previous one to complete or time out. A profile requested while
+ * another one is being applied is applied right after it, and only the
+ * latest request is kept.
+ *
+ * The central can also switch profiles by writing the profile ID to the
+ * Connection Profile characteristic, and read the ID of the profile in
+ * use from it, 0xff until a profile has been applied.
+ */
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <zephyr/types.h>
+#include <zephyr/bluetooth/conn.h>
+#include <zephyr/bluetooth/uuid.h>
+
+/** @brief Connection Profile Service UUID. */
+#define BT_UUID_CONN_PROFILE_SVC_VAL                                                               \
+	BT_UUID_128_ENCODE(0x00001610, 0x1212, 0xefde, 0x1523, 0x785feabcd123)
+
+/** @brief Connection Profile Characteristic UUID. */
+#define BT_UUID_CONN_PROFILE_VAL                                                                   \
+	BT_UUID_128_ENCODE(0x00001611, 0x1212, 0xefde, 0x1523, 0x785feabcd123)
+
+#define BT_UUID_CONN_PROFILE_SVC BT_UUID_DECLARE_128(BT_UUID_CONN_PROFILE_SVC_VAL)
+#define BT_UUID_CONN_PROFILE BT_UUID_DECLARE_128(BT_UUID_CONN_PROFILE_VAL)
+
+/** @brief Connection profiles, the values are the IDs used over GATT. */
+enum conn_profile_id {
+	/** Long events on 2M with the largest packets. */
+	CONN_PROFILE_BULK,
+	/** Short interval, no latency, for user interaction. */
+	CONN_PROFILE_INTERACTIVE,
+	/** Long interval with latency on 1M, for occasional readings. */
+	CONN_PROFILE_IDLE_SENSOR,
+	/** Moderate interval on 2M with the largest packets, leaving room
+	 *  for flash writes between events.
+	 */
+	CONN_PROFILE_FW_UPDATE,
+
+	CONN_PROFILE_COUNT,
+};
+
+/** @brief Apply a profile to a connection.
+ *
+ * The procedures run from the system workqueue, so this can be called
+ * from any thread.
+ *
+ * @param[in] conn The connection.
+ * @param[in] id   The profile.
+ *
+ * @retval 0 If the profile was requested.
+ * @retval -EINVAL If the profile does not exist.
+ * @retval -ENOTCONN If the connection is not the one being managed.
+ */
+int conn_profile_apply(struct bt_conn *conn, enum conn_profile_id id);
+
+/** @brief Get the name of a profile.
+ *
+ * @param[in] id The profile.
+ *
+ * @return Name of the profile, or "unknown".
+ */
+const char *conn_profile_name(enum conn_profile_id id);
+
+#ifdef __cplusplus
+}
+#endif
+
+/**
+ * @}
+ */
+
+#endif /* CONN_PROFILE_H_ */
@@ -0,0 +1,44 @@
+/*
+ * Copyright (c) 2023 Nordic Semiconductor ASA
+ *
+ * SPDX-License-Identifier: LicenseRef-Nordic-5-Clause
+ */
+
+#ifndef CONN_RSSI_H_
+#define CONN_RSSI_H_
+
+/**@file
+ * @defgroup conn_rssi Connection RSSI
+ * @{
+ * @brief Read the RSSI of a connection from the controller.
+ */
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <zephyr/types.h>
+#include <zephyr/bluetooth/conn.h>
+
+/** @brief Read the RSSI of the last packets received on a connection.
+ *
+ * Sends a synchronous HCI command, so do not call it from the Bluetooth
+ * RX thread.
+ *
+ * @param[in] conn The connection.
+ * @param[out] rssi RSSI in dBm.
+ *
+ * @retval 0 If the operation was successful.
+ *           Otherwise, a (negative) error code is returned.
+ */
+int conn_rssi_read(struct bt_conn *conn, int8_t *rssi);
+
+#ifdef __cplusplus
+}
+#endif
+
+/**
+ * @}
+ */
+
+#endif /* CONN_RSSI_H_ */
@@ -0,0 +1,129 @@
+/*
+ * Copyright (c) 2023 Nordic Semiconductor ASA
+ *
+ * SPDX-License-Identifier: LicenseRef-Nordic-5-Clause
+ */
+
+/** @file
+ *  @brief Link chunk size
+ */
+
+#include <zephyr/types.h>
+#include <zephyr/kernel.h>
+#include <zephyr/sys/atomic.h>
+#include <zephyr/bluetooth/bluetooth.h>
+#include <zephyr/bluetooth/conn.h>
+#include <zephyr/bluetooth/gatt.h>
+
+#include "link_chunk.h"
+
+#include <zephyr/logging/log.h>
+LOG_MODULE_REGISTER(link_chunk, LOG_LEVEL_INF);
+
+/* ATT header of a notification or write without response */
+#define ATT_HDR_LEN 3
+
+/* Written from the Bluetooth RX thread, 0 while not connected */
+static atomic_t tx_len[CONFIG_BT_MAX_CONN];
+static atomic_t mtu[CONFIG_BT_MAX_CONN];
+
+static bool gatt_cb_registered;
+
+static uint16_t chunk_calc(uint16_t len, uint16_t att_mtu, uint16_t max)
+{
+	uint16_t limit = MIN(att_mtu - ATT_HDR_LEN, max);
+
+	/* Fits a single PDU */
+	if (limit + LINK_CHUNK_OVERHEAD <= len) {
+		return limit;
+	}
+
+	return (limit + LINK_CHUNK_OVERHEAD) / len * len - LINK_CHUNK_OVERHEAD;
+}
+
+static void chunk_log(struct bt_conn *conn)
+{
+	uint8_t i = bt_conn_index(conn);
+	uint16_t len = atomic_get(&tx_len[i]);
+	uint16_t att_mtu = atomic_get(&mtu[i]);
+
+	LOG_INF("Chunk %u bytes: data length %u, MTU %u",
+		chunk_calc(len, att_mtu, att_mtu - ATT_HDR_LEN), len, att_mtu);
+}
+
+static void on_att_mtu_updated(struct bt_conn *conn, uint16_t tx, uint16_t rx)
+{
+	atomic_set(&mtu[bt_conn_index(conn)], tx);
+	chunk_log(conn);
+}
+
+static struct bt_gatt_cb gatt_callbacks = {
+	.att_mtu_updated = on_att_mtu_updated,
+};
+
+static void on_connected(struct bt_conn *conn, uint8_t err)
+{
+	uint8_t i = bt_conn_index(conn);
+	struct bt_conn_info info;
+
+	if (err) {
+		return;
+	}
+
+	if (!gatt_cb_registered) {
+		bt_gatt_cb_register(&gatt_callbacks);
+		gatt_cb_registered = true;
+	}
+
+	/* Start from the defaults until the procedures complete. */
+	atomic_set(&tx_len[i], BT_GAP_DATA_LEN_DEFAULT);
+	if (!bt_conn_get_info(conn, &info)) {
+		atomic_set(&tx_len[i], info.le.data_len->tx_max_len);
+	}
+	atomic_set(&mtu[i], bt_gatt_get_mtu(conn));
+}
+
+static void on_disconnected(struct bt_conn *conn, uint8_t reason)
+{
+	uint8_t i = bt_conn_index(conn);
+
+	atomic_clear(&tx_len[i]);
+	atomic_clear(&mtu[i]);
+}
+
+static void on_le_data_len_updated(struct bt_conn *conn, struct bt_conn_le_data_len_info *info)
+{
+	atomic_set(&tx_len[bt_conn_index(conn)], info->tx_max_len);
+	chunk_log(conn);
+}
+
+BT_CONN_CB_DEFINE(link_chunk_conn_callbacks) = {
+	.connected = on_connected,
+	.disconnected = on_disconnected,
+	.le_data_len_updated = on_le_data_len_updated,
+};
+
+uint16_t link_chunk_size(struct bt_conn *conn, uint16_t max)
+{
+	uint16_t size = 0;
+
+	for (int i = 0; i < CONFIG_BT_MAX_CONN; i++) {
+		uint16_t len = atomic_get(&tx_len[i]);
+		uint16_t att_mtu = atomic_get(&mtu[i]);
+		uint16_t chunk;
+
+		if (conn && i != bt_conn_index(conn)) {
+			continue;
+		}
+
+		/* Not connected, or cleared by a disconnection meanwhile */
+		if (!len || att_mtu <= ATT_HDR_LEN) {
+			continue;
+		}
+
+		chunk = chunk_calc(len, att_mtu, max);
+		size = size ? MIN(size, chunk) : chunk;
+	}
+
+	return size;
+}
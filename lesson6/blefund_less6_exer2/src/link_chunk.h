@@ -0,0 +1,59 @@
+/*
+ * Copyright (c) 2023 Nordic Semiconductor ASA
+ *
+ * SPDX-License-Identifier: LicenseRef-Nordic-5-Clause
+ */
+
+#ifndef LINK_CHUNK_H_
+#define LINK_CHUNK_H_
+
+/**@file
+ * @defgroup link_chunk Link chunk size
+ * @{
+ * @brief Size application payloads to whole link layer PDUs.
+ *
+ * A notification or write without response of n bytes goes out as an
+ * L2CAP PDU of n + 7 bytes: 4 bytes of L2CAP header and 3 bytes of ATT
+ * header. The link layer splits it into PDUs of up to the negotiated
+ * maximum TX payload length. When the last of them is only partly
+ * filled, it still takes a packet slot in the connection event.
+ *
+ * The module caches the maximum TX payload length and the ATT MTU of
+ * every connection from the data length and MTU update callbacks, and
+ * returns the largest payload that fills all of its PDUs.
+ */
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <zephyr/types.h>
+#include <zephyr/bluetooth/conn.h>
+
+/** @brief L2CAP and ATT header bytes in front of a notification or write. */
+#define LINK_CHUNK_OVERHEAD 7
+
+/** @brief Get the payload size that fills whole link layer PDUs.
+ *
+ * Returns the largest size that is no larger than @p max and the
+ * ATT MTU allows, and, if the link layer has to split it, fills the
+ * last PDU completely.
+ *
+ * @param[in] conn The connection, or NULL for the smallest size of all
+ *                 connections, which suits notifications sent to all of
+ *                 them.
+ * @param[in] max Largest size the sender can use.
+ *
+ * @return Payload size in bytes, 0 if there is no connection.
+ */
+uint16_t link_chunk_size(struct bt_conn *conn, uint16_t max);
+
+#ifdef __cplusplus
+}
+#endif
+
+/**
+ * @}
+ */
+
+#endif /* LINK_CHUNK_H_ */
@@ -0,0 +1,324 @@
+/*
+ * Copyright (c) 2023 Nordic Semiconductor ASA
+ *
+ * SPDX-License-Identifier: LicenseRef-Nordic-5-Clause
+ */
+
+/** @file
+ *  @brief Link setup
+ */
+
+#include <zephyr/types.h>
+#include <errno.h>
+#include <string.h>
+#include <zephyr/kernel.h>
+#include <zephyr/sys/atomic.h>
+#include <zephyr/bluetooth/bluetooth.h>
+#include <zephyr/bluetooth/conn.h>
+#include <zephyr/bluetooth/gatt.h>
+
+#include "conn_time.h"
+#include "link_setup.h"
+
+#include <zephyr/logging/log.h>
+LOG_MODULE_REGISTER(link_setup, LOG_LEVEL_INF);
+
+#define LINK_EVENT_READY BIT(0)
+
+/* Connection events after which the data length procedure is over. The
+ * controller only reports a changed data length, so when the peer keeps
+ * the current one no event comes.
+ */
+#define DATA_LEN_SETTLE_EVENTS 12
+
+static const char *const proc_name[LINK_SETUP_PROC_COUNT] = {
+	[LINK_SETUP_PHY] = "PHY",
+	[LINK_SETUP_DATA_LEN] = "data length",
+	[LINK_SETUP_MTU] = "MTU",
+	[LINK_SETUP_CONN_PARAM] = "connection parameters",
+};
+
+static struct bt_conn *setup_conn;
+static int64_t setup_start;
+/* Procedures still running, a bit per enum link_setup_proc */
+static atomic_t pending;
+static atomic_t failed;
+static struct link_setup_result result;
+
+static K_EVENT_DEFINE(link_event);
+
+static struct bt_gatt_exchange_params exchange_params;
+static bool gatt_cb_registered;
+
+static void setup_finish(void)
+{
+	struct bt_conn *conn = setup_conn;
+	struct bt_conn_info info;
+
+	if (!conn) {
+		return;
+	}
+
+	result.setup_ms = k_uptime_get() - setup_start;
+	result.failed = atomic_get(&failed);
+	result.mtu = bt_gatt_get_mtu(conn);
+
+	if (!bt_conn_get_info(conn, &info)) {
+		result.tx_phy = info.le.phy->tx_phy;
+		result.tx_len = info.le.data_len->tx_max_len;
+	}
+
+	for (int proc = 0; proc < LINK_SETUP_PROC_COUNT; proc++) {
+		if (result.failed & BIT(proc)) {
+			LOG_WRN("Link setup: %s failed", proc_name[proc]);
+		}
+	}
+
+	LOG_INF("Link ready in %u ms: PHY %u, TX length %u bytes, MTU %u bytes", result.setup_ms,
+		result.tx_phy, result.tx_len, result.mtu);
+
+	k_event_post(&link_event, LINK_EVENT_READY);
+}
+
+static void proc_done(enum link_setup_proc proc, bool ok)
+{
+	atomic_val_t old;
+
+	if (!ok) {
+		atomic_set_bit(&failed, proc);
+	}
+
+	/* Exactly one caller clears the last pending bit. */
+	old = atomic_and(&pending, ~BIT(proc));
+	if (old == BIT(proc)) {
+		setup_finish();
+	}
+}
+
+static void timeout_work_handler(struct k_work *work)
+{
+	atomic_val_t left = atomic_get(&pending);
+
+	for (int proc = 0; proc < LINK_SETUP_PROC_COUNT; proc++) {
+		if (left & BIT(proc)) {
+			proc_done(proc, false);
+		}
+	}
+}
+
+static K_WORK_DELAYABLE_DEFINE(timeout_work, timeout_work_handler);
+
+static void data_len_work_handler(struct k_work *work)
+{
+	struct bt_conn_info info;
+
+	if (!setup_conn || !(atomic_get(&pending) & BIT(LINK_SETUP_DATA_LEN))) {
+		return;
+	}
+
+	if (!bt_conn_get_info(setup_conn, &info)) {
+		LOG_INF("Data length kept at %u bytes", info.le.data_len->tx_max_len);
+	}
+
+	proc_done(LINK_SETUP_DATA_LEN, true);
+}
+
+static K_WORK_DELAYABLE_DEFINE(data_len_work, data_len_work_handler);
+
+static void exchange_func(struct bt_conn *conn, uint8_t att_err,
+			  struct bt_gatt_exchange_params *params)
+{
+	proc_done(LINK_SETUP_MTU, att_err == 0);
+}
+
+static void phy_start(struct bt_conn *conn)
+{
+	const struct bt_conn_le_phy_param preferred_phy = {
+		.options = BT_CONN_LE_PHY_OPT_NONE,
+		.pref_rx_phy = BT_GAP_LE_PHY_2M,
+		.pref_tx_phy = BT_GAP_LE_PHY_2M,
+	};
+	int err;
+
+	err = bt_conn_le_phy_update(conn, &preferred_phy);
+	if (err) {
+		LOG_ERR("bt_conn_le_phy_update() returned %d", err);
+		proc_done(LINK_SETUP_PHY, false);
+	}
+}
+
+static void data_len_start(struct bt_conn *conn)
+{
+	const struct bt_conn_le_data_len_param data_len = {
+		.tx_max_len = BT_GAP_DATA_LEN_MAX,
+		.tx_max_time = BT_GAP_DATA_TIME_MAX,
+	};
+	uint32_t settle_ms = CONFIG_APP_LINK_SETUP_TIMEOUT_MS / 2;
+	struct bt_conn_info info;
+	int err;
+
+	if (!bt_conn_get_info(conn, &info)) {
+		/* The controller only reports a change, so check for none. */
+		if (info.le.data_len->tx_max_len == BT_GAP_DATA_LEN_MAX) {
+			proc_done(LINK_SETUP_DATA_LEN, true);
+			return;
+		}
+
+		settle_ms = link_setup_data_len_settle_ms(&info, settle_ms);
+	}
+
+	err = bt_conn_le_data_len_update(conn, &data_len);
+	if (err) {
+		LOG_ERR("data_len_update failed (err %d)", err);
+		proc_done(LINK_SETUP_DATA_LEN, false);
+		return;
+	}
+
+	/* Look again once the procedure is over, well within the timeout. */
+	k_work_schedule(&data_len_work, K_MSEC(settle_ms));
+}
+
+static void mtu_start(struct bt_conn *conn)
+{
+	int err;
+
+	exchange_params.func = exchange_func;
+
+	err = bt_gatt_exchange_mtu(conn, &exchange_params);
+	if (err == -EALREADY) {
+		/* The central exchanged the MTU first. */
+		proc_done(LINK_SETUP_MTU, true);
+	} else if (err) {
+		LOG_ERR("bt_gatt_exchange_mtu failed (err %d)", err);
+		proc_done(LINK_SETUP_MTU, false);
+	}
+}
+
+#if defined(CONFIG_APP_LINK_SETUP_CONN_PARAM)
+static void conn_param_start(struct bt_conn *conn)
+{
+	const struct bt_le_conn_param param = BT_LE_CONN_PARAM_INIT(
+		CONFIG_APP_LINK_SETUP_INTERVAL_MIN, CONFIG_APP_LINK_SETUP_INTERVAL_MAX, 0,
+		CONFIG_APP_LINK_SETUP_SUPERVISION_TIMEOUT);
+	int err;
+
+	err = bt_conn_le_param_update(conn, &param);
+	if (err == -EALREADY) {
+		proc_done(LINK_SETUP_CONN_PARAM, true);
+	} else if (err) {
+		LOG_ERR("bt_conn_le_param_update failed (err %d)", err);
+		proc_done(LINK_SETUP_CONN_PARAM, false);
+	}
+}
+#endif
+
+static void on_att_mtu_updated(struct bt_conn *conn, uint16_t tx, uint16_t rx)
+{
+	if (conn == setup_conn) {
+		proc_done(LINK_SETUP_MTU, true);
+	}
+}
+
+static struct bt_gatt_cb gatt_callbacks = {
+	.att_mtu_updated = on_att_mtu_updated,
+};
+
+int link_setup_start(struct bt_conn *conn)
+{
+	atomic_val_t procs = BIT(LINK_SETUP_PHY) | BIT(LINK_SETUP_DATA_LEN) | BIT(LINK_SETUP_MTU);
+
+	if (setup_conn) {
+		return -EBUSY;
+	}
+
+	if (!gatt_cb_registered) {
+		bt_gatt_cb_register(&gatt_callbacks);
+		gatt_cb_registered = true;
+	}
+
+	if (IS_ENABLED(CONFIG_APP_LINK_SETUP_CONN_PARAM)) {
+		procs |= BIT(LINK_SETUP_CONN_PARAM);
+	}
+
+	setup_conn = bt_conn_ref(conn);
+	setup_start = k_uptime_get();
+	memset(&result, 0, sizeof(result));
+	atomic_clear(&failed);
+	atomic_set(&pending, procs);
+	k_event_set(&link_event, 0);
+	k_work_schedule(&timeout_work, K_MSEC(CONFIG_APP_LINK_SETUP_TIMEOUT_MS));
+
+	/* The link layer runs one procedure at a time, but requesting all of
+	 * them now leaves no idle connection events between them.
+	 */
+	phy_start(conn);
+	data_len_start(conn);
+	mtu_start(conn);
+#if defined(CONFIG_APP_LINK_SETUP_CONN_PARAM)
+	conn_param_start(conn);
+#endif
+
+	return 0;
+}
+
+int link_setup_wait(k_timeout_t timeout, struct link_setup_result *out)
+{
+	if (!k_event_wait(&link_event, LINK_EVENT_READY, false, timeout)) {
+		return -EAGAIN;
+	}
+
+	if (out) {
+		*out = result;
+	}
+
+	return 0;
+}
+
+uint32_t link_setup_data_len_settle_ms(const struct bt_conn_info *info, uint32_t max_ms)
+{
+	return MIN(max_ms,
+		   CONN_TIME_INTERVAL_US(info->le.interval) * DATA_LEN_SETTLE_EVENTS / USEC_PER_MSEC);
+}
+
+static void on_disconnected(struct bt_conn *conn, uint8_t reason)
+{
+	if (conn != setup_conn) {
+		return;
+	}
+
+	k_work_cancel_delayable(&timeout_work);
+	k_work_cancel_delayable(&data_len_work);
+	atomic_clear(&pending);
+	k_event_set(&link_event, 0);
+	bt_conn_unref(setup_conn);
+	setup_conn = NULL;
+}
+
+static void on_le_param_updated(struct bt_conn *conn, uint16_t interval, uint16_t latency,
+				uint16_t timeout)
+{
+	if (conn == setup_conn) {
+		proc_done(LINK_SETUP_CONN_PARAM, true);
+	}
+}
+
+static void on_le_phy_updated(struct bt_conn *conn, struct bt_conn_le_phy_info *param)
+{
+	if (conn == setup_conn) {
+		proc_done(LINK_SETUP_PHY, true);
+	}
+}
+
+static void on_le_data_len_updated(struct bt_conn *conn, struct bt_conn_le_data_len_info *info)
+{
+	if (conn == setup_conn) {
+		proc_done(LINK_SETUP_DATA_LEN, true);
+	}
+}
+
+BT_CONN_CB_DEFINE(link_setup_conn_callbacks) = {
+	.disconnected = on_disconnected,
+	.le_param_updated = on_le_param_updated,
+	.le_phy_updated = on_le_phy_updated,
+	.le_data_len_updated = on_le_data_len_updated,
+};
@@ -0,0 +1,98 @@
+/*
+ * Copyright (c) 2023 Nordic Semiconductor ASA
+ *
+ * SPDX-License-Identifier: LicenseRef-Nordic-5-Clause
+ */
+
+#ifndef LINK_SETUP_H_
+#define LINK_SETUP_H_
+
+/**@file
+ * @defgroup link_setup Link setup
+ * @{
+ * @brief Negotiate the PHY, data length, ATT MTU and optionally the
+ *  connection parameters, and report when all of them are done.
+ *
+ * All procedures are started right after the connection is established
+ * and tracked until they complete, fail or time out. Then the link is
+ * ready: the result is logged with the total setup time and threads
+ * waiting in link_setup_wait() are released.
+ */
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <zephyr/types.h>
+#include <zephyr/kernel.h>
+#include <zephyr/bluetooth/conn.h>
+
+/** @brief Link setup procedures. */
+enum link_setup_proc {
+	LINK_SETUP_PHY,
+	LINK_SETUP_DATA_LEN,
+	LINK_SETUP_MTU,
+	LINK_SETUP_CONN_PARAM,
+
+	LINK_SETUP_PROC_COUNT,
+};
+
+/** @brief Outcome of the link setup. */
+struct link_setup_result {
+	/** Time from the start of the setup to the link being ready. */
+	uint32_t setup_ms;
+	/** Procedures that failed or timed out, a bit per
+	 *  enum link_setup_proc.
+	 */
+	uint32_t failed;
+	/** Negotiated TX PHY, BT_GAP_LE_PHY_*. */
+	uint8_t tx_phy;
+	/** Negotiated maximum TX payload length of the link layer. */
+	uint16_t tx_len;
+	/** Negotiated ATT MTU. */
+	uint16_t mtu;
+};
+
+/** @brief Start the link setup on a new connection.
+ *
+ * Call from the connected callback.
+ *
+ * @param[in] conn The connection.
+ *
+ * @retval 0 If the operation was successful.
+ * @retval -EBUSY If a setup is already running.
+ */
+int link_setup_start(struct bt_conn *conn);
+
+/** @brief Wait for the link to be ready for bulk transfer.
+ *
+ * @param[in] timeout Time to wait.
+ * @param[out] result Outcome of the setup, or NULL.
+ *
+ * @retval 0 If the link is ready.
+ * @retval -EAGAIN If the timeout expired first.
+ */
+int link_setup_wait(k_timeout_t timeout, struct link_setup_result *result);
+
+/** @brief Get the time after which a data length procedure is over.
+ *
+ * The controller only reports a changed data length, so when the peer
+ * keeps the current one no event comes. The procedure is over after a
+ * few connection events.
+ *
+ * @param[in] info Connection info.
+ * @param[in] max_ms Upper limit.
+ *
+ * @return Time to wait for the Data Length Change event, in milliseconds.
+ */
+uint32_t link_setup_data_len_settle_ms(const struct bt_conn_info *info, uint32_t max_ms);
+
+#ifdef __cplusplus
+}
+#endif
+
+/**
+ * @}
+ */
+
+#endif /* LINK_SETUP_H_ */
@@ -0,0 +1,320 @@
+/*
+ * Copyright (c) 2023 Nordic Semiconductor ASA
+ *
+ * SPDX-License-Identifier: LicenseRef-Nordic-5-Clause
+ */
+
+/** @file
+ *  @brief Link watch
+ */
+
+#include <zephyr/types.h>
+#include <errno.h>
+#include <zephyr/kernel.h>
+#include <zephyr/sys/atomic.h>
+#include <zephyr/bluetooth/bluetooth.h>
+#include <zephyr/bluetooth/conn.h>
+#include <zephyr/bluetooth/gatt.h>
+#include <zephyr/bluetooth/hci.h>
+#include <zephyr/bluetooth/uuid.h>
+
+#include "conn_time.h"
+#include "link_watch.h"
+
+#include <zephyr/logging/log.h>
+LOG_MODULE_REGISTER(link_watch, LOG_LEVEL_INF);
+
+#define PROBE_MS CONFIG_APP_LINK_WATCH_PROBE_MS
+#define RISK_EVENTS CONFIG_APP_LINK_WATCH_RISK_EVENTS
+#define RISK_TIMEOUT CONFIG_APP_LINK_WATCH_RISK_TIMEOUT
+
+/* The shorter timeout spans this many listened events, one more than the
+ * two the specification asks for.
+ */
+#define RISK_TIMEOUT_MIN_EVENTS 3
+
+static uint8_t probe_read_cb(struct bt_conn *conn, uint8_t err, struct bt_gatt_read_params *params,
+			     const void *data, uint16_t length);
+
+static struct bt_gatt_read_params probe_params = {
+	.func = probe_read_cb,
+	.handle_count = 0,
+	.by_uuid.start_handle = BT_ATT_FIRST_ATTRIBUTE_HANDLE,
+	.by_uuid.end_handle = BT_ATT_LAST_ATTRIBUTE_HANDLE,
+	.by_uuid.uuid = BT_UUID_GAP_DEVICE_NAME,
+};
+
+static struct bt_conn *watch_conn;
+static struct k_spinlock conn_lock;
+
+/* Uptime the outstanding probe was sent at, 0 if none */
+static atomic_t probe_sent;
+/* Round trip of the last probe plus one, 0 until it is answered */
+static atomic_t probe_rtt;
+/* Uptime the central was last heard from */
+static atomic_t last_heard;
+/* Reset on connection */
+static atomic_t at_risk;
+/* Supervision timeout to restore when the risk is over, 0 if none */
+static atomic_t saved_timeout;
+
+/* Risk threshold last logged, only used from the system workqueue */
+static uint32_t risk_ms_logged;
+
+/* Statistics, read without locking by the report */
+static uint32_t lost_at;
+static uint32_t lost_heard;
+static uint32_t losses;
+static uint32_t risks;
+static uint64_t outage_total_ms;
+static uint32_t outage_max_ms;
+
+static int timeout_request(struct bt_conn *conn, const struct bt_conn_info *info, uint16_t timeout)
+{
+	const struct bt_le_conn_param param = BT_LE_CONN_PARAM_INIT(
+		info->le.interval, info->le.interval, info->le.latency, timeout);
+
+	return bt_conn_le_param_update(conn, &param);
+}
+
+/* Time without an answer that puts the link at risk. Limited to half the
+ * supervision timeout, so that the shorter timeout can still act before
+ * the current one ends the link. 0 if the supervision timeout does not
+ * leave room to tell a lost link from a slow answer.
+ */
+static uint32_t risk_ms_get(const struct bt_conn_info *info, uint32_t event_ms)
+{
+	uint32_t timeout_ms = CONN_TIME_TIMEOUT_US(info->le.timeout) / USEC_PER_MSEC;
+	uint32_t risk_ms = MIN(RISK_EVENTS * event_ms, timeout_ms / 2);
+
+	/* A probe is answered one listened event later at best. */
+	if (risk_ms < 2 * event_ms) {
+		risk_ms = 0;
+	}
+
+	if (risk_ms != risk_ms_logged) {
+		if (!risk_ms) {
+			LOG_WRN("Supervision timeout %u ms is too short for early loss detection",
+				timeout_ms);
+		} else if (risk_ms < RISK_EVENTS * event_ms) {
+			LOG_INF("Link at risk after %u ms, limited by the %u ms timeout", risk_ms,
+				timeout_ms);
+		}
+		risk_ms_logged = risk_ms;
+	}
+
+	return risk_ms;
+}
+
+static void risk_enter(struct bt_conn *conn, const struct bt_conn_info *info, uint32_t waited_ms,
+		       uint32_t event_ms)
+{
+	uint32_t interval_us = CONN_TIME_INTERVAL_US(info->le.interval);
+	uint16_t timeout;
+	int err;
+
+	atomic_set(&at_risk, true);
+	risks++;
+
+	LOG_WRN("Link at risk: probe unanswered for %u ms, %u connection events", waited_ms,
+		waited_ms / event_ms);
+
+	if (RISK_TIMEOUT == 0) {
+		return;
+	}
+
+	/* The timeout must cover more than two intervals including the
+	 * latency, so shorten it as far as that allows.
+	 */
+	timeout = MAX(RISK_TIMEOUT,
+		      DIV_ROUND_UP((1 + info->le.latency) * interval_us * RISK_TIMEOUT_MIN_EVENTS,
+				   CONN_TIME_TIMEOUT_US(1)));
+	if (timeout >= info->le.timeout) {
+		return;
+	}
+
+	err = timeout_request(conn, info, timeout);
+	if (err) {
+		LOG_WRN("Supervision timeout update failed (err %d)", err);
+		return;
+	}
+
+	atomic_set(&saved_timeout, info->le.timeout);
+	LOG_INF("Supervision timeout %u ms requested", timeout * 10);
+}
+
+static void risk_leave(struct bt_conn *conn, const struct bt_conn_info *info, uint32_t rtt_ms)
+{
+	uint16_t timeout = atomic_clear(&saved_timeout);
+	int err;
+
+	atomic_set(&at_risk, false);
+	LOG_INF("Link recovered, probe answered in %u ms", rtt_ms);
+
+	if (timeout) {
+		err = timeout_request(conn, info, timeout);
+		if (err) {
+			LOG_WRN("Supervision timeout update failed (err %d)", err);
+		}
+	}
+}
+
+static void watch_work_handler(struct k_work *work);
+
+static K_WORK_DELAYABLE_DEFINE(watch_work, watch_work_handler);
+
+static void watch_work_handler(struct k_work *work)
+{
+	k_spinlock_key_t key = k_spin_lock(&conn_lock);
+	struct bt_conn *conn = watch_conn ? bt_conn_ref(watch_conn) : NULL;
+	/* The callback sets the round trip before it clears the probe. */
+	uint32_t sent = atomic_get(&probe_sent);
+	uint32_t rtt = atomic_clear(&probe_rtt);
+	uint32_t now = k_uptime_get_32();
+	struct bt_conn_info info;
+	uint32_t event_ms;
+	uint32_t risk_ms;
+	int err;
+
+	k_spin_unlock(&conn_lock, key);
+
+	if (!conn) {
+		return;
+	}
+
+	if (bt_conn_get_info(conn, &info)) {
+		goto out;
+	}
+
+	/* Time between the events the peripheral listens to */
+	event_ms = MAX(CONN_TIME_INTERVAL_US(info.le.interval) * (1 + info.le.latency) /
+			       USEC_PER_MSEC,
+		       1);
+	risk_ms = risk_ms_get(&info, event_ms);
+
+	if (rtt) {
+		rtt--;
+		if (atomic_get(&at_risk) && (!risk_ms || rtt < risk_ms)) {
+			risk_leave(conn, &info, rtt);
+		}
+
+		k_work_reschedule(&watch_work, K_MSEC(PROBE_MS));
+	} else if (sent) {
+		if (!atomic_get(&at_risk) && risk_ms && now - sent >= risk_ms) {
+			risk_enter(conn, &info, now - sent, event_ms);
+		}
+
+		/* Keep waiting, the supervision timeout ends it. */
+		k_work_reschedule(&watch_work, K_MSEC(PROBE_MS));
+	} else {
+		atomic_set(&probe_sent, now);
+
+		err = bt_gatt_read(conn, &probe_params);
+		if (err) {
+			atomic_clear(&probe_sent);
+			LOG_WRN("Probe failed (err %d)", err);
+			k_work_reschedule(&watch_work, K_MSEC(PROBE_MS));
+		} else {
+			k_work_reschedule(&watch_work, K_MSEC(risk_ms ? risk_ms : PROBE_MS));
+		}
+	}
+
+out:
+	bt_conn_unref(conn);
+}
+
+static uint8_t probe_read_cb(struct bt_conn *conn, uint8_t err, struct bt_gatt_read_params *params,
+			     const void *data, uint16_t length)
+{
+	uint32_t now = k_uptime_get_32();
+	uint32_t sent;
+
+	if (conn != watch_conn) {
+		return BT_GATT_ITER_STOP;
+	}
+
+	/* Any answer, an error response too, means the central is there. */
+	sent = atomic_get(&probe_sent);
+	if (sent) {
+		atomic_set(&probe_rtt, now - sent + 1);
+		atomic_set(&last_heard, now);
+		atomic_clear(&probe_sent);
+		k_work_reschedule(&watch_work, K_NO_WAIT);
+	}
+
+	return BT_GATT_ITER_STOP;
+}
+
+static void on_connected(struct bt_conn *conn, uint8_t err)
+{
+	uint32_t now = k_uptime_get_32();
+	k_spinlock_key_t key;
+
+	if (err) {
+		return;
+	}
+
+	key = k_spin_lock(&conn_lock);
+	if (watch_conn) {
+		k_spin_unlock(&conn_lock, key);
+		return;
+	}
+	watch_conn = bt_conn_ref(conn);
+	k_spin_unlock(&conn_lock, key);
+
+	atomic_clear(&probe_sent);
+	atomic_clear(&probe_rtt);
+	atomic_clear(&at_risk);
+	atomic_clear(&saved_timeout);
+	atomic_set(&last_heard, now);
+	risk_ms_logged = UINT32_MAX;
+
+	if (lost_at) {
+		uint32_t outage_ms = now - lost_heard;
+
+		LOG_INF("Reconnected %u ms after the link was lost, %u ms after it was last heard",
+			now - lost_at, outage_ms);
+
+		losses++;
+		outage_total_ms += outage_ms;
+		outage_max_ms = MAX(outage_max_ms, outage_ms);
+		lost_at = 0;
+	}
+
+	k_work_reschedule(&watch_work, K_MSEC(PROBE_MS));
+}
+
+static void on_disconnected(struct bt_conn *conn, uint8_t reason)
+{
+	uint32_t now = k_uptime_get_32();
+	k_spinlock_key_t key = k_spin_lock(&conn_lock);
+
+	if (conn != watch_conn) {
+		k_spin_unlock(&conn_lock, key);
+		return;
+	}
+
+	watch_conn = NULL;
+	k_spin_unlock(&conn_lock, key);
+
+	if (reason == BT_HCI_ERR_CONN_TIMEOUT) {
+		lost_at = now;
+		lost_heard = atomic_get(&last_heard);
+		LOG_WRN("Link lost, last heard %u ms ago%s", now - lost_heard,
+			atomic_get(&at_risk) ? ", was at risk" : "");
+	}
+
+	k_work_cancel_delayable(&watch_work);
+	bt_conn_unref(conn);
+}
+
+BT_CONN_CB_DEFINE(link_watch_conn_callbacks) = {
+	.connected = on_connected,
+	.disconnected = on_disconnected,
+};
+
+void link_watch_report(void)
+{
+	LOG_INF("Link watch: %u times at risk, %u links lost, outage %u ms avg, %u ms max", risks,
+		losses, losses ? (uint32_t)(outage_total_ms / losses) : 0, outage_max_ms);
+}
@@ -0,0 +1,46 @@
+/*
+ * Copyright (c) 2023 Nordic Semiconductor ASA
+ *
+ * SPDX-License-Identifier: LicenseRef-Nordic-5-Clause
+ */
+
+#ifndef LINK_WATCH_H_
+#define LINK_WATCH_H_
+
+/**@file
+ * @defgroup link_watch Link watch
+ * @{
+ * @brief Detect a failing link early and measure the time to reconnect.
+ *
+ * The link layer only reports a lost link when the supervision timeout
+ * expires. The watch sends a keepalive probe every
+ * CONFIG_APP_LINK_WATCH_PROBE_MS: a GATT read of the Device Name of the
+ * central, which every central answers. The round trip takes one or two
+ * connection events on a good link. A probe that is still unanswered after
+ * CONFIG_APP_LINK_WATCH_RISK_EVENTS connection events puts the link at
+ * risk. The watch then asks for a shorter supervision timeout, so that a
+ * lost link is detected sooner, and restores the timeout when the probes
+ * come back in time.
+ *
+ * After a supervision timeout, the time from the last probe answered to
+ * the next connection is reported as the outage.
+ */
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <zephyr/types.h>
+
+/** @brief Log the number of links lost and the outage times. */
+void link_watch_report(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+/**
+ * @}
+ */
+
+#endif /* LINK_WATCH_H_ */
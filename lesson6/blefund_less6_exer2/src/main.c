@@ -6,6 +6,7 @@
 
 #include <zephyr/kernel.h>
 #include <zephyr/logging/log.h>
+#include <zephyr/sys/atomic.h>
 #include <zephyr/bluetooth/bluetooth.h>
 #include <zephyr/bluetooth/gap.h>
 #include <zephyr/bluetooth/gatt.h>
@@ -16,28 +17,30 @@
 
 #include <dk_buttons_and_leds.h>
 
-static struct bt_le_adv_param *adv_param = BT_LE_ADV_PARAM(
-	(BT_LE_ADV_OPT_CONNECTABLE |
-	 BT_LE_ADV_OPT_USE_IDENTITY), /* Connectable advertising and use identity address */
-	BT_GAP_ADV_FAST_INT_MIN_1, /* 0x30 units, 48 units, 30ms */
-	BT_GAP_ADV_FAST_INT_MAX_1, /* 0x60 units, 96 units, 60ms */
-	NULL); /* Set to NULL for undirected advertising */
+#include "adv_sched.h"
+#include "bulk_svc.h"
+#include "conn_ctrl.h"
+#include "conn_profile.h"
+#include "conn_time.h"
+#include "link_setup.h"
+#include "link_watch.h"
+#include "phy_policy.h"
+#include "telemetry.h"
+#include "tput_profile.h"
 
 LOG_MODULE_REGISTER(Lesson3_Exercise2, LOG_LEVEL_INF);
 struct bt_conn *my_conn = NULL;
 
-static struct bt_gatt_exchange_params exchange_params;
-
-static void exchange_func(struct bt_conn *conn, uint8_t att_err,
-			  struct bt_gatt_exchange_params *params);
-
 #define DEVICE_NAME CONFIG_BT_DEVICE_NAME
 #define DEVICE_NAME_LEN (sizeof(DEVICE_NAME) - 1)
 
 #define USER_BUTTON DK_BTN1_MSK
+#define PROFILE_BUTTON DK_BTN2_MSK
 #define RUN_STATUS_LED DK_LED1
 #define CONNECTION_STATUS_LED DK_LED2
 #define RUN_LED_BLINK_INTERVAL 1000
+/* Report the advertising energy model every 60 blinks */
+#define ADV_REPORT_BLINKS 60
 
 static const struct bt_data ad[] = {
 	BT_DATA_BYTES(BT_DATA_FLAGS, (BT_LE_AD_GENERAL | BT_LE_AD_NO_BREDR)),
@@ -49,41 +52,16 @@ static const struct bt_data sd[] = {
 		      BT_UUID_128_ENCODE(0x00001523, 0x1212, 0xefde, 0x1523, 0x785feabcd123)),
 };
 
-static void update_phy(struct bt_conn *conn)
-{
-	int err;
-	const struct bt_conn_le_phy_param preferred_phy = {
-		.options = BT_CONN_LE_PHY_OPT_NONE,
-		.pref_rx_phy = BT_GAP_LE_PHY_2M,
-		.pref_tx_phy = BT_GAP_LE_PHY_2M,
-	};
-	err = bt_conn_le_phy_update(conn, &preferred_phy);
-	if (err) {
-		LOG_ERR("bt_conn_le_phy_update() returned %d", err);
-	}
-}
+/* Set while a button notification is queued, written from any context */
+static atomic_t lbs_pending;
+/* Bytes the bulk service has queued */
+static atomic_t bulk_backlog;
 
-static void update_data_length(struct bt_conn *conn)
+static void app_backlog_update(void)
 {
-	int err;
-	struct bt_conn_le_data_len_param my_data_len = {
-		.tx_max_len = BT_GAP_DATA_LEN_MAX,
-		.tx_max_time = BT_GAP_DATA_TIME_MAX,
-	};
-	err = bt_conn_le_data_len_update(my_conn, &my_data_len);
-	if (err) {
-		LOG_ERR("data_len_update failed (err %d)", err);
-	}
-}
-
-static void update_mtu(struct bt_conn *conn)
-{
-	int err;
-	exchange_params.func = exchange_func;
-
-	err = bt_gatt_exchange_mtu(conn, &exchange_params);
-	if (err) {
-		LOG_ERR("bt_gatt_exchange_mtu failed (err %d)", err);
+	if (IS_ENABLED(CONFIG_APP_CONN_CTRL)) {
+		conn_ctrl_backlog_set(atomic_get(&bulk_backlog) +
+				      (atomic_get(&lbs_pending) ? sizeof(bool) : 0));
 	}
 }
 
@@ -103,14 +81,20 @@ void on_connected(struct bt_conn *conn, uint8_t err)
 		LOG_ERR("bt_conn_get_info() returned %d", err);
 		return;
 	}
-	double connection_interval = info.le.interval * 1.25; // in ms
+	uint32_t connection_interval = CONN_TIME_INTERVAL_US(info.le.interval);
 	uint16_t supervision_timeout = info.le.timeout * 10; // in ms
-	LOG_INF("Connection parameters: interval %.2f ms, latency %d intervals, timeout %d ms",
-		connection_interval, info.le.latency, supervision_timeout);
+	LOG_INF("Connection parameters: interval " CONN_TIME_FMT
+		", latency %d intervals, timeout %d ms",
+		CONN_TIME_ARGS(connection_interval), info.le.latency, supervision_timeout);
+
+	/* Update the PHY, data length and MTU, and track them until done */
+	if (link_setup_start(my_conn)) {
+		LOG_ERR("Link setup already running");
+	}
 
-	update_phy(my_conn);
-	update_data_length(my_conn);
-	update_mtu(my_conn);
+	if (IS_ENABLED(CONFIG_APP_TPUT_PROFILE) && tput_profile_apply(my_conn)) {
+		LOG_WRN("Throughput connection parameters not requested");
+	}
 }
 
 void on_disconnected(struct bt_conn *conn, uint8_t reason)
@@ -118,15 +102,19 @@ void on_disconnected(struct bt_conn *conn, uint8_t reason)
 	LOG_INF("Disconnected. Reason %d", reason);
 	dk_set_led(CONNECTION_STATUS_LED, 0);
 	bt_conn_unref(my_conn);
+	my_conn = NULL;
+	atomic_clear(&lbs_pending);
+	app_backlog_update();
 }
 
 void on_le_param_updated(struct bt_conn *conn, uint16_t interval, uint16_t latency,
 			 uint16_t timeout)
 {
-	double connection_interval = interval * 1.25; // in ms
+	uint32_t connection_interval = CONN_TIME_INTERVAL_US(interval);
 	uint16_t supervision_timeout = timeout * 10; // in ms
-	LOG_INF("Connection parameters updated: interval %.2f ms, latency %d intervals, timeout %d ms",
-		connection_interval, latency, supervision_timeout);
+	LOG_INF("Connection parameters updated: interval " CONN_TIME_FMT
+		", latency %d intervals, timeout %d ms",
+		CONN_TIME_ARGS(connection_interval), latency, supervision_timeout);
 }
 
 void on_le_phy_updated(struct bt_conn *conn, struct bt_conn_le_phy_info *param)
@@ -159,15 +147,88 @@ struct bt_conn_cb connection_callbacks = {
 	.le_data_len_updated = on_le_data_len_updated,
 };
 
-static void exchange_func(struct bt_conn *conn, uint8_t att_err,
-			  struct bt_gatt_exchange_params *params)
+/* Let the connection modules know about the application traffic */
+static void app_data_sent(struct bt_conn *conn, size_t len)
+{
+	if (IS_ENABLED(CONFIG_APP_CONN_CTRL)) {
+		conn_ctrl_notified(len);
+	}
+	if (IS_ENABLED(CONFIG_APP_PHY_POLICY)) {
+		phy_policy_sent(len);
+	}
+	if (IS_ENABLED(CONFIG_APP_TELEMETRY)) {
+		telemetry_tx(conn, len);
+	}
+}
+
+static void app_data_received(struct bt_conn *conn, size_t len)
+{
+	if (IS_ENABLED(CONFIG_APP_TELEMETRY)) {
+		telemetry_rx(conn, len);
+	}
+}
+
+static void app_backlog_changed(size_t bytes)
+{
+	atomic_set(&bulk_backlog, bytes);
+	app_backlog_update();
+}
+
+static void app_notify_failed(int err)
+{
+	/* Notifications disabled by the central is not a link problem. */
+	if (IS_ENABLED(CONFIG_APP_TELEMETRY) && err != -EACCES) {
+		telemetry_tx_failed(NULL);
+	}
+}
+
+static enum conn_profile_id app_profile = CONN_PROFILE_COUNT - 1;
+
+static struct bulk_svc_cb bulk_callbacks = {
+	.sent_cb = app_data_sent,
+	.received_cb = app_data_received,
+	.failed_cb = app_notify_failed,
+	.backlog_cb = app_backlog_changed,
+};
+
+static void lbs_notify_sent(struct bt_conn *conn, void *user_data)
 {
-	LOG_INF("MTU exchange %s", att_err == 0 ? "successful" : "failed");
-	if (!att_err) {
-		uint16_t payload_mtu =
-			bt_gatt_get_mtu(conn) - 3; // 3 bytes used for Attribute headers.
-		LOG_INF("New MTU: %d bytes", payload_mtu);
+	atomic_clear(&lbs_pending);
+	app_backlog_update();
+}
+
+/* Same as bt_lbs_send_button_state(), but with a completion callback, so
+ * that the interval controller sees the notification until it is sent.
+ */
+static int lbs_button_notify(bool button_state)
+{
+	static const struct bt_gatt_attr *attr;
+	struct bt_gatt_notify_params params = {
+		.data = &button_state,
+		.len = sizeof(button_state),
+		.func = lbs_notify_sent,
+	};
+	int err;
+
+	if (!attr) {
+		attr = bt_gatt_find_by_uuid(NULL, 0, BT_UUID_LBS_BUTTON);
+	}
+
+	if (!my_conn || !attr || !bt_gatt_is_subscribed(my_conn, attr, BT_GATT_CCC_NOTIFY)) {
+		return -EACCES;
+	}
+
+	params.attr = attr;
+	atomic_set(&lbs_pending, true);
+	app_backlog_update();
+
+	err = bt_gatt_notify_cb(my_conn, &params);
+	if (err) {
+		atomic_clear(&lbs_pending);
+		app_backlog_update();
 	}
+
+	return err;
 }
 
 static void button_changed(uint32_t button_state, uint32_t has_changed)
@@ -175,9 +236,23 @@ static void button_changed(uint32_t button_state, uint32_t has_changed)
 	int err;
 	if (has_changed & USER_BUTTON) {
 		LOG_INF("Button changed");
-		err = bt_lbs_send_button_state(button_state ? true : false);
+		/* A local user is a hint that a central will connect soon. */
+		adv_sched_kick();
+		err = lbs_button_notify(button_state ? true : false);
 		if (err) {
 			LOG_ERR("Couldn't send notification. err: %d", err);
+			app_notify_failed(err);
+		} else if (my_conn) {
+			app_data_sent(my_conn, sizeof(bool));
+		}
+	}
+	if (IS_ENABLED(CONFIG_APP_CONN_PROFILE) && (has_changed & button_state & PROFILE_BUTTON) &&
+	    my_conn) {
+		app_profile = (app_profile + 1) % CONN_PROFILE_COUNT;
+		LOG_INF("Switching to profile %s", conn_profile_name(app_profile));
+		err = conn_profile_apply(my_conn, app_profile);
+		if (err) {
+			LOG_ERR("Couldn't apply profile. err: %d", err);
 		}
 	}
 }
@@ -221,7 +296,26 @@ void main(void)
 
 	bt_conn_cb_register(&connection_callbacks);
 	LOG_INF("Bluetooth initialized");
-	err = bt_le_adv_start(adv_param, ad, ARRAY_SIZE(ad), sd, ARRAY_SIZE(sd));
+
+	if (IS_ENABLED(CONFIG_APP_TPUT_PROFILE)) {
+		err = tput_profile_init();
+		if (err == -ENOTSUP) {
+			LOG_INF("Using the controller default event length");
+		} else if (err) {
+			LOG_ERR("Throughput profile failed (err %d)", err);
+			return;
+		}
+	}
+
+	if (IS_ENABLED(CONFIG_APP_BULK_SVC)) {
+		err = bulk_svc_init(&bulk_callbacks);
+		if (err) {
+			LOG_ERR("Failed to init bulk service (err %d)", err);
+			return;
+		}
+	}
+
+	err = adv_sched_start(ad, ARRAY_SIZE(ad), sd, ARRAY_SIZE(sd));
 	if (err) {
 		LOG_ERR("Advertising failed to start (err %d)", err);
 		return;
@@ -231,6 +325,15 @@ void main(void)
 
 	for (;;) {
 		dk_set_led(RUN_STATUS_LED, (++blink_status) % 2);
+		if (blink_status % ADV_REPORT_BLINKS == 0) {
+			adv_sched_report();
+			if (IS_ENABLED(CONFIG_APP_CONN_CTRL)) {
+				conn_ctrl_report();
+			}
+			if (IS_ENABLED(CONFIG_APP_LINK_WATCH)) {
+				link_watch_report();
+			}
+		}
 		k_sleep(K_MSEC(RUN_LED_BLINK_INTERVAL));
 	}
 }
@@ -0,0 +1,237 @@
+/*
+ * Copyright (c) 2023 Nordic Semiconductor ASA
+ *
+ * SPDX-License-Identifier: LicenseRef-Nordic-5-Clause
+ */
+
+/** @file
+ *  @brief PHY policy
+ */
+
+#include <zephyr/types.h>
+#include <errno.h>
+#include <zephyr/kernel.h>
+#include <zephyr/sys/atomic.h>
+#include <zephyr/bluetooth/bluetooth.h>
+#include <zephyr/bluetooth/conn.h>
+
+#include "conn_rssi.h"
+#include "phy_policy.h"
+
+#include <zephyr/logging/log.h>
+LOG_MODULE_REGISTER(phy_policy, LOG_LEVEL_INF);
+
+#define PERIOD_MS CONFIG_APP_PHY_POLICY_PERIOD_MS
+#define HYSTERESIS CONFIG_APP_PHY_POLICY_HYSTERESIS
+/* The smoothed RSSI is kept in quarter dB. */
+#define RSSI_SCALE 4
+
+/* From the fastest to the most robust */
+enum phy_level {
+	PHY_2M,
+	PHY_1M,
+	PHY_CODED_S2,
+	PHY_CODED_S8,
+
+	PHY_LEVEL_COUNT,
+};
+
+struct phy_desc {
+	const char *name;
+	struct bt_conn_le_phy_param param;
+	/* Lowest smoothed RSSI to stay on this PHY */
+	int8_t min_rssi;
+};
+
+#define PHY_PARAM(_options, _phy)                                                                  \
+	{                                                                                          \
+		.options = (_options), .pref_tx_phy = (_phy), .pref_rx_phy = (_phy),               \
+	}
+
+static const struct phy_desc phys[PHY_LEVEL_COUNT] = {
+	[PHY_2M] = { "2M", PHY_PARAM(BT_CONN_LE_PHY_OPT_NONE, BT_GAP_LE_PHY_2M),
+		     CONFIG_APP_PHY_POLICY_2M_MIN_RSSI },
+	[PHY_1M] = { "1M", PHY_PARAM(BT_CONN_LE_PHY_OPT_NONE, BT_GAP_LE_PHY_1M),
+		     CONFIG_APP_PHY_POLICY_1M_MIN_RSSI },
+	[PHY_CODED_S2] = { "Coded S2", PHY_PARAM(BT_CONN_LE_PHY_OPT_CODED_S2, BT_GAP_LE_PHY_CODED),
+			   CONFIG_APP_PHY_POLICY_S2_MIN_RSSI },
+	[PHY_CODED_S8] = { "Coded S8", PHY_PARAM(BT_CONN_LE_PHY_OPT_CODED_S8, BT_GAP_LE_PHY_CODED),
+			   INT8_MIN },
+};
+
+static struct bt_conn *policy_conn;
+static struct k_spinlock conn_lock;
+
+/* PHY in use as reported by the controller, an enum phy_level */
+static atomic_t level;
+/* Coded level of the pending switch to Coded, S8 if there is none */
+static atomic_t coded_next;
+
+/* Reset on connection, then only used from the system workqueue */
+static int32_t rssi_avg;
+static bool rssi_valid;
+static int64_t last_switch;
+
+static atomic_t sent_bytes;
+static atomic_t phy_since;
+
+static enum phy_level level_pick(enum phy_level current, int32_t rssi)
+{
+	enum phy_level next = current;
+
+	/* One step at a time, so the smoothed RSSI can follow. */
+	if (next < PHY_CODED_S8 && rssi < phys[next].min_rssi * RSSI_SCALE) {
+		next++;
+	} else if (next > PHY_2M &&
+		   rssi >= (phys[next - 1].min_rssi + HYSTERESIS) * RSSI_SCALE) {
+		next--;
+	}
+
+	if (!IS_ENABLED(CONFIG_APP_PHY_POLICY_CODED) && next > PHY_1M) {
+		next = PHY_1M;
+	}
+
+	return next;
+}
+
+static void sample_work_handler(struct k_work *work);
+
+static K_WORK_DELAYABLE_DEFINE(sample_work, sample_work_handler);
+
+static void sample_work_handler(struct k_work *work)
+{
+	k_spinlock_key_t key = k_spin_lock(&conn_lock);
+	struct bt_conn *conn = policy_conn ? bt_conn_ref(policy_conn) : NULL;
+	enum phy_level current = atomic_get(&level);
+	enum phy_level next;
+	int8_t rssi;
+	int err;
+
+	k_spin_unlock(&conn_lock, key);
+
+	if (!conn) {
+		return;
+	}
+
+	err = conn_rssi_read(conn, &rssi);
+	if (err) {
+		LOG_WRN("Failed to read RSSI (err %d)", err);
+		goto out;
+	}
+
+	if (!rssi_valid) {
+		rssi_avg = rssi * RSSI_SCALE;
+		rssi_valid = true;
+	} else {
+		rssi_avg += rssi - rssi_avg / RSSI_SCALE;
+	}
+
+	next = level_pick(current, rssi_avg);
+	if (next != current && k_uptime_get() - last_switch >= CONFIG_APP_PHY_POLICY_HOLD_MS) {
+		LOG_INF("RSSI %d dBm, switching from %s to %s", rssi_avg / RSSI_SCALE,
+			phys[current].name, phys[next].name);
+
+		last_switch = k_uptime_get();
+
+		/* The level follows once the controller reports the new PHY,
+		 * except between S2 and S8, which it does not report apart.
+		 */
+		err = bt_conn_le_phy_update(conn, &phys[next].param);
+		if (err) {
+			LOG_WRN("bt_conn_le_phy_update() returned %d", err);
+		} else if (current >= PHY_CODED_S2 && next >= PHY_CODED_S2) {
+			atomic_set(&level, next);
+		} else if (next >= PHY_CODED_S2) {
+			atomic_set(&coded_next, next);
+		}
+	}
+
+out:
+	bt_conn_unref(conn);
+	k_work_reschedule(&sample_work, K_MSEC(PERIOD_MS));
+}
+
+static void on_connected(struct bt_conn *conn, uint8_t err)
+{
+	k_spinlock_key_t key;
+
+	if (err) {
+		return;
+	}
+
+	key = k_spin_lock(&conn_lock);
+	if (policy_conn) {
+		k_spin_unlock(&conn_lock, key);
+		return;
+	}
+	policy_conn = bt_conn_ref(conn);
+	k_spin_unlock(&conn_lock, key);
+
+	/* Every connection starts on 1M. */
+	atomic_set(&level, PHY_1M);
+	atomic_set(&coded_next, PHY_CODED_S8);
+	rssi_valid = false;
+	last_switch = k_uptime_get();
+	atomic_set(&sent_bytes, 0);
+	atomic_set(&phy_since, k_uptime_get_32());
+
+	k_work_reschedule(&sample_work, K_MSEC(PERIOD_MS));
+}
+
+static void on_disconnected(struct bt_conn *conn, uint8_t reason)
+{
+	k_spinlock_key_t key = k_spin_lock(&conn_lock);
+
+	if (conn != policy_conn) {
+		k_spin_unlock(&conn_lock, key);
+		return;
+	}
+
+	policy_conn = NULL;
+	k_spin_unlock(&conn_lock, key);
+
+	k_work_cancel_delayable(&sample_work);
+	bt_conn_unref(conn);
+}
+
+static void on_le_phy_updated(struct bt_conn *conn, struct bt_conn_le_phy_info *param)
+{
+	uint32_t now = k_uptime_get_32();
+	uint32_t elapsed_ms;
+	uint32_t bytes;
+
+	if (conn != policy_conn) {
+		return;
+	}
+
+	/* The peer may have turned the switch down, or someone else asked
+	 * for the PHY. The event does not tell S2 from S8, so a switch to
+	 * Coded takes the coding that was asked for, or S8 if it was not
+	 * ours.
+	 */
+	if (param->tx_phy == BT_GAP_LE_PHY_2M) {
+		atomic_set(&level, PHY_2M);
+	} else if (param->tx_phy == BT_GAP_LE_PHY_1M) {
+		atomic_set(&level, PHY_1M);
+	} else if (param->tx_phy == BT_GAP_LE_PHY_CODED && atomic_get(&level) < PHY_CODED_S2) {
+		atomic_set(&level, atomic_set(&coded_next, PHY_CODED_S8));
+	}
+
+	elapsed_ms = MAX(now - (uint32_t)atomic_set(&phy_since, now), 1);
+	bytes = atomic_set(&sent_bytes, 0);
+
+	/* Bytes per millisecond times 8 is kbit/s. */
+	LOG_INF("PHY %u/%u in use, goodput before the switch %u kbps over %u ms", param->tx_phy,
+		param->rx_phy, bytes * 8 / elapsed_ms, elapsed_ms);
+}
+
+BT_CONN_CB_DEFINE(phy_policy_conn_callbacks) = {
+	.connected = on_connected,
+	.disconnected = on_disconnected,
+	.le_phy_updated = on_le_phy_updated,
+};
+
+void phy_policy_sent(size_t len)
+{
+	atomic_add(&sent_bytes, len);
+}
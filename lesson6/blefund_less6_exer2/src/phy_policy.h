@@ -0,0 +1,45 @@
+/*
+ * Copyright (c) 2023 Nordic Semiconductor ASA
+ *
+ * SPDX-License-Identifier: LicenseRef-Nordic-5-Clause
+ */
+
+#ifndef PHY_POLICY_H_
+#define PHY_POLICY_H_
+
+/**@file
+ * @defgroup phy_policy PHY policy
+ * @{
+ * @brief Pick the PHY of the connection from the signal strength.
+ *
+ * The policy reads the RSSI of the connection periodically and keeps a
+ * smoothed value. It steps from 2M to 1M to Coded S2 to Coded S8 as the
+ * signal gets weaker, and back as it gets stronger. Every PHY has a
+ * lowest RSSI. Stepping back needs the RSSI to climb a hysteresis above
+ * it, and switches are at least CONFIG_APP_PHY_POLICY_HOLD_MS apart.
+ * Every switch is logged with the goodput of the PHY that was left.
+ */
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <zephyr/types.h>
+
+/** @brief Count application data acknowledged on the connection.
+ *
+ * Safe to call from any context.
+ *
+ * @param[in] len Number of bytes.
+ */
+void phy_policy_sent(size_t len);
+
+#ifdef __cplusplus
+}
+#endif
+
+/**
+ * @}
+ */
+
+#endif /* PHY_POLICY_H_ */
@@ -0,0 +1,420 @@
+/*
+ * Copyright (c) 2023 Nordic Semiconductor ASA
+ *
+ * SPDX-License-Identifier: LicenseRef-Nordic-5-Clause
+ */
+
+/** @file
+ *  @brief Link telemetry
+ */
+
+#include <zephyr/types.h>
+#include <errno.h>
+#include <string.h>
+#include <zephyr/kernel.h>
+#include <zephyr/sys/atomic.h>
+#include <zephyr/bluetooth/bluetooth.h>
+#include <zephyr/bluetooth/conn.h>
+#include <zephyr/bluetooth/uuid.h>
+#include <zephyr/bluetooth/gatt.h>
+#if defined(CONFIG_SHELL)
+#include <zephyr/shell/shell.h>
+#endif
+
+#include "conn_rssi.h"
+#include "conn_time.h"
+#include "telemetry.h"
+
+#include <zephyr/logging/log.h>
+LOG_MODULE_REGISTER(telemetry, LOG_LEVEL_INF);
+
+#define PERIOD_MS CONFIG_APP_TELEMETRY_PERIOD_MS
+#define RING_SIZE CONFIG_APP_TELEMETRY_RING_SIZE
+#define HISTORY_SIZE CONFIG_APP_TELEMETRY_PARAM_HISTORY
+#define RSSI_UNKNOWN 127
+
+BUILD_ASSERT(RING_SIZE * sizeof(struct telemetry_sample) <= 512,
+	     "Telemetry ring larger than an attribute value");
+BUILD_ASSERT(HISTORY_SIZE * sizeof(struct telemetry_params) <= 512,
+	     "Parameter history larger than an attribute value");
+
+struct link_slot {
+	/* NULL once disconnected, the rings are kept until the slot is reused. */
+	struct bt_conn *conn;
+	bt_addr_le_t addr;
+	/* Traffic of the current period */
+	atomic_t tx_bytes;
+	atomic_t rx_bytes;
+	atomic_t tx_failed;
+	/* Entries ever written, the oldest is overwritten when full. */
+	uint32_t sample_count;
+	uint32_t params_count;
+	struct telemetry_sample samples[RING_SIZE];
+	struct telemetry_params params[HISTORY_SIZE];
+};
+
+/* Long reads come in several requests, served from a snapshot. */
+struct read_snapshot {
+	struct telemetry_sample samples[RING_SIZE];
+	size_t samples_len;
+	struct telemetry_params params[HISTORY_SIZE];
+	size_t params_len;
+};
+
+/* One more than there are connections, for the link that ended last */
+static struct link_slot slots[CONFIG_BT_MAX_CONN + 1];
+/* Slot of every connection, indexed by bt_conn_index() */
+static struct link_slot *conn_slot[CONFIG_BT_MAX_CONN];
+/* Slot of the link that ended last, NULL if none */
+static struct link_slot *prev_slot;
+/* Protects the slot assignment, the connection and the rings of every slot */
+static struct k_spinlock slot_lock;
+
+/* Indexed by the bt_conn_index() of the reader, for the current and the
+ * previous link
+ */
+static struct read_snapshot snapshots[CONFIG_BT_MAX_CONN][2];
+
+/* Copy a ring oldest entry first, return the number of entries. */
+static size_t ring_copy(void *out, const void *ring, size_t entry_size, size_t ring_size,
+			uint32_t count)
+{
+	size_t n = MIN(count, ring_size);
+	uint32_t first = count - n;
+
+	for (size_t i = 0; i < n; i++) {
+		memcpy((uint8_t *)out + i * entry_size,
+		       (const uint8_t *)ring + ((first + i) % ring_size) * entry_size, entry_size);
+	}
+
+	return n;
+}
+
+static void params_record(struct link_slot *slot, uint16_t interval, uint16_t latency,
+			  uint16_t timeout)
+{
+	k_spinlock_key_t key = k_spin_lock(&slot_lock);
+	struct telemetry_params *p = &slot->params[slot->params_count % HISTORY_SIZE];
+
+	p->uptime_ms = k_uptime_get_32();
+	p->interval = interval;
+	p->latency = latency;
+	p->timeout = timeout;
+	slot->params_count++;
+
+	k_spin_unlock(&slot_lock, key);
+}
+
+static void sample_take(struct link_slot *slot, struct bt_conn *conn)
+{
+	atomic_val_t failed = atomic_clear(&slot->tx_failed);
+	struct telemetry_sample s = {
+		.uptime_ms = k_uptime_get_32(),
+		.tx_bytes = atomic_clear(&slot->tx_bytes),
+		.rx_bytes = atomic_clear(&slot->rx_bytes),
+		.tx_failed = MIN(failed, UINT16_MAX),
+		.mtu = bt_gatt_get_mtu(conn),
+		.rssi = RSSI_UNKNOWN,
+	};
+	struct bt_conn_info info;
+	k_spinlock_key_t key;
+	int8_t rssi;
+
+	if (!bt_conn_get_info(conn, &info)) {
+		s.interval = info.le.interval;
+		s.latency = info.le.latency;
+		s.tx_phy = info.le.phy->tx_phy;
+		s.rx_phy = info.le.phy->rx_phy;
+		s.tx_len = info.le.data_len->tx_max_len;
+		s.rx_len = info.le.data_len->rx_max_len;
+	}
+
+	if (!conn_rssi_read(conn, &rssi)) {
+		s.rssi = rssi;
+	}
+
+	LOG_DBG("RSSI %d dBm, %u bytes sent, %u received, %u failed", s.rssi, s.tx_bytes,
+		s.rx_bytes, s.tx_failed);
+
+	key = k_spin_lock(&slot_lock);
+	slot->samples[slot->sample_count % RING_SIZE] = s;
+	slot->sample_count++;
+	k_spin_unlock(&slot_lock, key);
+}
+
+static void sample_work_handler(struct k_work *work);
+
+static K_WORK_DELAYABLE_DEFINE(sample_work, sample_work_handler);
+
+static void sample_work_handler(struct k_work *work)
+{
+	bool active = false;
+
+	for (size_t i = 0; i < ARRAY_SIZE(slots); i++) {
+		k_spinlock_key_t key = k_spin_lock(&slot_lock);
+		struct bt_conn *conn = slots[i].conn ? bt_conn_ref(slots[i].conn) : NULL;
+
+		k_spin_unlock(&slot_lock, key);
+
+		if (conn) {
+			sample_take(&slots[i], conn);
+			bt_conn_unref(conn);
+			active = true;
+		}
+	}
+
+	if (active) {
+		k_work_reschedule(&sample_work, K_MSEC(PERIOD_MS));
+	}
+}
+
+static ssize_t samples_read(struct bt_conn *conn, const struct bt_gatt_attr *attr, void *buf,
+			    uint16_t len, uint16_t offset, bool prev)
+{
+	struct read_snapshot *snap = &snapshots[bt_conn_index(conn)][prev];
+
+	if (offset == 0) {
+		k_spinlock_key_t key = k_spin_lock(&slot_lock);
+		struct link_slot *slot = prev ? prev_slot : conn_slot[bt_conn_index(conn)];
+
+		snap->samples_len = slot ? ring_copy(snap->samples, slot->samples,
+						     sizeof(slot->samples[0]), RING_SIZE,
+						     slot->sample_count) *
+						   sizeof(slot->samples[0])
+					 : 0;
+		k_spin_unlock(&slot_lock, key);
+	}
+
+	return bt_gatt_attr_read(conn, attr, buf, len, offset, snap->samples, snap->samples_len);
+}
+
+static ssize_t params_read(struct bt_conn *conn, const struct bt_gatt_attr *attr, void *buf,
+			   uint16_t len, uint16_t offset, bool prev)
+{
+	struct read_snapshot *snap = &snapshots[bt_conn_index(conn)][prev];
+
+	if (offset == 0) {
+		k_spinlock_key_t key = k_spin_lock(&slot_lock);
+		struct link_slot *slot = prev ? prev_slot : conn_slot[bt_conn_index(conn)];
+
+		snap->params_len = slot ? ring_copy(snap->params, slot->params,
+						    sizeof(slot->params[0]), HISTORY_SIZE,
+						    slot->params_count) *
+						  sizeof(slot->params[0])
+					: 0;
+		k_spin_unlock(&slot_lock, key);
+	}
+
+	return bt_gatt_attr_read(conn, attr, buf, len, offset, snap->params, snap->params_len);
+}
+
+static ssize_t read_samples(struct bt_conn *conn, const struct bt_gatt_attr *attr, void *buf,
+			    uint16_t len, uint16_t offset)
+{
+	return samples_read(conn, attr, buf, len, offset, false);
+}
+
+static ssize_t read_params(struct bt_conn *conn, const struct bt_gatt_attr *attr, void *buf,
+			   uint16_t len, uint16_t offset)
+{
+	return params_read(conn, attr, buf, len, offset, false);
+}
+
+static ssize_t read_prev_samples(struct bt_conn *conn, const struct bt_gatt_attr *attr, void *buf,
+				 uint16_t len, uint16_t offset)
+{
+	return samples_read(conn, attr, buf, len, offset, true);
+}
+
+static ssize_t read_prev_params(struct bt_conn *conn, const struct bt_gatt_attr *attr, void *buf,
+				uint16_t len, uint16_t offset)
+{
+	return params_read(conn, attr, buf, len, offset, true);
+}
+
+/* Telemetry Service Declaration */
+BT_GATT_SERVICE_DEFINE(telemetry_svc, BT_GATT_PRIMARY_SERVICE(BT_UUID_TELEMETRY),
+		       BT_GATT_CHARACTERISTIC(BT_UUID_TELEMETRY_SAMPLES, BT_GATT_CHRC_READ,
+					      BT_GATT_PERM_READ, read_samples, NULL, NULL),
+		       BT_GATT_CHARACTERISTIC(BT_UUID_TELEMETRY_PARAMS, BT_GATT_CHRC_READ,
+					      BT_GATT_PERM_READ, read_params, NULL, NULL),
+		       BT_GATT_CHARACTERISTIC(BT_UUID_TELEMETRY_PREV_SAMPLES, BT_GATT_CHRC_READ,
+					      BT_GATT_PERM_READ, read_prev_samples, NULL, NULL),
+		       BT_GATT_CHARACTERISTIC(BT_UUID_TELEMETRY_PREV_PARAMS, BT_GATT_CHRC_READ,
+					      BT_GATT_PERM_READ, read_prev_params, NULL, NULL), );
+
+static void on_connected(struct bt_conn *conn, uint8_t err)
+{
+	struct link_slot *slot = NULL;
+	struct bt_conn_info info;
+	k_spinlock_key_t key;
+
+	if (err || bt_conn_get_info(conn, &info)) {
+		return;
+	}
+
+	key = k_spin_lock(&slot_lock);
+
+	/* There is always a slot that is neither connected nor the previous. */
+	for (size_t i = 0; i < ARRAY_SIZE(slots); i++) {
+		if (!slots[i].conn && &slots[i] != prev_slot) {
+			slot = &slots[i];
+			break;
+		}
+	}
+
+	slot->conn = bt_conn_ref(conn);
+	bt_addr_le_copy(&slot->addr, info.le.dst);
+	slot->sample_count = 0;
+	slot->params_count = 0;
+	atomic_clear(&slot->tx_bytes);
+	atomic_clear(&slot->rx_bytes);
+	atomic_clear(&slot->tx_failed);
+	conn_slot[bt_conn_index(conn)] = slot;
+	k_spin_unlock(&slot_lock, key);
+
+	params_record(slot, info.le.interval, info.le.latency, info.le.timeout);
+
+	k_work_schedule(&sample_work, K_MSEC(PERIOD_MS));
+}
+
+static void on_disconnected(struct bt_conn *conn, uint8_t reason)
+{
+	k_spinlock_key_t key = k_spin_lock(&slot_lock);
+	struct link_slot *slot = conn_slot[bt_conn_index(conn)];
+
+	if (!slot || slot->conn != conn) {
+		k_spin_unlock(&slot_lock, key);
+		return;
+	}
+
+	/* Keep the rings of the link that ended for diagnosis. */
+	slot->conn = NULL;
+	conn_slot[bt_conn_index(conn)] = NULL;
+	prev_slot = slot;
+	k_spin_unlock(&slot_lock, key);
+
+	bt_conn_unref(conn);
+}
+
+static void on_le_param_updated(struct bt_conn *conn, uint16_t interval, uint16_t latency,
+				uint16_t timeout)
+{
+	struct link_slot *slot = conn_slot[bt_conn_index(conn)];
+
+	if (slot) {
+		params_record(slot, interval, latency, timeout);
+	}
+}
+
+BT_CONN_CB_DEFINE(telemetry_conn_callbacks) = {
+	.connected = on_connected,
+	.disconnected = on_disconnected,
+	.le_param_updated = on_le_param_updated,
+};
+
+void telemetry_tx(struct bt_conn *conn, size_t len)
+{
+	struct link_slot *slot = conn_slot[bt_conn_index(conn)];
+
+	if (slot) {
+		atomic_add(&slot->tx_bytes, len);
+	}
+}
+
+void telemetry_rx(struct bt_conn *conn, size_t len)
+{
+	struct link_slot *slot = conn_slot[bt_conn_index(conn)];
+
+	if (slot) {
+		atomic_add(&slot->rx_bytes, len);
+	}
+}
+
+void telemetry_tx_failed(struct bt_conn *conn)
+{
+	struct link_slot *slot;
+
+	if (conn) {
+		slot = conn_slot[bt_conn_index(conn)];
+		if (slot) {
+			atomic_inc(&slot->tx_failed);
+		}
+		return;
+	}
+
+	for (size_t i = 0; i < ARRAY_SIZE(slots); i++) {
+		if (slots[i].conn) {
+			atomic_inc(&slots[i].tx_failed);
+		}
+	}
+}
+
+#if defined(CONFIG_SHELL)
+/* Only used from the shell thread */
+static struct telemetry_sample shell_samples[RING_SIZE];
+static struct telemetry_params shell_params[HISTORY_SIZE];
+
+static void slot_print(const struct shell *sh, size_t index)
+{
+	struct link_slot *slot = &slots[index];
+	char addr[BT_ADDR_LE_STR_LEN];
+	k_spinlock_key_t key;
+	size_t samples;
+	size_t params;
+	bool connected;
+	bool prev;
+
+	key = k_spin_lock(&slot_lock);
+	connected = (slot->conn != NULL);
+	prev = (slot == prev_slot);
+	samples = ring_copy(shell_samples, slot->samples, sizeof(slot->samples[0]), RING_SIZE,
+			    slot->sample_count);
+	params = ring_copy(shell_params, slot->params, sizeof(slot->params[0]), HISTORY_SIZE,
+			   slot->params_count);
+	bt_addr_le_to_str(&slot->addr, addr, sizeof(addr));
+	k_spin_unlock(&slot_lock, key);
+
+	if ((!samples && !params) || (!connected && !prev)) {
+		return;
+	}
+
+	shell_print(sh, "Slot %u: %s%s", (unsigned int)index, addr,
+		    connected ? "" : " (previous, disconnected)");
+
+	for (size_t i = 0; i < params; i++) {
+		const struct telemetry_params *p = &shell_params[i];
+
+		shell_print(sh, "  %10u ms: interval " CONN_TIME_FMT ", latency %u, timeout %u ms",
+			    p->uptime_ms, CONN_TIME_ARGS(CONN_TIME_INTERVAL_US(p->interval)),
+			    p->latency, p->timeout * 10);
+	}
+
+	shell_print(sh, "  %10s %4s %5s %9s %4s %8s %8s %4s", "uptime ms", "rssi", "phy",
+		    "length", "mtu", "tx B", "rx B", "fail");
+
+	for (size_t i = 0; i < samples; i++) {
+		const struct telemetry_sample *s = &shell_samples[i];
+
+		shell_print(sh, "  %10u %4d %2u/%-2u %4u/%-4u %4u %8u %8u %4u", s->uptime_ms,
+			    s->rssi, s->tx_phy, s->rx_phy, s->tx_len, s->rx_len, s->mtu,
+			    s->tx_bytes, s->rx_bytes, s->tx_failed);
+	}
+}
+
+static int cmd_show(const struct shell *sh, size_t argc, char **argv)
+{
+	for (size_t i = 0; i < ARRAY_SIZE(slots); i++) {
+		slot_print(sh, i);
+	}
+
+	return 0;
+}
+
+SHELL_STATIC_SUBCMD_SET_CREATE(telemetry_cmds,
+			       SHELL_CMD(show, NULL, "Show the telemetry of every connection",
+					 cmd_show),
+			       SHELL_SUBCMD_SET_END);
+
+SHELL_CMD_REGISTER(telemetry, &telemetry_cmds, "Link telemetry", NULL);
+#endif
@@ -0,0 +1,151 @@
+/*
+ * Copyright (c) 2023 Nordic Semiconductor ASA
+ *
+ * SPDX-License-Identifier: LicenseRef-Nordic-5-Clause
+ */
+
+#ifndef TELEMETRY_H_
+#define TELEMETRY_H_
+
+/**@file
+ * @defgroup telemetry Link telemetry
+ * @{
+ * @brief Record the link quality and throughput of every connection.
+ *
+ * Every CONFIG_APP_TELEMETRY_PERIOD_MS a sample with the RSSI, PHY, data
+ * length, ATT MTU, connection parameters and the traffic of the period is
+ * stored in a ring per connection, and every connection parameter change
+ * is stored in a second ring. The rings of the link that ended last are
+ * kept until the next link ends, so a slow or lost link can be diagnosed
+ * after the central has connected again. All memory is static.
+ *
+ * The rings can be read with the "telemetry show" shell command when
+ * CONFIG_SHELL is enabled, and from the Telemetry characteristics, oldest
+ * entry first. A central reads the rings of its own connection and those
+ * of the link that ended last.
+ */
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <zephyr/types.h>
+#include <zephyr/bluetooth/conn.h>
+#include <zephyr/bluetooth/uuid.h>
+
+/** @brief Telemetry Service UUID. */
+#define BT_UUID_TELEMETRY_VAL                                                                      \
+	BT_UUID_128_ENCODE(0x00001620, 0x1212, 0xefde, 0x1523, 0x785feabcd123)
+
+/** @brief Samples Characteristic UUID, an array of
+ *  struct telemetry_sample.
+ */
+#define BT_UUID_TELEMETRY_SAMPLES_VAL                                                              \
+	BT_UUID_128_ENCODE(0x00001621, 0x1212, 0xefde, 0x1523, 0x785feabcd123)
+
+/** @brief Parameter History Characteristic UUID, an array of
+ *  struct telemetry_params.
+ */
+#define BT_UUID_TELEMETRY_PARAMS_VAL                                                               \
+	BT_UUID_128_ENCODE(0x00001622, 0x1212, 0xefde, 0x1523, 0x785feabcd123)
+
+/** @brief Previous Samples Characteristic UUID, the samples of the link
+ *  that ended last.
+ */
+#define BT_UUID_TELEMETRY_PREV_SAMPLES_VAL                                                         \
+	BT_UUID_128_ENCODE(0x00001623, 0x1212, 0xefde, 0x1523, 0x785feabcd123)
+
+/** @brief Previous Parameter History Characteristic UUID, the parameter
+ *  history of the link that ended last.
+ */
+#define BT_UUID_TELEMETRY_PREV_PARAMS_VAL                                                          \
+	BT_UUID_128_ENCODE(0x00001624, 0x1212, 0xefde, 0x1523, 0x785feabcd123)
+
+#define BT_UUID_TELEMETRY BT_UUID_DECLARE_128(BT_UUID_TELEMETRY_VAL)
+#define BT_UUID_TELEMETRY_SAMPLES BT_UUID_DECLARE_128(BT_UUID_TELEMETRY_SAMPLES_VAL)
+#define BT_UUID_TELEMETRY_PARAMS BT_UUID_DECLARE_128(BT_UUID_TELEMETRY_PARAMS_VAL)
+#define BT_UUID_TELEMETRY_PREV_SAMPLES BT_UUID_DECLARE_128(BT_UUID_TELEMETRY_PREV_SAMPLES_VAL)
+#define BT_UUID_TELEMETRY_PREV_PARAMS BT_UUID_DECLARE_128(BT_UUID_TELEMETRY_PREV_PARAMS_VAL)
+
+/** @brief Connection parameters in effect from a point in time.
+ *
+ * Sent over GATT as is, little-endian.
+ */
+struct telemetry_params {
+	/** Uptime of the change. */
+	uint32_t uptime_ms;
+	/** Connection interval, N*1.25 ms. */
+	uint16_t interval;
+	/** Peripheral latency. */
+	uint16_t latency;
+	/** Supervision timeout, N*10 ms. */
+	uint16_t timeout;
+} __packed;
+
+/** @brief State of a connection at the end of a period.
+ *
+ * Sent over GATT as is, little-endian.
+ */
+struct telemetry_sample {
+	/** Uptime of the sample. */
+	uint32_t uptime_ms;
+	/** Application bytes sent during the period. */
+	uint32_t tx_bytes;
+	/** Application bytes received during the period. */
+	uint32_t rx_bytes;
+	/** Notifications that could not be sent during the period. */
+	uint16_t tx_failed;
+	/** Connection interval, N*1.25 ms. */
+	uint16_t interval;
+	/** Peripheral latency. */
+	uint16_t latency;
+	/** Maximum TX payload length of the link layer. */
+	uint16_t tx_len;
+	/** Maximum RX payload length of the link layer. */
+	uint16_t rx_len;
+	/** ATT MTU. */
+	uint16_t mtu;
+	/** RSSI in dBm, 127 if it could not be read. */
+	int8_t rssi;
+	/** TX PHY, BT_GAP_LE_PHY_*. */
+	uint8_t tx_phy;
+	/** RX PHY, BT_GAP_LE_PHY_*. */
+	uint8_t rx_phy;
+} __packed;
+
+/** @brief Count application data sent on a connection.
+ *
+ * Safe to call from any context.
+ *
+ * @param[in] conn The connection.
+ * @param[in] len Number of bytes.
+ */
+void telemetry_tx(struct bt_conn *conn, size_t len);
+
+/** @brief Count application data received on a connection.
+ *
+ * Safe to call from any context.
+ *
+ * @param[in] conn The connection.
+ * @param[in] len Number of bytes.
+ */
+void telemetry_rx(struct bt_conn *conn, size_t len);
+
+/** @brief Count a notification that could not be sent.
+ *
+ * Safe to call from any context.
+ *
+ * @param[in] conn The connection, or NULL if the notification was for
+ *		   all connections.
+ */
+void telemetry_tx_failed(struct bt_conn *conn);
+
+#ifdef __cplusplus
+}
+#endif
+
+/**
+ * @}
+ */
+
+#endif /* TELEMETRY_H_ */
@@ -0,0 +1,108 @@
+/*
+ * Copyright (c) 2023 Nordic Semiconductor ASA
+ *
+ * SPDX-License-Identifier: LicenseRef-Nordic-5-Clause
+ */
+
+/** @file
+ *  @brief Max throughput profile
+ */
+
+#include <zephyr/types.h>
+#include <errno.h>
+#include <zephyr/kernel.h>
+#include <zephyr/bluetooth/bluetooth.h>
+#include <zephyr/bluetooth/conn.h>
+#include <zephyr/bluetooth/hci.h>
+
+#if defined(CONFIG_BT_LL_SOFTDEVICE)
+#include <sdc_hci_vs.h>
+#endif
+
+#include "tput_profile.h"
+
+#include <zephyr/logging/log.h>
+LOG_MODULE_REGISTER(tput_profile, LOG_LEVEL_INF);
+
+static const struct bt_le_conn_param tput_param =
+	BT_LE_CONN_PARAM_INIT(CONFIG_APP_TPUT_INTERVAL, CONFIG_APP_TPUT_INTERVAL, 0,
+			      CONFIG_APP_TPUT_SUPERVISION_TIMEOUT);
+
+/* A longer event than the interval is never scheduled in full. */
+BUILD_ASSERT(CONFIG_APP_TPUT_EVENT_LEN_US <= CONFIG_APP_TPUT_INTERVAL * 1250,
+	     "Event length longer than the connection interval");
+
+int tput_profile_event_len_set(uint32_t event_len_us)
+{
+#if defined(CONFIG_BT_LL_SOFTDEVICE)
+	sdc_hci_cmd_vs_event_length_set_t *cp;
+	struct net_buf *buf;
+
+	buf = bt_hci_cmd_create(SDC_HCI_OPCODE_CMD_VS_EVENT_LENGTH_SET, sizeof(*cp));
+	if (!buf) {
+		return -ENOBUFS;
+	}
+
+	cp = net_buf_add(buf, sizeof(*cp));
+	cp->event_length_us = event_len_us;
+
+	return bt_hci_cmd_send_sync(SDC_HCI_OPCODE_CMD_VS_EVENT_LENGTH_SET, buf, NULL);
+#else
+	return -ENOTSUP;
+#endif
+}
+
+int tput_profile_event_extend_set(bool enable)
+{
+#if defined(CONFIG_BT_LL_SOFTDEVICE)
+	sdc_hci_cmd_vs_conn_event_extend_t *cp;
+	struct net_buf *buf;
+
+	buf = bt_hci_cmd_create(SDC_HCI_OPCODE_CMD_VS_CONN_EVENT_EXTEND, sizeof(*cp));
+	if (!buf) {
+		return -ENOBUFS;
+	}
+
+	cp = net_buf_add(buf, sizeof(*cp));
+	cp->enable = enable;
+
+	return bt_hci_cmd_send_sync(SDC_HCI_OPCODE_CMD_VS_CONN_EVENT_EXTEND, buf, NULL);
+#else
+	return -ENOTSUP;
+#endif
+}
+
+int tput_profile_init(void)
+{
+	int err;
+
+	err = tput_profile_event_len_set(CONFIG_APP_TPUT_EVENT_LEN_US);
+	if (err) {
+		return err;
+	}
+
+	err = tput_profile_event_extend_set(true);
+	if (err) {
+		return err;
+	}
+
+	LOG_INF("Connection event length %u us, event extension on",
+		CONFIG_APP_TPUT_EVENT_LEN_US);
+
+	return 0;
+}
+
+int tput_profile_apply(struct bt_conn *conn)
+{
+	int err;
+
+	/* With event extension a longer interval carries more data: fewer
+	 * events means fewer gaps between them.
+	 */
+	err = bt_conn_le_param_update(conn, &tput_param);
+	if (err == -EALREADY) {
+		return 0;
+	}
+
+	return err;
+}
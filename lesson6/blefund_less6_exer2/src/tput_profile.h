@@ -0,0 +1,79 @@
+/*
+ * Copyright (c) 2023 Nordic Semiconductor ASA
+ *
+ * SPDX-License-Identifier: LicenseRef-Nordic-5-Clause
+ */
+
+#ifndef TPUT_PROFILE_H_
+#define TPUT_PROFILE_H_
+
+/**@file
+ * @defgroup tput_profile Max throughput profile
+ * @{
+ * @brief Configure the controller and the connection for bulk transfer.
+ *
+ * By default the controller reserves a short connection event, so only a
+ * few packets are exchanged per connection interval however many are
+ * queued. The profile sets a long event length and enables connection
+ * event extension, so an event continues as long as both sides have data
+ * and there is time before the next event. The buffer counts that keep
+ * the controller fed are set in overlay-max-throughput.conf, the controller
+ * defaults in overlay-max-throughput-sdc.conf.
+ */
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <zephyr/types.h>
+#include <zephyr/bluetooth/conn.h>
+
+/** @brief Configure the controller for throughput.
+ *
+ * Call after bt_enable() and before advertising starts: the event length
+ * only applies to connections created afterwards.
+ *
+ * @retval 0 If the operation was successful.
+ *           Otherwise, a (negative) error code is returned.
+ * @retval -ENOTSUP If the controller has no vendor specific commands for
+ *          it. The controller defaults from the overlays apply then.
+ */
+int tput_profile_init(void);
+
+/** @brief Set the connection event length.
+ *
+ * @param[in] event_len_us Event length for new connections, in
+ *            microseconds.
+ *
+ * @retval 0 If the operation was successful.
+ *           Otherwise, a (negative) error code is returned.
+ */
+int tput_profile_event_len_set(uint32_t event_len_us);
+
+/** @brief Enable or disable connection event extension.
+ *
+ * @param[in] enable Whether events may extend past their length.
+ *
+ * @retval 0 If the operation was successful.
+ *           Otherwise, a (negative) error code is returned.
+ */
+int tput_profile_event_extend_set(bool enable);
+
+/** @brief Request the throughput connection parameters.
+ *
+ * @param[in] conn The connection.
+ *
+ * @retval 0 If the operation was successful.
+ *           Otherwise, a (negative) error code is returned.
+ */
+int tput_profile_apply(struct bt_conn *conn);
+
+#ifdef __cplusplus
+}
+#endif
+
+/**
+ * @}
+ */
+
+#endif /* TPUT_PROFILE_H_ */
@@ -0,0 +1,237 @@
+/*
+ * Copyright (c) 2023 Nordic Semiconductor ASA
+ *
+ * SPDX-License-Identifier: LicenseRef-Nordic-5-Clause
+ */
+
+/** @file
+ *  @brief Button event pipeline
+ */
+
+#include <zephyr/types.h>
+#include <errno.h>
+#include <zephyr/kernel.h>
+#include <zephyr/sys/atomic.h>
+#include <zephyr/sys/util.h>
+#include <zephyr/drivers/gpio.h>
+
+#include "button_events.h"
+
+#include <zephyr/logging/log.h>
+LOG_MODULE_REGISTER(button_events, LOG_LEVEL_INF);
+
+#define QUEUE_SIZE CONFIG_APP_BUTTON_QUEUE_SIZE
+
+BUILD_ASSERT(IS_POWER_OF_TWO(QUEUE_SIZE), "Button queue size must be a power of two");
+
+static const struct gpio_dt_spec button = GPIO_DT_SPEC_GET(DT_ALIAS(sw0), gpios);
+static struct gpio_callback button_cb_data;
+static button_events_handler_t event_handler;
+
+/* Written by the GPIO interrupt and the debounce timer only. */
+static uint32_t edge_timestamp;
+static bool edge_pending;
+static atomic_t button_state;
+
+#if defined(CONFIG_APP_LATENCY_BENCH)
+/* Level reported instead of the pin once an edge has been injected. */
+static bool injected;
+static bool injected_level;
+#endif
+
+/* Single-producer (debounce timer) single-consumer (sender thread) queue. */
+static struct button_event queue[QUEUE_SIZE];
+static atomic_t queue_head;
+static atomic_t queue_tail;
+static atomic_t queue_dropped;
+
+static K_SEM_DEFINE(sender_sem, 0, 1);
+
+static struct k_spinlock latency_lock;
+static struct button_latency latency;
+static uint64_t latency_sum_us;
+
+static bool queue_put(const struct button_event *evt)
+{
+	uint32_t head = (uint32_t)atomic_get(&queue_head);
+
+	if (head - (uint32_t)atomic_get(&queue_tail) == QUEUE_SIZE) {
+		return false;
+	}
+
+	queue[head & (QUEUE_SIZE - 1)] = *evt;
+	/* atomic_set() is a full barrier, the slot is visible before the index. */
+	atomic_set(&queue_head, (atomic_val_t)(head + 1));
+
+	return true;
+}
+
+static bool queue_get(struct button_event *evt)
+{
+	uint32_t tail = (uint32_t)atomic_get(&queue_tail);
+
+	if (tail == (uint32_t)atomic_get(&queue_head)) {
+		return false;
+	}
+
+	*evt = queue[tail & (QUEUE_SIZE - 1)];
+	atomic_set(&queue_tail, (atomic_val_t)(tail + 1));
+
+	return true;
+}
+
+static void debounce_expired(struct k_timer *timer)
+{
+	struct button_event evt;
+	int val;
+
+	edge_pending = false;
+
+#if defined(CONFIG_APP_LATENCY_BENCH)
+	val = injected ? injected_level : gpio_pin_get_dt(&button);
+#else
+	val = gpio_pin_get_dt(&button);
+#endif
+	if (val < 0 || (bool)val == atomic_get(&button_state)) {
+		/* Read error or the bounce settled back to the old state. */
+		return;
+	}
+
+	atomic_set(&button_state, val);
+
+	evt.timestamp = edge_timestamp;
+	evt.pressed = val;
+	if (!queue_put(&evt)) {
+		atomic_inc(&queue_dropped);
+	}
+
+	k_sem_give(&sender_sem);
+}
+
+static K_TIMER_DEFINE(debounce_timer, debounce_expired, NULL);
+
+static void button_isr(const struct device *dev, struct gpio_callback *cb, uint32_t pins)
+{
+	/* The first edge of a burst is the moment the user acted. */
+	if (!edge_pending) {
+		edge_timestamp = k_cycle_get_32();
+		edge_pending = true;
+	}
+
+	k_timer_start(&debounce_timer, K_MSEC(CONFIG_APP_BUTTON_DEBOUNCE_MS), K_NO_WAIT);
+}
+
+static void sender_thread(void)
+{
+	struct button_event evt;
+	struct button_event last;
+	bool last_sent = false;
+	uint32_t coalesced;
+
+	for (;;) {
+		k_sem_take(&sender_sem, K_FOREVER);
+
+		coalesced = 0;
+		if (!queue_get(&last)) {
+			continue;
+		}
+
+		while (queue_get(&evt)) {
+			last = evt;
+			coalesced++;
+		}
+
+		if (coalesced) {
+			LOG_DBG("Coalesced %u button events", coalesced);
+		}
+
+		if (atomic_get(&queue_dropped)) {
+			LOG_WRN("Dropped %ld button events", atomic_clear(&queue_dropped));
+		}
+
+		if (last.pressed == last_sent) {
+			/* The toggles cancelled out while the sender was busy. */
+			continue;
+		}
+
+		last_sent = last.pressed;
+
+		if (event_handler) {
+			event_handler(&last);
+		}
+	}
+}
+
+K_THREAD_DEFINE(button_sender, CONFIG_APP_BUTTON_SENDER_STACK_SIZE, sender_thread, NULL, NULL,
+		NULL, CONFIG_APP_BUTTON_SENDER_PRIORITY, 0, 0);
+
+int button_events_init(button_events_handler_t handler)
+{
+	int err;
+
+	if (!device_is_ready(button.port)) {
+		LOG_ERR("Button device %s is not ready", button.port->name);
+		return -ENODEV;
+	}
+
+	err = gpio_pin_configure_dt(&button, GPIO_INPUT);
+	if (err) {
+		return err;
+	}
+
+	event_handler = handler;
+	atomic_set(&button_state, gpio_pin_get_dt(&button) > 0);
+
+	gpio_init_callback(&button_cb_data, button_isr, BIT(button.pin));
+	err = gpio_add_callback(button.port, &button_cb_data);
+	if (err) {
+		return err;
+	}
+
+	return gpio_pin_interrupt_configure_dt(&button, GPIO_INT_EDGE_BOTH);
+}
+
+#if defined(CONFIG_APP_LATENCY_BENCH)
+void button_events_inject(bool pressed)
+{
+	unsigned int key = irq_lock();
+
+	injected = true;
+	injected_level = pressed;
+	button_isr(button.port, &button_cb_data, BIT(button.pin));
+
+	irq_unlock(key);
+}
+#endif
+
+bool button_events_state(void)
+{
+	return atomic_get(&button_state);
+}
+
+void button_events_latency_record(uint32_t timestamp)
+{
+	uint32_t us = k_cyc_to_us_floor32(k_cycle_get_32() - timestamp);
+	k_spinlock_key_t key = k_spin_lock(&latency_lock);
+
+	if (latency.count == 0 || us < latency.min_us) {
+		latency.min_us = us;
+	}
+	if (us > latency.max_us) {
+		latency.max_us = us;
+	}
+	latency.count++;
+	latency_sum_us += us;
+	latency.avg_us = latency_sum_us / latency.count;
+
+	k_spin_unlock(&latency_lock, key);
+}
+
+void button_events_latency_get(struct button_latency *stats)
+{
+	k_spinlock_key_t key = k_spin_lock(&latency_lock);
+
+	*stats = latency;
+
+	k_spin_unlock(&latency_lock, key);
+}
@@ -0,0 +1,104 @@
+/*
+ * Copyright (c) 2023 Nordic Semiconductor ASA
+ *
+ * SPDX-License-Identifier: LicenseRef-Nordic-5-Clause
+ */
+
+#ifndef BUTTON_EVENTS_H_
+#define BUTTON_EVENTS_H_
+
+/**@file
+ * @defgroup button_events Button event pipeline
+ * @{
+ * @brief Debounced button events delivered to a dedicated sender thread.
+ *
+ * Edges of the button are timestamped in the GPIO interrupt and debounced
+ * in a kernel timer. Every settled state change is put in a lock-free
+ * single-producer single-consumer queue and handed to a sender thread,
+ * which coalesces events that piled up while it was busy.
+ */
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <zephyr/types.h>
+
+/** @brief Debounced button event. */
+struct button_event {
+	/** Cycle counter value of the first edge of the bounce burst. */
+	uint32_t timestamp;
+	/** Settled button state. */
+	bool pressed;
+};
+
+/** @brief Press-to-notification latency statistics, in microseconds. */
+struct button_latency {
+	/** Number of measured events. */
+	uint32_t count;
+	/** Smallest latency. */
+	uint32_t min_us;
+	/** Largest latency. */
+	uint32_t max_us;
+	/** Mean latency. */
+	uint32_t avg_us;
+};
+
+/** @brief Callback type for a debounced button event.
+ *
+ * Called from the sender thread, so it may block.
+ */
+typedef void (*button_events_handler_t)(const struct button_event *evt);
+
+/** @brief Initialize the button pipeline.
+ *
+ * Configures the sw0 button interrupt and starts the sender thread.
+ *
+ * @param[in] handler Callback for the coalesced button events.
+ *
+ * @retval 0 If the operation was successful.
+ *           Otherwise, a (negative) error code is returned.
+ */
+int button_events_init(button_events_handler_t handler);
+
+/** @brief Inject a button edge.
+ *
+ * Runs the interrupt path as if the button changed to @p pressed. From
+ * then on the debounce timer samples the injected level instead of the
+ * pin. Only available with CONFIG_APP_LATENCY_BENCH.
+ *
+ * @param[in] pressed Button state to inject.
+ */
+void button_events_inject(bool pressed);
+
+/** @brief Get the last debounced button state.
+ *
+ * Safe to call from any context.
+ *
+ * @return true if the button is pressed.
+ */
+bool button_events_state(void);
+
+/** @brief Record the latency of an event.
+ *
+ * Call when the notification for the event has been sent.
+ *
+ * @param[in] timestamp Timestamp of the event.
+ */
+void button_events_latency_record(uint32_t timestamp);
+
+/** @brief Get the latency statistics collected so far.
+ *
+ * @param[out] stats Latency statistics.
+ */
+void button_events_latency_get(struct button_latency *stats);
+
+#ifdef __cplusplus
+}
+#endif
+
+/**
+ * @}
+ */
+
+#endif /* BUTTON_EVENTS_H_ */
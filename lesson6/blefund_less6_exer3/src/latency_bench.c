@@ -0,0 +1,80 @@
+/*
+ * Copyright (c) 2023 Nordic Semiconductor ASA
+ *
+ * SPDX-License-Identifier: LicenseRef-Nordic-5-Clause
+ */
+
+/** @file
+ *  @brief Press-to-notification latency benchmark
+ */
+
+#include <zephyr/types.h>
+#include <errno.h>
+#include <zephyr/kernel.h>
+#include <zephyr/random/rand32.h>
+#include <zephyr/sys/byteorder.h>
+#include <zephyr/bluetooth/bluetooth.h>
+#include <zephyr/bluetooth/uuid.h>
+#include <zephyr/bluetooth/gatt.h>
+
+#include "latency_bench.h"
+
+#include <zephyr/logging/log.h>
+LOG_MODULE_REGISTER(latency_bench, LOG_LEVEL_INF);
+
+#define PERIOD_MS CONFIG_APP_LATENCY_BENCH_PERIOD_MS
+
+BUILD_ASSERT(PERIOD_MS > CONFIG_APP_BUTTON_DEBOUNCE_MS,
+	     "Injected edges must be further apart than the debounce window");
+
+static bool notify_enabled;
+static bool inject_level;
+static uint32_t seq;
+
+static void inject_work_handler(struct k_work *work);
+
+static K_WORK_DELAYABLE_DEFINE(inject_work, inject_work_handler);
+
+/* Runs in thread context, the entropy driver may not be usable from an ISR. */
+static void inject_work_handler(struct k_work *work)
+{
+	inject_level = !inject_level;
+	button_events_inject(inject_level);
+
+	/* Random phase so the edges sample the whole connection interval. */
+	k_work_reschedule(&inject_work, K_MSEC(PERIOD_MS + sys_rand32_get() % PERIOD_MS));
+}
+
+static void bench_ccc_cfg_changed(const struct bt_gatt_attr *attr, uint16_t value)
+{
+	notify_enabled = (value == BT_GATT_CCC_NOTIFY);
+
+	if (notify_enabled) {
+		LOG_INF("Injecting button edges every %u-%u ms", PERIOD_MS, 2 * PERIOD_MS - 1);
+		k_work_reschedule(&inject_work, K_MSEC(PERIOD_MS));
+	} else {
+		k_work_cancel_delayable(&inject_work);
+	}
+}
+
+BT_GATT_SERVICE_DEFINE(bench_svc, BT_GATT_PRIMARY_SERVICE(BT_UUID_LATENCY_BENCH),
+		       BT_GATT_CHARACTERISTIC(BT_UUID_LATENCY_BENCH_EDGE, BT_GATT_CHRC_NOTIFY,
+					      BT_GATT_PERM_NONE, NULL, NULL, NULL),
+		       BT_GATT_CCC(bench_ccc_cfg_changed, BT_GATT_PERM_READ | BT_GATT_PERM_WRITE), );
+
+int latency_bench_report(const struct button_event *evt)
+{
+	uint32_t now_us = (uint32_t)k_ticks_to_us_floor64(k_uptime_ticks());
+	uint32_t age_us = k_cyc_to_us_floor32(k_cycle_get_32() - evt->timestamp);
+	struct latency_bench_edge edge = {
+		.seq = sys_cpu_to_le32(seq++),
+		.edge_us = sys_cpu_to_le32(now_us - age_us),
+		.pressed = evt->pressed,
+	};
+
+	if (!notify_enabled) {
+		return -EACCES;
+	}
+
+	return bt_gatt_notify(NULL, &bench_svc.attrs[2], &edge, sizeof(edge));
+}
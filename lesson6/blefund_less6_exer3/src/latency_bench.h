@@ -0,0 +1,67 @@
+/*
+ * Copyright (c) 2023 Nordic Semiconductor ASA
+ *
+ * SPDX-License-Identifier: LicenseRef-Nordic-5-Clause
+ */
+
+#ifndef LATENCY_BENCH_H_
+#define LATENCY_BENCH_H_
+
+/**@file
+ * @defgroup latency_bench Press-to-notification latency benchmark
+ * @{
+ * @brief Injects button edges and notifies their timestamps.
+ *
+ * While a peer is subscribed, button edges are injected into the button
+ * pipeline at a jittered period. Every resulting event is notified on the
+ * benchmark characteristic together with the uptime of its first edge,
+ * so a central sharing the same time base (for example a second device in
+ * the same nrf52_bsim simulation) can compute the end-to-end latency.
+ */
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <zephyr/types.h>
+#include "button_events.h"
+
+/** @brief Latency Benchmark Service UUID. */
+#define BT_UUID_LATENCY_BENCH_VAL                                                                  \
+	BT_UUID_128_ENCODE(0x00001530, 0x1212, 0xefde, 0x1523, 0x785feabcd123)
+
+/** @brief Edge Characteristic UUID. */
+#define BT_UUID_LATENCY_BENCH_EDGE_VAL                                                             \
+	BT_UUID_128_ENCODE(0x00001531, 0x1212, 0xefde, 0x1523, 0x785feabcd123)
+
+#define BT_UUID_LATENCY_BENCH BT_UUID_DECLARE_128(BT_UUID_LATENCY_BENCH_VAL)
+#define BT_UUID_LATENCY_BENCH_EDGE BT_UUID_DECLARE_128(BT_UUID_LATENCY_BENCH_EDGE_VAL)
+
+/** @brief Payload of the Edge Characteristic, little-endian. */
+struct latency_bench_edge {
+	/** Sequence number of the event. */
+	uint32_t seq;
+	/** Uptime of the first edge of the event, in microseconds. */
+	uint32_t edge_us;
+	/** Button state after the event. */
+	uint8_t pressed;
+} __packed;
+
+/** @brief Notify a button event on the Edge Characteristic.
+ *
+ * @param[in] evt Debounced button event.
+ *
+ * @retval 0 If the operation was successful.
+ *           Otherwise, a (negative) error code is returned.
+ */
+int latency_bench_report(const struct button_event *evt);
+
+#ifdef __cplusplus
+}
+#endif
+
+/**
+ * @}
+ */
+
+#endif /* LATENCY_BENCH_H_ */
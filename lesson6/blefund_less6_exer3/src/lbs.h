@@ -18,6 +18,7 @@ extern "C" {
 #endif
 
 #include <zephyr/types.h>
+#include <zephyr/bluetooth/gatt.h>
 
 /** @brief LBS Service UUID. */
 #define BT_UUID_LBS_VAL BT_UUID_128_ENCODE(0x00001523, 0x1212, 0xefde, 0x1523, 0x785feabcd123)
@@ -29,9 +30,14 @@ extern "C" {
 /** @brief LED Characteristic UUID. */
 #define BT_UUID_LBS_LED_VAL BT_UUID_128_ENCODE(0x00001525, 0x1212, 0xefde, 0x1523, 0x785feabcd123)
 
+/** @brief Configuration Characteristic UUID. */
+#define BT_UUID_LBS_CONFIG_VAL                                                                     \
+	BT_UUID_128_ENCODE(0x00001526, 0x1212, 0xefde, 0x1523, 0x785feabcd123)
+
 #define BT_UUID_LBS BT_UUID_DECLARE_128(BT_UUID_LBS_VAL)
 #define BT_UUID_LBS_BUTTON BT_UUID_DECLARE_128(BT_UUID_LBS_BUTTON_VAL)
 #define BT_UUID_LBS_LED BT_UUID_DECLARE_128(BT_UUID_LBS_LED_VAL)
+#define BT_UUID_LBS_CONFIG BT_UUID_DECLARE_128(BT_UUID_LBS_CONFIG_VAL)
 
 /** @brief Callback type for when an LED state change is received. */
 typedef void (*led_cb_t)(const bool led_state);
@@ -39,22 +45,38 @@ typedef void (*led_cb_t)(const bool led_state);
 /** @brief Callback type for when the button state is pulled. */
 typedef bool (*button_cb_t)(void);
 
+/** @brief Callback type for when configuration data is received.
+ *
+ * Called with the configuration reassembled so far. A queue of prepared
+ * writes that the host delivers in several segments gives one call per
+ * segment, the last one with the complete configuration.
+ */
+typedef void (*config_cb_t)(const uint8_t *data, uint16_t len);
+
 /** @brief Callback struct used by the LBS Service. */
 struct bt_lbs_cb {
 	/** LED state change callback. */
 	led_cb_t led_cb;
 	/** Button read callback. */
 	button_cb_t button_cb;
+	/** Configuration write callback. */
+	config_cb_t config_cb;
 };
 
 /** @brief Initialize the LBS Service.
  *
- * This function registers a GATT service with two characteristics: Button
- * and LED.
+ * This function registers a GATT service with three characteristics: Button,
+ * LED and Configuration.
  * Send notifications for the Button Characteristic to let connected peers know
  * when the button state changes.
  * Write to the LED Characteristic to change the state of the LED on the
- * board.
+ * board. With CONFIG_BT_LBS_LED_WRITE_WITHOUT_RESP the LED Characteristic
+ * also takes writes without response, optionally followed by a one byte
+ * sequence number; a write repeating the previous sequence number is
+ * dropped.
+ * Write to the Configuration Characteristic, with long or prepared writes
+ * if needed, to pass up to CONFIG_BT_LBS_CONFIG_MAX_LEN bytes to the
+ * application.
  *
  * @param[in] callbacks Struct containing pointers to callback functions
  *			used by the service. This pointer can be NULL
@@ -78,6 +100,28 @@ int bt_lbs_init(struct bt_lbs_cb *callbacks);
  */
 int bt_lbs_send_button_state(bool button_state);
 
+/** @brief Send the button state and report when it was sent.
+ *
+ * Same as bt_lbs_send_button_state(), but @p func is called once the
+ * notification has been transmitted to each connected peer.
+ *
+ * @param[in] button_state The state of the button.
+ * @param[in] func Transmission complete callback.
+ * @param[in] user_data Data passed to @p func.
+ *
+ * @retval 0 If the operation was successful.
+ *           Otherwise, a (negative) error code is returned.
+ */
+int bt_lbs_send_button_state_cb(bool button_state, bt_gatt_complete_func_t func, void *user_data);
+
+/** @brief Get the number of LED commands applied.
+ *
+ * Duplicate sequenced writes are not counted. The counter wraps around.
+ *
+ * @return Number of LED commands passed to the application since boot.
+ */
+uint32_t bt_lbs_led_write_count(void);
+
 #ifdef __cplusplus
 }
 #endif
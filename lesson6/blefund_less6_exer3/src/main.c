@@ -21,6 +21,8 @@
 #include <zephyr/bluetooth/gatt.h>
 
 #include "lbs.h"
+#include "button_events.h"
+#include "latency_bench.h"
 
 #include <zephyr/settings/settings.h>
 
@@ -35,10 +37,6 @@
 
 #define USER_LED DK_LED3
 
-#define USER_BUTTON DK_BTN1_MSK
-
-static bool app_button_state;
-
 static const struct bt_data ad[] = {
 	BT_DATA_BYTES(BT_DATA_FLAGS, (BT_LE_AD_GENERAL | BT_LE_AD_NO_BREDR)),
 	BT_DATA(BT_DATA_NAME_COMPLETE, DEVICE_NAME, DEVICE_NAME_LEN),
@@ -115,21 +113,32 @@ static void app_led_cb(bool led_state)
 
 static bool app_button_cb(void)
 {
-	return app_button_state;
+	return button_events_state();
+}
+
+static void app_config_cb(const uint8_t *data, uint16_t len)
+{
+	printk("Configuration received (%u bytes)\n", len);
 }
 
 static struct bt_lbs_cb lbs_callbacs = {
 	.led_cb = app_led_cb,
 	.button_cb = app_button_cb,
+	.config_cb = app_config_cb,
 };
 
-static void button_changed(uint32_t button_state, uint32_t has_changed)
+static void button_notify_sent(struct bt_conn *conn, void *user_data)
 {
-	if (has_changed & USER_BUTTON) {
-		uint32_t user_button_state = button_state & USER_BUTTON;
+	button_events_latency_record(POINTER_TO_UINT(user_data));
+}
+
+static void button_changed(const struct button_event *evt)
+{
+	bt_lbs_send_button_state_cb(evt->pressed, button_notify_sent,
+				    UINT_TO_POINTER(evt->timestamp));
 
-		bt_lbs_send_button_state(user_button_state);
-		app_button_state = user_button_state ? true : false;
+	if (IS_ENABLED(CONFIG_APP_LATENCY_BENCH)) {
+		latency_bench_report(evt);
 	}
 }
 
@@ -137,7 +146,7 @@ static int init_button(void)
 {
 	int err;
 
-	err = dk_buttons_init(button_changed);
+	err = button_events_init(button_changed);
 	if (err) {
 		printk("Cannot init buttons (err: %d)\n", err);
 	}
@@ -148,6 +157,10 @@ static int init_button(void)
 void main(void)
 {
 	int blink_status = 0;
+	uint32_t last_led_writes = 0;
+	uint32_t led_writes;
+	uint32_t last_latency_count = 0;
+	struct button_latency latency;
 	int err;
 
 	printk("Starting Bluetooth Peripheral LBS example\n");
@@ -195,5 +208,19 @@ void main(void)
 	for (;;) {
 		dk_set_led(RUN_STATUS_LED, (++blink_status) % 2);
 		k_sleep(K_MSEC(RUN_LED_BLINK_INTERVAL));
+
+		led_writes = bt_lbs_led_write_count();
+		if (led_writes != last_led_writes) {
+			printk("LED commands: %u/s\n",
+			       (led_writes - last_led_writes) * MSEC_PER_SEC / RUN_LED_BLINK_INTERVAL);
+			last_led_writes = led_writes;
+		}
+
+		button_events_latency_get(&latency);
+		if (latency.count != last_latency_count) {
+			printk("Press-to-notification latency: n %u, min %u us, avg %u us, max %u us\n",
+			       latency.count, latency.min_us, latency.avg_us, latency.max_us);
+			last_latency_count = latency.count;
+		}
 	}
 }
@@ -0,0 +1,39 @@
+#!/usr/bin/env bash
+#
+# Copyright (c) 2023 Nordic Semiconductor ASA
+#
+# SPDX-License-Identifier: LicenseRef-Nordic-5-Clause
+#
+# Measures the press-to-notification latency in nrf52_bsim. Runs
+# lesson6_exer3 with the latency benchmark against this central, once for
+# every connection setting below. All devices of a simulation boot at the
+# same simulated time, so the uptimes of the two devices share a time base.
+#
+# Usage: bsim_run.sh [variant...], all variants if none is given.
+
+APP_DIR="$(cd "$(dirname "$0")" && pwd)"
+source "${APP_DIR}/../../scripts/bsim_common.sh"
+
+# Long enough for a few reports of CONFIG_APP_SAMPLES edges each
+SIM_LENGTH_S=120
+
+declare -A VARIANTS=(
+	[int_7_5ms]="-DCONFIG_APP_CONN_INTERVAL=6"
+	[int_30ms]="-DCONFIG_APP_CONN_INTERVAL=24"
+	[int_100ms]="-DCONFIG_APP_CONN_INTERVAL=80"
+	[int_1s]="-DCONFIG_APP_CONN_INTERVAL=800"
+	[int_30ms_latency_4]="-DCONFIG_APP_CONN_INTERVAL=24 -DCONFIG_APP_CONN_LATENCY=4"
+	[int_30ms_1m]="-DCONFIG_APP_CONN_INTERVAL=24 -DCONFIG_APP_PHY_1M=y"
+	[int_30ms_coded]="-DCONFIG_APP_CONN_INTERVAL=24 -DCONFIG_APP_PHY_CODED=y -DCONFIG_BT_CTLR_PHY_CODED=y"
+)
+ORDER="int_7_5ms int_30ms int_100ms int_1s int_30ms_latency_4 int_30ms_1m int_30ms_coded"
+
+peripheral=$(bsim_build latency_peripheral "${APP_DIR}/../blefund_less6_exer3" \
+	-DCONFIG_APP_LATENCY_BENCH=y)
+
+for variant in ${@:-${ORDER}}; do
+	echo "=== ${variant} ==="
+	# shellcheck disable=SC2086
+	central=$(bsim_build "latency_central_${variant}" "${APP_DIR}" ${VARIANTS[${variant}]})
+	bsim_run "latency_${variant}" "${SIM_LENGTH_S}" "${peripheral}" "${central}"
+done
@@ -0,0 +1,373 @@
+/*
+ * Copyright (c) 2023 Nordic Semiconductor ASA
+ *
+ * SPDX-License-Identifier: LicenseRef-Nordic-5-Clause
+ */
+
+/** @file
+ *  @brief Central that measures press-to-notification latency
+ *
+ * Connects to lesson6_exer3 built with CONFIG_APP_LATENCY_BENCH, subscribes
+ * to its edge characteristic and compares the edge uptime carried in each
+ * notification with its own uptime on arrival. The two uptimes only share
+ * a time base when both devices start together, as in the nrf52_bsim
+ * simulation of bsim_run.sh.
+ */
+
+#include <errno.h>
+#include <string.h>
+#include <zephyr/kernel.h>
+#include <zephyr/logging/log.h>
+#include <zephyr/sys/byteorder.h>
+#include <zephyr/bluetooth/bluetooth.h>
+#include <zephyr/bluetooth/gap.h>
+#include <zephyr/bluetooth/gatt.h>
+#include <zephyr/bluetooth/uuid.h>
+#include <zephyr/bluetooth/conn.h>
+
+#include "conn_time.h"
+
+LOG_MODULE_REGISTER(Lesson6_Latency_Central, LOG_LEVEL_INF);
+
+/* Edge Characteristic of the Latency Benchmark Service */
+#define BT_UUID_LATENCY_BENCH_EDGE_VAL                                                             \
+	BT_UUID_128_ENCODE(0x00001531, 0x1212, 0xefde, 0x1523, 0x785feabcd123)
+
+#define EDGE_LEN 9 /* seq (4), edge uptime (4), button state (1) */
+
+#define HIST_BUCKETS CONFIG_APP_HIST_BUCKETS
+#define HIST_BUCKET_US (CONFIG_APP_HIST_BUCKET_MS * USEC_PER_MSEC)
+
+#if defined(CONFIG_APP_PHY_1M)
+#define APP_PHY BT_GAP_LE_PHY_1M
+#define APP_PHY_OPT BT_CONN_LE_PHY_OPT_NONE
+#elif defined(CONFIG_APP_PHY_CODED)
+#define APP_PHY BT_GAP_LE_PHY_CODED
+#define APP_PHY_OPT BT_CONN_LE_PHY_OPT_CODED_S8
+#else
+#define APP_PHY BT_GAP_LE_PHY_2M
+#define APP_PHY_OPT BT_CONN_LE_PHY_OPT_NONE
+#endif
+
+static struct bt_le_conn_param *conn_param =
+	BT_LE_CONN_PARAM(CONFIG_APP_CONN_INTERVAL, CONFIG_APP_CONN_INTERVAL,
+			 CONFIG_APP_CONN_LATENCY, CONFIG_APP_CONN_TIMEOUT);
+
+static struct bt_conn *my_conn;
+
+static struct bt_uuid_128 edge_uuid = BT_UUID_INIT_128(BT_UUID_LATENCY_BENCH_EDGE_VAL);
+static struct bt_uuid_16 ccc_uuid = BT_UUID_INIT_16(BT_UUID_GATT_CCC_VAL);
+static struct bt_gatt_discover_params discover_params;
+static struct bt_gatt_subscribe_params subscribe_params;
+
+/* Latency distribution of the current report */
+static uint32_t hist[HIST_BUCKETS + 1];
+static uint32_t samples;
+static uint32_t lost;
+/* Sequence number tracking of the connection, kept across reports */
+static bool seq_valid;
+static uint32_t next_seq;
+static uint32_t lat_min_us;
+static uint32_t lat_max_us;
+static uint64_t lat_sum_us;
+
+static void scan_start(void);
+
+static const char *phy_name(uint8_t phy)
+{
+	switch (phy) {
+	case BT_GAP_LE_PHY_1M:
+		return "1M";
+	case BT_GAP_LE_PHY_2M:
+		return "2M";
+	case BT_GAP_LE_PHY_CODED:
+		return "Coded";
+	default:
+		return "?";
+	}
+}
+
+/* Upper bound of the bucket holding the given percentile */
+static uint32_t hist_percentile_ms(uint32_t percent)
+{
+	uint32_t target = DIV_ROUND_UP(samples * percent, 100);
+	uint32_t sum = 0;
+
+	for (int i = 0; i <= HIST_BUCKETS; i++) {
+		sum += hist[i];
+		if (sum >= target) {
+			return (i + 1) * CONFIG_APP_HIST_BUCKET_MS;
+		}
+	}
+
+	return (HIST_BUCKETS + 1) * CONFIG_APP_HIST_BUCKET_MS;
+}
+
+static void report(struct bt_conn *conn)
+{
+	struct bt_conn_info info;
+	int err;
+
+	err = bt_conn_get_info(conn, &info);
+	if (err) {
+		LOG_ERR("bt_conn_get_info() returned %d", err);
+		return;
+	}
+
+	LOG_INF("Interval " CONN_TIME_FMT ", latency %u, timeout %u ms, PHY %s",
+		CONN_TIME_ARGS(CONN_TIME_INTERVAL_US(info.le.interval)), info.le.latency,
+		info.le.timeout * 10U, phy_name(info.le.phy->tx_phy));
+	LOG_INF("Samples %u, lost %u, min %u us, avg %u us, max %u us", samples, lost, lat_min_us,
+		(uint32_t)(lat_sum_us / samples), lat_max_us);
+	LOG_INF("Percentiles: p50 < %u ms, p90 < %u ms, p99 < %u ms", hist_percentile_ms(50),
+		hist_percentile_ms(90), hist_percentile_ms(99));
+
+	for (int i = 0; i < HIST_BUCKETS; i++) {
+		if (hist[i]) {
+			LOG_INF("  %4u - %4u ms: %u", i * CONFIG_APP_HIST_BUCKET_MS,
+				(i + 1) * CONFIG_APP_HIST_BUCKET_MS, hist[i]);
+		}
+	}
+	if (hist[HIST_BUCKETS]) {
+		LOG_INF("  >= %4u ms: %u", HIST_BUCKETS * CONFIG_APP_HIST_BUCKET_MS,
+			hist[HIST_BUCKETS]);
+	}
+
+	memset(hist, 0, sizeof(hist));
+	samples = 0;
+	lost = 0;
+	lat_sum_us = 0;
+}
+
+static uint8_t notify_func(struct bt_conn *conn, struct bt_gatt_subscribe_params *params,
+			   const void *data, uint16_t length)
+{
+	uint32_t now_us = (uint32_t)k_ticks_to_us_floor64(k_uptime_ticks());
+	uint32_t seq;
+	uint32_t lat_us;
+
+	if (!data) {
+		LOG_INF("Unsubscribed");
+		params->value_handle = 0;
+		return BT_GATT_ITER_STOP;
+	}
+
+	if (length < EDGE_LEN) {
+		LOG_WRN("Unexpected notification length %u", length);
+		return BT_GATT_ITER_CONTINUE;
+	}
+
+	seq = sys_get_le32(data);
+	lat_us = now_us - sys_get_le32((const uint8_t *)data + 4);
+
+	if (seq_valid && seq != next_seq) {
+		lost += seq - next_seq;
+	}
+	next_seq = seq + 1;
+	seq_valid = true;
+
+	if (samples == 0 || lat_us < lat_min_us) {
+		lat_min_us = lat_us;
+	}
+	if (samples == 0 || lat_us > lat_max_us) {
+		lat_max_us = lat_us;
+	}
+	lat_sum_us += lat_us;
+	hist[MIN(lat_us / HIST_BUCKET_US, HIST_BUCKETS)]++;
+
+	if (++samples == CONFIG_APP_SAMPLES) {
+		report(conn);
+	}
+
+	return BT_GATT_ITER_CONTINUE;
+}
+
+static uint8_t discover_func(struct bt_conn *conn, const struct bt_gatt_attr *attr,
+			     struct bt_gatt_discover_params *params)
+{
+	int err;
+
+	if (!attr) {
+		LOG_ERR("Latency benchmark characteristic not found");
+		memset(params, 0, sizeof(*params));
+		return BT_GATT_ITER_STOP;
+	}
+
+	if (params->type == BT_GATT_DISCOVER_CHARACTERISTIC) {
+		struct bt_gatt_chrc *chrc = attr->user_data;
+
+		subscribe_params.value_handle = chrc->value_handle;
+
+		params->uuid = &ccc_uuid.uuid;
+		params->start_handle = chrc->value_handle + 1;
+		params->type = BT_GATT_DISCOVER_DESCRIPTOR;
+
+		err = bt_gatt_discover(conn, params);
+		if (err) {
+			LOG_ERR("CCC discovery failed (err %d)", err);
+		}
+
+		return BT_GATT_ITER_STOP;
+	}
+
+	subscribe_params.ccc_handle = attr->handle;
+	subscribe_params.notify = notify_func;
+	subscribe_params.value = BT_GATT_CCC_NOTIFY;
+
+	err = bt_gatt_subscribe(conn, &subscribe_params);
+	if (err && err != -EALREADY) {
+		LOG_ERR("Subscribe failed (err %d)", err);
+	} else {
+		LOG_INF("Subscribed, collecting %u samples per report", CONFIG_APP_SAMPLES);
+	}
+
+	return BT_GATT_ITER_STOP;
+}
+
+static void discover_edge(struct bt_conn *conn)
+{
+	int err;
+
+	discover_params.uuid = &edge_uuid.uuid;
+	discover_params.func = discover_func;
+	discover_params.start_handle = BT_ATT_FIRST_ATTRIBUTE_HANDLE;
+	discover_params.end_handle = BT_ATT_LAST_ATTRIBUTE_HANDLE;
+	discover_params.type = BT_GATT_DISCOVER_CHARACTERISTIC;
+
+	err = bt_gatt_discover(conn, &discover_params);
+	if (err) {
+		LOG_ERR("Discovery failed (err %d)", err);
+	}
+}
+
+static void update_phy(struct bt_conn *conn)
+{
+	int err;
+	const struct bt_conn_le_phy_param preferred_phy = {
+		.options = APP_PHY_OPT,
+		.pref_rx_phy = APP_PHY,
+		.pref_tx_phy = APP_PHY,
+	};
+
+	err = bt_conn_le_phy_update(conn, &preferred_phy);
+	if (err) {
+		LOG_ERR("bt_conn_le_phy_update() returned %d", err);
+	}
+}
+
+static bool name_matches(struct bt_data *data, void *user_data)
+{
+	bool *found = user_data;
+
+	if (data->type == BT_DATA_NAME_COMPLETE &&
+	    data->data_len == sizeof(CONFIG_APP_PEER_NAME) - 1 &&
+	    memcmp(data->data, CONFIG_APP_PEER_NAME, data->data_len) == 0) {
+		*found = true;
+		return false;
+	}
+
+	return true;
+}
+
+static void device_found(const bt_addr_le_t *addr, int8_t rssi, uint8_t type,
+			 struct net_buf_simple *ad)
+{
+	bool found = false;
+	int err;
+
+	if (type != BT_GAP_ADV_TYPE_ADV_IND) {
+		return;
+	}
+
+	bt_data_parse(ad, name_matches, &found);
+	if (!found) {
+		return;
+	}
+
+	err = bt_le_scan_stop();
+	if (err) {
+		LOG_ERR("Stop LE scan failed (err %d)", err);
+		return;
+	}
+
+	err = bt_conn_le_create(addr, BT_CONN_LE_CREATE_CONN, conn_param, &my_conn);
+	if (err) {
+		LOG_ERR("Create connection failed (err %d)", err);
+		scan_start();
+	}
+}
+
+static void scan_start(void)
+{
+	int err;
+
+	err = bt_le_scan_start(BT_LE_SCAN_PASSIVE, device_found);
+	if (err) {
+		LOG_ERR("Scanning failed to start (err %d)", err);
+		return;
+	}
+
+	LOG_INF("Scanning for %s", CONFIG_APP_PEER_NAME);
+}
+
+/* Callbacks */
+void on_connected(struct bt_conn *conn, uint8_t err)
+{
+	if (err) {
+		LOG_ERR("Connection error %d", err);
+		bt_conn_unref(my_conn);
+		my_conn = NULL;
+		scan_start();
+		return;
+	}
+
+	LOG_INF("Connected");
+	samples = 0;
+	/* The peripheral numbers its edges also while nobody is subscribed. */
+	seq_valid = false;
+
+	update_phy(conn);
+	discover_edge(conn);
+}
+
+void on_disconnected(struct bt_conn *conn, uint8_t reason)
+{
+	LOG_INF("Disconnected. Reason %d", reason);
+
+	if (samples) {
+		report(conn);
+	}
+
+	bt_conn_unref(my_conn);
+	my_conn = NULL;
+	scan_start();
+}
+
+void on_le_phy_updated(struct bt_conn *conn, struct bt_conn_le_phy_info *param)
+{
+	LOG_INF("PHY updated. New PHY: %s", phy_name(param->tx_phy));
+}
+
+struct bt_conn_cb connection_callbacks = {
+	.connected = on_connected,
+	.disconnected = on_disconnected,
+	.le_phy_updated = on_le_phy_updated,
+};
+
+void main(void)
+{
+	int err;
+
+	LOG_INF("Starting Lesson 6 - Latency central\n");
+
+	bt_conn_cb_register(&connection_callbacks);
+
+	err = bt_enable(NULL);
+	if (err) {
+		LOG_ERR("Bluetooth init failed (err %d)", err);
+		return;
+	}
+
+	LOG_INF("Bluetooth initialized");
+	scan_start();
+}
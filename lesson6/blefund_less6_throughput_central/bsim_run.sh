@@ -0,0 +1,80 @@
+#!/usr/bin/env bash
+#
+# Copyright (c) 2023 Nordic Semiconductor ASA
+#
+# SPDX-License-Identifier: LicenseRef-Nordic-5-Clause
+#
+# Measures the GATT throughput in nrf52_bsim. Runs lesson6_exer2 with the
+# bulk service against this central, once for every pair of builds below.
+# The first round only starts after the warm-up, so the numbers do not
+# depend on how long the link setup took.
+#
+# bulk-2m is the baseline: the bulk service with the default configuration
+# of lesson6_exer2. The other runs are listed against it at the end.
+#
+# Usage: bsim_run.sh [run...], all runs if none is given.
+
+APP_DIR="$(cd "$(dirname "$0")" && pwd)"
+source "${APP_DIR}/../../scripts/bsim_common.sh"
+
+# Keep the result of the simulation when its output is logged
+set -o pipefail
+
+PERIPHERAL_DIR="${APP_DIR}/../blefund_less6_exer2"
+
+# Warm-up and CONFIG_APP_TEST_ROUNDS rounds, with margin
+SIM_LENGTH_S=60
+
+declare -A PERIPHERALS=(
+	[bulk]="-DCONFIG_APP_BULK_SVC=y"
+	[pdu_align_off]="-DCONFIG_APP_BULK_SVC=y -DCONFIG_APP_BULK_SVC_PDU_ALIGN=n"
+	[max_throughput]="-DOVERLAY_CONFIG=overlay-max-throughput.conf"
+)
+declare -A CENTRALS=(
+	[2m]="-DCONFIG_APP_PHY_2M=y"
+	[dle_27]="-DCONFIG_APP_DATA_LEN=27 -DCONFIG_BT_CTLR_DATA_LENGTH_MAX=27"
+)
+# <peripheral>-<central>
+ORDER="bulk-2m bulk-dle_27 pdu_align_off-dle_27 max_throughput-2m"
+BASELINE="bulk-2m"
+
+# avg_kbps <log> <Write|Notify>
+avg_kbps() {
+	sed -n "s/^d_1: .*$2: \([0-9]*\) kbps avg.*/\1/p" "$1" | tail -n 1
+}
+
+# Prints the rate of a direction and how it compares to the baseline
+kbps_summary() {
+	local kbps base
+
+	kbps=$(avg_kbps "${BSIM_BUILD_DIR}/tput_$1.log" "$2")
+	base=$(avg_kbps "${BSIM_BUILD_DIR}/tput_${BASELINE}.log" "$2")
+
+	if [ -z "${kbps}" ]; then
+		printf "%13s" "-"
+	elif [ -z "${base}" ] || [ "${base}" -eq 0 ]; then
+		printf "%13s" "${kbps}"
+	else
+		printf "%6s (%3s%%)" "${kbps}" "$((kbps * 100 / base))"
+	fi
+}
+
+for run in ${@:-${ORDER}}; do
+	p=${run%%-*}
+	c=${run#*-}
+
+	echo "=== ${run} ==="
+	# shellcheck disable=SC2086
+	peripheral=$(bsim_build "tput_peripheral_${p}" "${PERIPHERAL_DIR}" ${PERIPHERALS[${p}]})
+	# shellcheck disable=SC2086
+	central=$(bsim_build "tput_central_${c}" "${APP_DIR}" ${CENTRALS[${c}]})
+	bsim_run "tput_${run//-/_}" "${SIM_LENGTH_S}" "${peripheral}" "${central}" |
+		tee "${BSIM_BUILD_DIR}/tput_${run}.log"
+done
+
+echo "=== kbps, average of the rounds, against ${BASELINE} ==="
+printf "%-24s %13s %13s\n" "run" "write" "notify"
+for run in ${@:-${ORDER}}; do
+	printf "%-24s %s %s\n" "${run}" "$(kbps_summary "${run}" Write)" \
+		"$(kbps_summary "${run}" Notify)"
+done
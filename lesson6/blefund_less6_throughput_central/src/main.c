@@ -0,0 +1,683 @@
+/*
+ * Copyright (c) 2023 Nordic Semiconductor ASA
+ *
+ * SPDX-License-Identifier: LicenseRef-Nordic-5-Clause
+ */
+
+/** @file
+ *  @brief Central that measures GATT throughput
+ *
+ * Connects to lesson6_exer2 built with CONFIG_APP_BULK_SVC, for example with
+ * overlay-max-throughput.conf, and negotiates the PHY, data length and ATT
+ * MTU. Then it subscribes to the TX characteristic of the Bulk Service and,
+ * once the peripheral is done with its own link setup, writes without
+ * response to its RX characteristic for a number of test rounds, and
+ * reports the throughput of each direction. After every round
+ * the RX count of the peripheral is read back to check that all writes
+ * arrived.
+ */
+
+#include <errno.h>
+#include <string.h>
+#include <zephyr/kernel.h>
+#include <zephyr/logging/log.h>
+#include <zephyr/sys/atomic.h>
+#include <zephyr/sys/byteorder.h>
+#include <zephyr/bluetooth/bluetooth.h>
+#include <zephyr/bluetooth/gap.h>
+#include <zephyr/bluetooth/gatt.h>
+#include <zephyr/bluetooth/uuid.h>
+#include <zephyr/bluetooth/conn.h>
+
+#include "bulk_svc.h"
+#include "conn_time.h"
+
+LOG_MODULE_REGISTER(Lesson6_Throughput_Central, LOG_LEVEL_INF);
+
+#define WRITE_LEN_MAX (CONFIG_BT_L2CAP_TX_MTU - 3)
+#define TX_WINDOW CONFIG_APP_TX_WINDOW
+#define ROUND_MS (CONFIG_APP_TEST_DURATION_S * MSEC_PER_SEC)
+/* Link setup timeout of lesson6_exer2, with margin */
+#define PEER_SETUP_MS 6000
+
+#define TEST_NOTIFY (!IS_ENABLED(CONFIG_APP_DIR_TO_PERIPHERAL))
+#define TEST_WRITE (!IS_ENABLED(CONFIG_APP_DIR_TO_CENTRAL))
+
+#define TEST_STACK_SIZE 1024
+#define TEST_PRIORITY 7
+
+#if defined(CONFIG_APP_PHY_1M)
+#define APP_PHY BT_GAP_LE_PHY_1M
+#define APP_PHY_OPT BT_CONN_LE_PHY_OPT_NONE
+#elif defined(CONFIG_APP_PHY_CODED)
+#define APP_PHY BT_GAP_LE_PHY_CODED
+#define APP_PHY_OPT BT_CONN_LE_PHY_OPT_CODED_S8
+#else
+#define APP_PHY BT_GAP_LE_PHY_2M
+#define APP_PHY_OPT BT_CONN_LE_PHY_OPT_NONE
+#endif
+
+static struct bt_le_conn_param *conn_param = BT_LE_CONN_PARAM(
+	CONFIG_APP_CONN_INTERVAL, CONFIG_APP_CONN_INTERVAL, 0, CONFIG_APP_CONN_TIMEOUT);
+
+static struct bt_conn *my_conn;
+
+static struct bt_uuid_128 tx_uuid = BT_UUID_INIT_128(BT_UUID_BULK_TX_VAL);
+static struct bt_uuid_128 rx_uuid = BT_UUID_INIT_128(BT_UUID_BULK_RX_VAL);
+static struct bt_uuid_128 rx_count_uuid = BT_UUID_INIT_128(BT_UUID_BULK_RX_COUNT_VAL);
+static struct bt_uuid_16 ccc_uuid = BT_UUID_INIT_16(BT_UUID_GATT_CCC_VAL);
+static struct bt_gatt_exchange_params exchange_params;
+static struct bt_gatt_discover_params discover_params;
+static struct bt_gatt_subscribe_params subscribe_params;
+static struct bt_gatt_read_params read_params;
+
+static uint16_t rx_handle;
+static uint16_t rx_count_handle;
+
+static uint8_t tx_data[WRITE_LEN_MAX];
+
+/* Traffic of the current round */
+static atomic_t tx_bytes;
+static atomic_t rx_bytes;
+static atomic_t rx_notifications;
+/* Changed on every disconnection, ends the test of the connection */
+static atomic_t conn_gen;
+
+struct test_req {
+	/* Referenced connection to test */
+	struct bt_conn *conn;
+	atomic_val_t gen;
+};
+
+/* Only used by the test thread */
+static uint32_t tx_total;
+static uint32_t peer_rx_total;
+static int peer_rx_err;
+
+K_MSGQ_DEFINE(start_msgq, sizeof(struct test_req), 1, 4);
+static K_SEM_DEFINE(read_sem, 0, 1);
+/* Writes in flight */
+static K_SEM_DEFINE(tx_sem, TX_WINDOW, TX_WINDOW);
+
+static void scan_start(void);
+
+static const char *phy_name(uint8_t phy)
+{
+	switch (phy) {
+	case BT_GAP_LE_PHY_1M:
+		return "1M";
+	case BT_GAP_LE_PHY_2M:
+		return "2M";
+	case BT_GAP_LE_PHY_CODED:
+		return "Coded";
+	default:
+		return "?";
+	}
+}
+
+static void link_log(struct bt_conn *conn)
+{
+	struct bt_conn_info info;
+	int err;
+
+	err = bt_conn_get_info(conn, &info);
+	if (err) {
+		LOG_ERR("bt_conn_get_info() returned %d", err);
+		return;
+	}
+
+	LOG_INF("Interval " CONN_TIME_FMT ", timeout %u ms, PHY %s, data length %u/%u, MTU %u",
+		CONN_TIME_ARGS(CONN_TIME_INTERVAL_US(info.le.interval)), info.le.timeout * 10U,
+		phy_name(info.le.phy->tx_phy), info.le.data_len->tx_max_len,
+		info.le.data_len->rx_max_len, bt_gatt_get_mtu(conn));
+}
+
+static void write_done(struct bt_conn *conn, void *user_data)
+{
+	atomic_add(&tx_bytes, POINTER_TO_UINT(user_data));
+	k_sem_give(&tx_sem);
+}
+
+static uint8_t rx_count_read_func(struct bt_conn *conn, uint8_t err,
+				  struct bt_gatt_read_params *params, const void *data,
+				  uint16_t length)
+{
+	if (err) {
+		peer_rx_err = -EIO;
+	} else if (!data || length != sizeof(uint32_t)) {
+		peer_rx_err = -EINVAL;
+	} else {
+		peer_rx_total = sys_get_le32(data);
+		peer_rx_err = 0;
+	}
+
+	k_sem_give(&read_sem);
+
+	return BT_GATT_ITER_STOP;
+}
+
+static int peer_rx_count_read(struct bt_conn *conn)
+{
+	int err;
+
+	read_params.func = rx_count_read_func;
+	read_params.handle_count = 1;
+	read_params.single.handle = rx_count_handle;
+	read_params.single.offset = 0;
+
+	k_sem_reset(&read_sem);
+	err = bt_gatt_read(conn, &read_params);
+	if (err) {
+		return err;
+	}
+
+	/* The read fails with an error when the link is lost meanwhile. */
+	k_sem_take(&read_sem, K_FOREVER);
+
+	return peer_rx_err;
+}
+
+static uint16_t write_len(struct bt_conn *conn)
+{
+	uint16_t len = MIN(bt_gatt_get_mtu(conn) - 3, WRITE_LEN_MAX);
+
+	if (CONFIG_APP_WRITE_LEN) {
+		len = MIN(len, CONFIG_APP_WRITE_LEN);
+	}
+
+	return len;
+}
+
+/* Run a test round and get the throughput of both directions in kbit/s */
+static int round_run(struct bt_conn *conn, atomic_val_t gen, uint32_t *tx_kbps,
+		     uint32_t *rx_kbps)
+{
+	uint16_t len = write_len(conn);
+	uint32_t start;
+	uint32_t elapsed_ms;
+	uint32_t tx;
+	uint32_t rx;
+	int err;
+
+	link_log(conn);
+
+	atomic_clear(&tx_bytes);
+	atomic_clear(&rx_bytes);
+	atomic_clear(&rx_notifications);
+	start = k_uptime_get_32();
+
+	while (k_uptime_get_32() - start < ROUND_MS) {
+		if (atomic_get(&conn_gen) != gen) {
+			return -ENOTCONN;
+		}
+
+		if (!TEST_WRITE) {
+			k_sleep(K_MSEC(100));
+			continue;
+		}
+
+		if (k_sem_take(&tx_sem, K_MSEC(100))) {
+			continue;
+		}
+
+		err = bt_gatt_write_without_response_cb(conn, rx_handle, tx_data, len, false,
+							write_done, UINT_TO_POINTER(len));
+		if (err) {
+			k_sem_give(&tx_sem);
+			if (err == -ENOTCONN) {
+				return err;
+			}
+			/* Out of buffers, let the stack catch up. */
+			k_sleep(K_MSEC(10));
+		}
+	}
+
+	/* Writes still in flight belong to this round. */
+	for (int i = 0; i < TX_WINDOW; i++) {
+		if (k_sem_take(&tx_sem, K_MSEC(CONFIG_APP_CONN_TIMEOUT * 10))) {
+			return -ETIMEDOUT;
+		}
+	}
+	for (int i = 0; i < TX_WINDOW; i++) {
+		k_sem_give(&tx_sem);
+	}
+
+	elapsed_ms = MAX(k_uptime_get_32() - start, 1);
+	tx = atomic_get(&tx_bytes);
+	rx = atomic_get(&rx_bytes);
+	tx_total += tx;
+
+	/* Bytes per millisecond times 8 is kbit/s. */
+	*tx_kbps = (uint64_t)tx * 8 / elapsed_ms;
+	*rx_kbps = (uint64_t)rx * 8 / elapsed_ms;
+
+	LOG_INF("Write: %u kbps, %u bytes in %u byte writes", *tx_kbps, tx, len);
+	LOG_INF("Notify: %u kbps, %u bytes in %u notifications", *rx_kbps, rx,
+		(uint32_t)atomic_get(&rx_notifications));
+
+	if (TEST_WRITE) {
+		err = peer_rx_count_read(conn);
+		if (err) {
+			LOG_WRN("RX count read failed (err %d)", err);
+		} else if (peer_rx_total != tx_total) {
+			LOG_WRN("Peripheral received %u of %u bytes", peer_rx_total, tx_total);
+		} else {
+			LOG_INF("Peripheral received all %u bytes", tx_total);
+		}
+	}
+
+	return 0;
+}
+
+/* Wait until the link setup of the peripheral is over and the link settled,
+ * so that no round includes the setup.
+ */
+static int warmup_wait(atomic_val_t gen)
+{
+	uint32_t start = k_uptime_get_32();
+
+	LOG_INF("Warming up");
+
+	while (k_uptime_get_32() - start < PEER_SETUP_MS) {
+		if (atomic_get(&conn_gen) != gen) {
+			return -ENOTCONN;
+		}
+
+		/* The peripheral starts streaming when its setup is done. */
+		if (TEST_NOTIFY && atomic_get(&rx_notifications)) {
+			break;
+		}
+
+		k_sleep(K_MSEC(100));
+	}
+
+	if (TEST_NOTIFY && !atomic_get(&rx_notifications)) {
+		LOG_WRN("No notifications after %u ms", PEER_SETUP_MS);
+	}
+
+	k_sleep(K_SECONDS(CONFIG_APP_WARMUP_S));
+
+	return atomic_get(&conn_gen) == gen ? 0 : -ENOTCONN;
+}
+
+static void test_run(struct bt_conn *conn, atomic_val_t gen)
+{
+	uint32_t tx_kbps;
+	uint32_t rx_kbps;
+	uint32_t tx_min = UINT32_MAX;
+	uint32_t rx_min = UINT32_MAX;
+	uint64_t tx_sum = 0;
+	uint64_t rx_sum = 0;
+	int rounds;
+	int err;
+
+	/* Completions of the previous connection may never come. */
+	k_sem_init(&tx_sem, TX_WINDOW, TX_WINDOW);
+	tx_total = 0;
+
+	err = warmup_wait(gen);
+	if (err) {
+		LOG_WRN("Warm-up aborted (err %d)", err);
+		return;
+	}
+
+	for (rounds = 0; rounds < CONFIG_APP_TEST_ROUNDS; rounds++) {
+		LOG_INF("Round %d of %d", rounds + 1, CONFIG_APP_TEST_ROUNDS);
+
+		err = round_run(conn, gen, &tx_kbps, &rx_kbps);
+		if (err) {
+			LOG_WRN("Round aborted (err %d)", err);
+			break;
+		}
+
+		tx_sum += tx_kbps;
+		rx_sum += rx_kbps;
+		tx_min = MIN(tx_min, tx_kbps);
+		rx_min = MIN(rx_min, rx_kbps);
+	}
+
+	if (TEST_NOTIFY && atomic_get(&conn_gen) == gen) {
+		/* Stop the peripheral from streaming. */
+		err = bt_gatt_unsubscribe(conn, &subscribe_params);
+		if (err) {
+			LOG_WRN("Unsubscribe failed (err %d)", err);
+		}
+	}
+
+	if (!rounds) {
+		return;
+	}
+
+	LOG_INF("Test done, %d rounds of %u s", rounds, CONFIG_APP_TEST_DURATION_S);
+	LOG_INF("Write: %u kbps avg, %u kbps min", (uint32_t)(tx_sum / rounds), tx_min);
+	LOG_INF("Notify: %u kbps avg, %u kbps min", (uint32_t)(rx_sum / rounds), rx_min);
+}
+
+static void test_thread(void)
+{
+	struct test_req req;
+
+	for (int i = 0; i < sizeof(tx_data); i++) {
+		tx_data[i] = i;
+	}
+
+	for (;;) {
+		k_msgq_get(&start_msgq, &req, K_FOREVER);
+		test_run(req.conn, req.gen);
+		bt_conn_unref(req.conn);
+	}
+}
+
+K_THREAD_DEFINE(test_thread_id, TEST_STACK_SIZE, test_thread, NULL, NULL, NULL, TEST_PRIORITY, 0,
+		0);
+
+static void test_start(struct bt_conn *conn)
+{
+	struct test_req req = {
+		.conn = bt_conn_ref(conn),
+		.gen = atomic_get(&conn_gen),
+	};
+
+	if (k_msgq_put(&start_msgq, &req, K_NO_WAIT)) {
+		LOG_ERR("Test already pending");
+		bt_conn_unref(req.conn);
+	}
+}
+
+static uint8_t notify_func(struct bt_conn *conn, struct bt_gatt_subscribe_params *params,
+			   const void *data, uint16_t length)
+{
+	if (!data) {
+		LOG_INF("Unsubscribed");
+		params->value_handle = 0;
+		return BT_GATT_ITER_STOP;
+	}
+
+	atomic_add(&rx_bytes, length);
+	atomic_inc(&rx_notifications);
+
+	return BT_GATT_ITER_CONTINUE;
+}
+
+static void subscribe_func(struct bt_conn *conn, uint8_t err,
+			   struct bt_gatt_subscribe_params *params)
+{
+	if (err) {
+		LOG_ERR("Subscribe failed (ATT err %u)", err);
+		return;
+	}
+
+	/* Also called when unsubscribing */
+	if (params->value) {
+		LOG_INF("Subscribed");
+		test_start(conn);
+	}
+}
+
+static uint8_t discover_func(struct bt_conn *conn, const struct bt_gatt_attr *attr,
+			     struct bt_gatt_discover_params *params)
+{
+	int err;
+
+	if (!attr) {
+		if (params->type == BT_GATT_DISCOVER_DESCRIPTOR) {
+			LOG_ERR("TX CCC not found");
+		} else if (!subscribe_params.value_handle || !rx_handle || !rx_count_handle) {
+			LOG_ERR("Bulk service not found");
+		} else if (TEST_NOTIFY) {
+			params->uuid = &ccc_uuid.uuid;
+			params->start_handle = subscribe_params.value_handle + 1;
+			params->end_handle = BT_ATT_LAST_ATTRIBUTE_HANDLE;
+			params->type = BT_GATT_DISCOVER_DESCRIPTOR;
+
+			err = bt_gatt_discover(conn, params);
+			if (err) {
+				LOG_ERR("CCC discovery failed (err %d)", err);
+			}
+			return BT_GATT_ITER_STOP;
+		} else {
+			test_start(conn);
+		}
+
+		memset(params, 0, sizeof(*params));
+		return BT_GATT_ITER_STOP;
+	}
+
+	if (params->type == BT_GATT_DISCOVER_CHARACTERISTIC) {
+		struct bt_gatt_chrc *chrc = attr->user_data;
+
+		if (!bt_uuid_cmp(chrc->uuid, &tx_uuid.uuid)) {
+			subscribe_params.value_handle = chrc->value_handle;
+		} else if (!bt_uuid_cmp(chrc->uuid, &rx_uuid.uuid)) {
+			rx_handle = chrc->value_handle;
+		} else if (!bt_uuid_cmp(chrc->uuid, &rx_count_uuid.uuid)) {
+			rx_count_handle = chrc->value_handle;
+		}
+
+		return BT_GATT_ITER_CONTINUE;
+	}
+
+	subscribe_params.ccc_handle = attr->handle;
+	subscribe_params.notify = notify_func;
+	subscribe_params.subscribe = subscribe_func;
+	subscribe_params.value = BT_GATT_CCC_NOTIFY;
+
+	err = bt_gatt_subscribe(conn, &subscribe_params);
+	if (err == -EALREADY) {
+		test_start(conn);
+	} else if (err) {
+		LOG_ERR("Subscribe failed (err %d)", err);
+	}
+
+	return BT_GATT_ITER_STOP;
+}
+
+static void discover_bulk(struct bt_conn *conn)
+{
+	int err;
+
+	subscribe_params.value_handle = 0;
+	rx_handle = 0;
+	rx_count_handle = 0;
+	/* Tells the warm-up when the peripheral starts streaming */
+	atomic_clear(&rx_notifications);
+
+	discover_params.uuid = NULL;
+	discover_params.func = discover_func;
+	discover_params.start_handle = BT_ATT_FIRST_ATTRIBUTE_HANDLE;
+	discover_params.end_handle = BT_ATT_LAST_ATTRIBUTE_HANDLE;
+	discover_params.type = BT_GATT_DISCOVER_CHARACTERISTIC;
+
+	err = bt_gatt_discover(conn, &discover_params);
+	if (err) {
+		LOG_ERR("Discovery failed (err %d)", err);
+	}
+}
+
+static void exchange_func(struct bt_conn *conn, uint8_t att_err,
+			  struct bt_gatt_exchange_params *params)
+{
+	if (att_err) {
+		LOG_WRN("MTU exchange failed (ATT err %u)", att_err);
+	} else {
+		LOG_INF("MTU exchanged: %u", bt_gatt_get_mtu(conn));
+	}
+
+	/* Discover with the larger MTU, fewer round trips. */
+	discover_bulk(conn);
+}
+
+static void update_mtu(struct bt_conn *conn)
+{
+	int err;
+
+	exchange_params.func = exchange_func;
+
+	err = bt_gatt_exchange_mtu(conn, &exchange_params);
+	if (err == -EALREADY) {
+		/* The peripheral exchanged the MTU first. */
+		discover_bulk(conn);
+	} else if (err) {
+		LOG_ERR("bt_gatt_exchange_mtu failed (err %d)", err);
+		discover_bulk(conn);
+	}
+}
+
+static void update_data_length(struct bt_conn *conn)
+{
+	int err;
+	const struct bt_conn_le_data_len_param data_len = {
+		.tx_max_len = CONFIG_APP_DATA_LEN,
+		.tx_max_time = BT_GAP_DATA_TIME_MAX,
+	};
+
+	err = bt_conn_le_data_len_update(conn, &data_len);
+	if (err) {
+		LOG_ERR("data_len_update failed (err %d)", err);
+	}
+}
+
+static void update_phy(struct bt_conn *conn)
+{
+	int err;
+	const struct bt_conn_le_phy_param preferred_phy = {
+		.options = APP_PHY_OPT,
+		.pref_rx_phy = APP_PHY,
+		.pref_tx_phy = APP_PHY,
+	};
+
+	err = bt_conn_le_phy_update(conn, &preferred_phy);
+	if (err) {
+		LOG_ERR("bt_conn_le_phy_update() returned %d", err);
+	}
+}
+
+static bool name_matches(struct bt_data *data, void *user_data)
+{
+	bool *found = user_data;
+
+	if (data->type == BT_DATA_NAME_COMPLETE &&
+	    data->data_len == sizeof(CONFIG_APP_PEER_NAME) - 1 &&
+	    memcmp(data->data, CONFIG_APP_PEER_NAME, data->data_len) == 0) {
+		*found = true;
+		return false;
+	}
+
+	return true;
+}
+
+static void device_found(const bt_addr_le_t *addr, int8_t rssi, uint8_t type,
+			 struct net_buf_simple *ad)
+{
+	bool found = false;
+	int err;
+
+	if (type != BT_GAP_ADV_TYPE_ADV_IND) {
+		return;
+	}
+
+	bt_data_parse(ad, name_matches, &found);
+	if (!found) {
+		return;
+	}
+
+	err = bt_le_scan_stop();
+	if (err) {
+		LOG_ERR("Stop LE scan failed (err %d)", err);
+		return;
+	}
+
+	err = bt_conn_le_create(addr, BT_CONN_LE_CREATE_CONN, conn_param, &my_conn);
+	if (err) {
+		LOG_ERR("Create connection failed (err %d)", err);
+		scan_start();
+	}
+}
+
+static void scan_start(void)
+{
+	int err;
+
+	err = bt_le_scan_start(BT_LE_SCAN_PASSIVE, device_found);
+	if (err) {
+		LOG_ERR("Scanning failed to start (err %d)", err);
+		return;
+	}
+
+	LOG_INF("Scanning for %s", CONFIG_APP_PEER_NAME);
+}
+
+/* Callbacks */
+void on_connected(struct bt_conn *conn, uint8_t err)
+{
+	if (err) {
+		LOG_ERR("Connection error %d", err);
+		bt_conn_unref(my_conn);
+		my_conn = NULL;
+		scan_start();
+		return;
+	}
+
+	LOG_INF("Connected");
+
+	/* The controller runs the procedures one after the other. */
+	update_phy(conn);
+	update_data_length(conn);
+	update_mtu(conn);
+}
+
+void on_disconnected(struct bt_conn *conn, uint8_t reason)
+{
+	LOG_INF("Disconnected. Reason %d", reason);
+
+	atomic_inc(&conn_gen);
+
+	bt_conn_unref(my_conn);
+	my_conn = NULL;
+	scan_start();
+}
+
+void on_le_phy_updated(struct bt_conn *conn, struct bt_conn_le_phy_info *param)
+{
+	LOG_INF("PHY updated. New PHY: %s", phy_name(param->tx_phy));
+}
+
+void on_le_data_len_updated(struct bt_conn *conn, struct bt_conn_le_data_len_info *info)
+{
+	LOG_INF("Data length updated. TX %u bytes, RX %u bytes", info->tx_max_len,
+		info->rx_max_len);
+}
+
+void on_le_param_updated(struct bt_conn *conn, uint16_t interval, uint16_t latency,
+			 uint16_t timeout)
+{
+	LOG_INF("Connection parameters updated. Interval " CONN_TIME_FMT
+		", latency %u, timeout %u ms",
+		CONN_TIME_ARGS(CONN_TIME_INTERVAL_US(interval)), latency, timeout * 10U);
+}
+
+struct bt_conn_cb connection_callbacks = {
+	.connected = on_connected,
+	.disconnected = on_disconnected,
+	.le_phy_updated = on_le_phy_updated,
+	.le_data_len_updated = on_le_data_len_updated,
+	.le_param_updated = on_le_param_updated,
+};
+
+void main(void)
+{
+	int err;
+
+	LOG_INF("Starting Lesson 6 - Throughput central\n");
+
+	bt_conn_cb_register(&connection_callbacks);
+
+	err = bt_enable(NULL);
+	if (err) {
+		LOG_ERR("Bluetooth init failed (err %d)", err);
+		return;
+	}
+
+	LOG_INF("Bluetooth initialized");
+	scan_start();
+}
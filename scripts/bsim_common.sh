@@ -0,0 +1,67 @@
+#!/usr/bin/env bash
+#
+# Copyright (c) 2023 Nordic Semiconductor ASA
+#
+# SPDX-License-Identifier: LicenseRef-Nordic-5-Clause
+#
+# Helpers to build samples for nrf52_bsim and run them against each other
+# in one BabbleSim simulation. Source this file from a run script.
+#
+# Needs west, ZEPHYR_BASE and a BabbleSim installation in BSIM_OUT_PATH
+# and BSIM_COMPONENTS_PATH, as described for the nrf52_bsim board.
+# The simulation is deterministic, so a run gives the same numbers every
+# time unless BSIM_SEED is changed.
+
+set -eu
+
+: "${ZEPHYR_BASE:?ZEPHYR_BASE must be set}"
+: "${BSIM_OUT_PATH:?BSIM_OUT_PATH must be set}"
+: "${BSIM_COMPONENTS_PATH:?BSIM_COMPONENTS_PATH must be set}"
+
+BSIM_BUILD_DIR="${BSIM_BUILD_DIR:-$(pwd)/build_bsim}"
+BSIM_SEED="${BSIM_SEED:-1}"
+
+# bsim_build <name> <sample directory> [CMake arguments...]
+#
+# Builds the sample into $BSIM_BUILD_DIR/<name> and prints the path of the
+# executable. The build output goes to stderr.
+bsim_build() {
+	local name=$1
+	local app=$2
+	shift 2
+
+	west build -p auto -b nrf52_bsim -d "${BSIM_BUILD_DIR}/${name}" "${app}" -- "$@" >&2
+	echo "${BSIM_BUILD_DIR}/${name}/zephyr/zephyr.exe"
+}
+
+# bsim_run <simulation id> <length in s> <executable> [<executable>...]
+#
+# Runs the executables as devices 0, 1, ... of one simulation until the
+# simulated time is up. The output of every device is prefixed with its
+# number. Fails if any device or the phy fails.
+bsim_run() {
+	local sim_id=$1
+	local length_s=$2
+	local pids=()
+	local dev=0
+	local ret=0
+	shift 2
+
+	for exe in "$@"; do
+		"${exe}" -s="${sim_id}" -d="${dev}" -rs="$((BSIM_SEED + dev))" -RealEncryption=0 \
+			2>&1 | sed -u "s/^/d_${dev}: /" &
+		pids+=($!)
+		dev=$((dev + 1))
+	done
+
+	(cd "${BSIM_OUT_PATH}/bin" &&
+	 ./bs_2G4_phy_v1 -s="${sim_id}" -D="${dev}" -rs="${BSIM_SEED}" \
+		-sim_length="$((length_s * 1000000))") &
+	pids+=($!)
+
+	for pid in "${pids[@]}"; do
+		wait "${pid}" || ret=1
+	done
+
+	return ${ret}
+}
@@ -0,0 +1,41 @@
+#!/usr/bin/env bash
+#
+# Copyright (c) 2023 Nordic Semiconductor ASA
+#
+# SPDX-License-Identifier: LicenseRef-Nordic-5-Clause
+#
+# Builds a sample with and without the FPU and prints the flash and RAM
+# the linker reports for both, to check what printing Bluetooth LE times
+# with common/conn_time.h instead of floating point saves.
+#
+# Usage: size_report.sh <sample directory> [board] [CMake arguments...]
+# The board defaults to nrf52840dk_nrf52840.
+
+set -eu
+
+: "${ZEPHYR_BASE:?ZEPHYR_BASE must be set}"
+
+APP=${1:?Usage: size_report.sh <sample directory> [board] [CMake arguments...]}
+BOARD=${2:-nrf52840dk_nrf52840}
+shift $(($# < 2 ? $# : 2))
+
+SIZE_BUILD_DIR="${SIZE_BUILD_DIR:-$(pwd)/build_size}"
+mkdir -p "${SIZE_BUILD_DIR}"
+
+# region_used <build log> <FLASH|RAM>
+region_used() {
+	sed -n "s/^ *$2: *\\([0-9]*\\) B .*/\\1/p" "$1" | tail -n 1
+}
+
+for fpu in n y; do
+	west build -p always -b "${BOARD}" -d "${SIZE_BUILD_DIR}/fpu_${fpu}" "${APP}" -- \
+		-DCONFIG_FPU=${fpu} "$@" > "${SIZE_BUILD_DIR}/fpu_${fpu}.log" 2>&1 ||
+		{ cat "${SIZE_BUILD_DIR}/fpu_${fpu}.log"; exit 1; }
+done
+
+printf "%-8s %10s %10s %10s\n" "region" "FPU=n" "FPU=y" "saved"
+for region in FLASH RAM; do
+	no_fpu=$(region_used "${SIZE_BUILD_DIR}/fpu_n.log" ${region})
+	fpu=$(region_used "${SIZE_BUILD_DIR}/fpu_y.log" ${region})
+	printf "%-8s %10s %10s %10s\n" ${region} "${no_fpu}" "${fpu}" "$((fpu - no_fpu))"
+done